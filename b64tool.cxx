@@ -0,0 +1,392 @@
+// Command-line base64 encoder/decoder for large files. The input is mapped
+// in memory and processed in blocks spread across a thread pool; the output
+// is written through a mapping of the output file when it is a regular file,
+// and by large writes otherwise. Pipes and other inputs that cannot be
+// mapped go through base64_pipeline instead, which processes them in
+// bounded memory, and so is line-wrapped input when decoding. The encoded
+// output is the one of base64_encode: no line breaks, no trailing newline.
+
+#include "base64_pipeline.hxx"
+#include "thread_pool.hxx"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RESTRICT
+#include "base64.h"
+
+namespace {
+
+struct settings
+{
+  bool decode = false;
+  bool quiet = false;
+  bool stream = false;
+  bool pipeline = false;
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  // Workers of the pipeline, which also runs a reader and a writer thread:
+  // one per processor but two, and at least one.
+  size_t workers = std::max(3u, std::thread::hardware_concurrency()) - 2;
+  // Plain bytes per block: large enough to amortize the dispatch, small
+  // enough for a block and its encoding to stay in the L2 cache.
+  size_t block = 192 << 10;
+  // Blocks in flight with the pipeline; 0 for the default of base64_pipeline.
+  size_t buffers = 0;
+  std::string input = "-";
+  std::string output = "-";
+};
+
+void usage(const char* program)
+{
+  std::cout << "Usage: " << program << " [options] [INPUT [OUTPUT]]\n"
+            << "\n"
+            << "Encodes INPUT (or decodes it with -d) to OUTPUT. Either may be - for the\n"
+            << "standard input or output, which is the default.\n"
+            << "\n"
+            << "  -d, --decode        decode instead of encoding\n"
+            << "  --threads=N         number of threads for the files that are mapped (default: one per\n"
+            << "                      processor)\n"
+            << "  --block=N           plain bytes processed at once by a thread (default 196608)\n"
+            << "  --stream            stream the input even if it is a file that can be mapped\n"
+            << "  --pipeline          stream with a reader thread, workers and a writer thread at once\n"
+            << "                      instead of in a single thread\n"
+            << "  --workers=N         workers of the pipeline (default: one per processor but two, at\n"
+            << "                      least one)\n"
+            << "  --buffers=N         blocks in flight in the pipeline (default: 2 per worker plus 2)\n"
+            << "  -q, --quiet         do not report the throughput on the standard error\n"
+            << "  -h, --help          print this help\n";
+}
+
+size_t to_size(const std::string& name, const std::string& value)
+{
+  size_t pos = 0;
+  unsigned long long n = 0;
+  try {
+    n = std::stoull(value, &pos);
+  } catch (const std::exception&) {
+  }
+  if (pos == 0 || pos != value.size())
+    throw std::invalid_argument("Invalid value for --" + name + ": " + value);
+  return n;
+}
+
+settings parse_settings(int argc, char** argv)
+{
+  settings s;
+  std::vector<std::string> files;
+
+  try {
+    for(int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+
+      if (arg == "-h" || arg == "--help") {
+        usage(argv[0]);
+        std::exit(EXIT_SUCCESS);
+      } else if (arg == "-d" || arg == "--decode") {
+        s.decode = true;
+      } else if (arg == "-q" || arg == "--quiet") {
+        s.quiet = true;
+      } else if (arg == "--stream") {
+        s.stream = true;
+      } else if (arg == "--pipeline") {
+        s.pipeline = true;
+      } else if (arg.compare(0, 2, "--") == 0) {
+        std::string name = arg.substr(2), value;
+        size_t eq = name.find('=');
+        if (eq != std::string::npos) {
+          value = name.substr(eq + 1);
+          name.resize(eq);
+        } else if (i + 1 < argc) {
+          value = argv[++i];
+        } else {
+          throw std::invalid_argument("Missing value for --" + name);
+        }
+
+        if (name == "threads")
+          s.threads = std::max<size_t>(1, to_size(name, value));
+        else if (name == "workers")
+          s.workers = std::max<size_t>(1, to_size(name, value));
+        else if (name == "block")
+          s.block = std::max<size_t>(1, to_size(name, value));
+        else if (name == "buffers")
+          s.buffers = to_size(name, value);
+        else
+          throw std::invalid_argument("Unknown option: --" + name);
+      } else if (arg.size() > 1 && arg[0] == '-') {
+        throw std::invalid_argument("Unknown option: " + arg);
+      } else {
+        files.push_back(arg);
+      }
+    }
+
+    if (files.size() > 2)
+      throw std::invalid_argument("Unexpected argument: " + files[2]);
+  } catch (const std::invalid_argument& e) {
+    std::cerr << e.what() << std::endl;
+    usage(argv[0]);
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (files.size() > 0)
+    s.input = files[0];
+  if (files.size() > 1)
+    s.output = files[1];
+
+  // Blocks hold whole groups, so that they are encoded independently and
+  // their output lands at a known offset.
+  s.block = (s.block + 2) / 3 * 3;
+  return s;
+}
+
+[[noreturn]] void fail(const std::string& what)
+{
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Descriptor closed on destruction.
+class file
+{
+public:
+  file(int fd) : fd(fd) {}
+  ~file() { if (fd > 2) close(fd); }
+
+  file(const file&) = delete;
+  file& operator=(const file&) = delete;
+
+  int fd;
+};
+
+// Read-only or read-write mapping of a whole file.
+class mapping
+{
+public:
+  mapping(int fd, size_t size, bool writable) : data(nullptr), size(size)
+  {
+    if (size == 0)
+      return;
+
+    void* p = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                   writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED)
+      fail("mmap");
+    data = static_cast<char*>(p);
+    madvise(data, size, MADV_SEQUENTIAL);
+  }
+
+  ~mapping() { if (data) munmap(data, size); }
+
+  mapping(const mapping&) = delete;
+  mapping& operator=(const mapping&) = delete;
+
+  char* data;
+  size_t size;
+};
+
+void write_all(int fd, const char* data, size_t size)
+{
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      fail("write");
+    }
+    data += n;
+    size -= n;
+  }
+}
+
+// Encodes or decodes an input split in blocks of block_in bytes, block i
+// being written at i * block_out of the output.
+class codec
+{
+public:
+  codec(const settings& s, const char* in, size_t insize) : decoding(s.decode), in(in), insize(insize)
+  {
+    if (decoding) {
+      // A final line break, as written by most encoders, is not data.
+      if (this->insize > 0 && in[this->insize - 1] == '\n')
+        --this->insize;
+      if (this->insize > 0 && in[this->insize - 1] == '\r')
+        --this->insize;
+      if (this->insize % 4 != 0)
+        throw std::runtime_error("Input was not base64 encoded");
+
+      block_in = s.block / 3 * 4;
+      block_out = s.block;
+      outsize = this->insize / 4 * 3;
+      for(size_t i = 1; i <= 2 && i <= this->insize && in[this->insize - i] == '='; ++i)
+        --outsize;
+    } else {
+      block_in = s.block;
+      block_out = BASE64_LENGTH(s.block);
+      outsize = BASE64_LENGTH(insize);
+      if (outsize < insize)
+        throw std::runtime_error("Input too long");
+    }
+  }
+
+  size_t input_size() const { return insize; }
+  size_t output_size() const { return outsize; }
+  size_t blocks() const { return (insize + block_in - 1) / block_in; }
+  size_t block_output() const { return block_out; }
+
+  // Processes block i to out, the start of the output of the block.
+  void run(size_t i, char* out) const
+  {
+    size_t begin = i * block_in;
+    size_t len = std::min(block_in, insize - begin);
+
+    if (!decoding) {
+      base64_encode(in + begin, len, out, BASE64_LENGTH(len));
+      return;
+    }
+
+    // base64_decode accepts padding at the end of its input, which is
+    // only the end of the whole input for the last block.
+    bool last = begin + len == insize;
+    if (!last && in[begin + len - 1] == '=')
+      throw std::runtime_error("Input was not base64 encoded");
+
+    size_t written = last ? outsize - i * block_out : block_out;
+    if (!base64_decode(in + begin, len, out, &written))
+      throw std::runtime_error("Input was not base64 encoded");
+  }
+
+private:
+  bool decoding;
+  const char* in;
+  size_t insize;
+  size_t outsize;
+  size_t block_in;
+  size_t block_out;
+};
+
+// Whether the encoded input has a line break before the end of its first
+// window characters, as the output of base64(1) or of MIME encoders, and
+// unlike a single line followed by a final line break.
+bool wrapped(const char* in, size_t size, size_t window)
+{
+  size_t n = std::min(size > 0 ? size - 1 : 0, window);
+  return n > 0 && std::memchr(in, '\n', n) != nullptr;
+}
+
+// Reports the throughput on the standard error, unless asked not to.
+void report(const settings& s, uint64_t insize, uint64_t outsize, size_t threads, double seconds)
+{
+  if (s.quiet)
+    return;
+
+  uint64_t plain = s.decode ? outsize : insize;
+  std::cerr << (s.decode ? "decoded " : "encoded ") << insize << " bytes into "
+            << outsize << " bytes with " << threads << " thread(s) in "
+            << std::fixed << std::setprecision(3) << seconds << " s: "
+            << std::setprecision(1) << (seconds > 0 ? plain / seconds / 1e6 : 0.) << " MB/s" << std::endl;
+}
+
+int open_output(const settings& s)
+{
+  int fd = s.output == "-" ? STDOUT_FILENO : open(s.output.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0)
+    fail(s.output);
+  return fd;
+}
+
+int run(const settings& s)
+{
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+
+  file input(s.input == "-" ? STDIN_FILENO : open(s.input.c_str(), O_RDONLY));
+  if (input.fd < 0)
+    fail(s.input);
+
+  struct stat st;
+  if (fstat(input.fd, &st) != 0)
+    fail(s.input);
+
+  // Pipes and terminals cannot be mapped: they are streamed instead, in this
+  // thread, or with --pipeline by a reader thread, s.workers workers and the
+  // writer working at once. So is line-wrapped input, whose blocks do not
+  // decode at known offsets.
+  bool stream = !S_ISREG(st.st_mode) || s.stream;
+  mapping in_map(input.fd, stream ? 0 : st.st_size, false);
+  if (s.decode && wrapped(in_map.data, in_map.size, s.block / 3 * 4))
+    stream = true;
+
+  if (stream) {
+    file output(open_output(s));
+    base64_pipeline_options options;
+    options.decode = s.decode;
+    options.workers = s.pipeline ? s.workers : 0;
+    options.chunk = s.block;
+    options.buffers = s.buffers;
+    base64_pipeline_result r = base64_pipeline(input.fd, output.fd, options);
+
+    report(s, r.read, r.written, s.pipeline ? s.workers + 2 : 1, std::chrono::duration<double>(clock::now() - start).count());
+    return EXIT_SUCCESS;
+  }
+
+  codec c(s, in_map.data, in_map.size);
+  thread_pool pool(s.threads);
+
+  file output(open_output(s));
+  if (fstat(output.fd, &st) != 0)
+    fail(s.output);
+
+  // Only a file opened for reading and writing, at its start, can be mapped.
+  bool mappable = S_ISREG(st.st_mode) && (fcntl(output.fd, F_GETFL) & O_ACCMODE) == O_RDWR
+    && lseek(output.fd, 0, SEEK_CUR) == 0;
+
+  if (mappable) {
+    // Every block is written straight at its offset of the file.
+    if (ftruncate(output.fd, c.output_size()) != 0)
+      fail(s.output);
+    mapping out_map(output.fd, c.output_size(), true);
+    char* out = out_map.data;
+    pool.run(c.blocks(), [&](size_t i) { c.run(i, out + i * c.block_output()); });
+  } else {
+    // One block per thread is processed into the buffer, which is then
+    // written at once.
+    size_t batch = pool.size();
+    std::vector<char> buffer(batch * c.block_output());
+    for(size_t first = 0; first < c.blocks(); first += batch) {
+      size_t count = std::min(batch, c.blocks() - first);
+      pool.run(count, [&](size_t i) { c.run(first + i, buffer.data() + i * c.block_output()); });
+
+      size_t end = std::min(c.output_size(), (first + count) * c.block_output());
+      write_all(output.fd, buffer.data(), end - first * c.block_output());
+    }
+  }
+
+  report(s, c.input_size(), c.output_size(), pool.size(), std::chrono::duration<double>(clock::now() - start).count());
+  return EXIT_SUCCESS;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  settings s = parse_settings(argc, argv);
+
+  try {
+    return run(s);
+  } catch (const std::exception& e) {
+    std::cerr << argv[0] << ": " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -52,6 +52,12 @@
 /* Get UCHAR_MAX. */
 #include <limits.h>
 
+/* Get memcpy and strlen. */
+#include <string.h>
+
+/* Get the vectorized kernels. */
+#include "base64_simd.h"
+
 /* C89 compliant way to cast 'char' to 'unsigned char'. */
 static inline unsigned char
 to_uchar (char ch)
@@ -59,13 +65,260 @@ to_uchar (char ch)
   return ch;
 }
 
-/* Base64 encode IN array of size INLEN into OUT array of size OUTLEN.
-   If OUTLEN is less than BASE64_LENGTH(INLEN), write as many bytes as
-   possible.  If OUTLEN is larger than BASE64_LENGTH(INLEN), also zero
-   terminate the output buffer. */
-void
-base64_encode (const char *restrict in, size_t inlen,
-	       char *restrict out, size_t outlen)
+typedef size_t (*encode_kernel_t) (const char *in, size_t inlen, char *out);
+typedef size_t (*decode_kernel_t) (const char *in, size_t inlen,
+				  char *out, size_t outlen);
+typedef size_t (*encode_be_kernel_t) (const char *in, size_t inlen,
+				     char *out, size_t width);
+typedef size_t (*decode_be_kernel_t) (const char *in, size_t inlen,
+				     char *out, size_t outlen, size_t width);
+typedef size_t (*encode_wrapped_kernel_t) (const char *in, size_t inlen,
+					  char *out, size_t outlen,
+					  size_t line, const char *eol,
+					  size_t eollen);
+typedef size_t (*decode_wrapped_kernel_t) (const char *in, size_t inlen,
+					  char *out, size_t *outlen);
+typedef size_t (*validate_kernel_t) (const char *in, size_t inlen);
+typedef size_t (*batch_kernel_t) (const char *const *in, const size_t *inlen,
+				 size_t n, char *out, size_t outlen,
+				 const size_t *offsets);
+
+/* Kernel used by processors without any vector extension: it leaves
+   everything to the portable loop below.  */
+static size_t
+encode_kernel_none (const char *in, size_t inlen, char *out)
+{
+  (void) in;
+  (void) inlen;
+  (void) out;
+  return 0;
+}
+
+static size_t
+decode_kernel_none (const char *in, size_t inlen, char *out, size_t outlen)
+{
+  (void) in;
+  (void) inlen;
+  (void) out;
+  (void) outlen;
+  return 0;
+}
+
+static size_t
+encode_be_kernel_none (const char *in, size_t inlen, char *out, size_t width)
+{
+  (void) in;
+  (void) inlen;
+  (void) out;
+  (void) width;
+  return 0;
+}
+
+static size_t
+decode_be_kernel_none (const char *in, size_t inlen, char *out, size_t outlen,
+		       size_t width)
+{
+  (void) in;
+  (void) inlen;
+  (void) out;
+  (void) outlen;
+  (void) width;
+  return 0;
+}
+
+static size_t
+encode_wrapped_kernel_none (const char *in, size_t inlen, char *out,
+			    size_t outlen, size_t line, const char *eol,
+			    size_t eollen)
+{
+  (void) in;
+  (void) inlen;
+  (void) out;
+  (void) outlen;
+  (void) line;
+  (void) eol;
+  (void) eollen;
+  return 0;
+}
+
+static size_t
+decode_wrapped_kernel_none (const char *in, size_t inlen, char *out,
+			    size_t *outlen)
+{
+  (void) in;
+  (void) inlen;
+  (void) out;
+  *outlen = 0;
+  return 0;
+}
+
+static size_t
+validate_kernel_none (const char *in, size_t inlen)
+{
+  (void) in;
+  (void) inlen;
+  return 0;
+}
+
+static size_t
+batch_kernel_none (const char *const *in, const size_t *inlen, size_t n,
+		   char *out, size_t outlen, const size_t *offsets)
+{
+  (void) in;
+  (void) inlen;
+  (void) n;
+  (void) out;
+  (void) outlen;
+  (void) offsets;
+  return 0;
+}
+
+static enum base64_backend active_backend = BASE64_BACKEND_SCALAR;
+static encode_kernel_t encode_kernel = encode_kernel_none;
+static decode_kernel_t decode_kernel = decode_kernel_none;
+static encode_be_kernel_t encode_be_kernel = encode_be_kernel_none;
+static decode_be_kernel_t decode_be_kernel = decode_be_kernel_none;
+static encode_wrapped_kernel_t encode_wrapped_kernel =
+  encode_wrapped_kernel_none;
+static decode_wrapped_kernel_t decode_wrapped_kernel =
+  decode_wrapped_kernel_none;
+static validate_kernel_t validate_kernel = validate_kernel_none;
+static batch_kernel_t encode_batch_kernel = batch_kernel_none;
+static batch_kernel_t decode_batch_kernel = batch_kernel_none;
+
+static enum base64_backend
+detect_backend (void)
+{
+#if BASE64_HAVE_X86_KERNELS
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    return BASE64_BACKEND_AVX2;
+  if (__builtin_cpu_supports ("ssse3"))
+    return BASE64_BACKEND_SSSE3;
+#endif
+  return BASE64_BACKEND_SWAR;
+}
+
+/* Make BACKEND the implementation used by base64_encode and
+   base64_decode.  BASE64_BACKEND_AUTO selects the fastest one
+   supported by the processor.  Return false, leaving the current
+   implementation in place, if BACKEND is not supported.  */
+bool
+base64_set_backend (enum base64_backend backend)
+{
+  enum base64_backend best = detect_backend ();
+
+  if (backend == BASE64_BACKEND_AUTO)
+    backend = best;
+
+  switch (backend)
+    {
+    case BASE64_BACKEND_SCALAR:
+      encode_kernel = encode_kernel_none;
+      decode_kernel = decode_kernel_none;
+      encode_be_kernel = encode_be_kernel_none;
+      decode_be_kernel = decode_be_kernel_none;
+      encode_wrapped_kernel = encode_wrapped_kernel_none;
+      decode_wrapped_kernel = decode_wrapped_kernel_none;
+      validate_kernel = validate_kernel_none;
+      encode_batch_kernel = batch_kernel_none;
+      decode_batch_kernel = batch_kernel_none;
+      break;
+    case BASE64_BACKEND_SWAR:
+      /* The other kernels are left to the portable loops.  */
+      base64_swar_init ();
+      encode_kernel = base64_encode_swar;
+      decode_kernel = base64_decode_swar;
+      encode_be_kernel = encode_be_kernel_none;
+      decode_be_kernel = decode_be_kernel_none;
+      encode_wrapped_kernel = encode_wrapped_kernel_none;
+      decode_wrapped_kernel = decode_wrapped_kernel_none;
+      validate_kernel = base64_validate_swar;
+      encode_batch_kernel = batch_kernel_none;
+      decode_batch_kernel = batch_kernel_none;
+      break;
+#if BASE64_HAVE_X86_KERNELS
+    case BASE64_BACKEND_SSSE3:
+      if (best < BASE64_BACKEND_SSSE3)
+	return false;
+      encode_kernel = base64_encode_ssse3;
+      decode_kernel = base64_decode_ssse3;
+      encode_be_kernel = base64_encode_be_ssse3;
+      decode_be_kernel = base64_decode_be_ssse3;
+      encode_wrapped_kernel = base64_encode_wrapped_ssse3;
+      decode_wrapped_kernel = base64_decode_wrapped_ssse3;
+      validate_kernel = base64_validate_ssse3;
+      encode_batch_kernel = base64_encode_batch_ssse3;
+      decode_batch_kernel = base64_decode_batch_ssse3;
+      break;
+    case BASE64_BACKEND_AVX2:
+      if (best < BASE64_BACKEND_AVX2)
+	return false;
+      encode_kernel = base64_encode_avx2;
+      decode_kernel = base64_decode_avx2;
+      encode_be_kernel = base64_encode_be_avx2;
+      decode_be_kernel = base64_decode_be_avx2;
+      encode_wrapped_kernel = base64_encode_wrapped_avx2;
+      decode_wrapped_kernel = base64_decode_wrapped_avx2;
+      validate_kernel = base64_validate_avx2;
+      encode_batch_kernel = base64_encode_batch_avx2;
+      decode_batch_kernel = base64_decode_batch_avx2;
+      break;
+#endif
+    default:
+      return false;
+    }
+
+  active_backend = backend;
+  return true;
+}
+
+/* Return the implementation currently in use.  */
+enum base64_backend
+base64_get_backend (void)
+{
+  return active_backend;
+}
+
+/* Return a printable name for BACKEND.  */
+const char *
+base64_backend_name (enum base64_backend backend)
+{
+  switch (backend)
+    {
+    case BASE64_BACKEND_AUTO:
+      return "auto";
+    case BASE64_BACKEND_SCALAR:
+      return "scalar";
+    case BASE64_BACKEND_SWAR:
+      return "swar";
+    case BASE64_BACKEND_SSSE3:
+      return "ssse3";
+    case BASE64_BACKEND_AVX2:
+      return "avx2";
+    }
+  return "unknown";
+}
+
+#ifdef __GNUC__
+/* Select the implementation once, when the library is loaded, so that
+   the codecs themselves never have to query the processor.  The SWAR
+   tables are filled here too, before any thread can call
+   base64_set_backend.  */
+__attribute__ ((constructor))
+static void
+base64_init_backend (void)
+{
+  base64_swar_init ();
+  base64_set_backend (BASE64_BACKEND_AUTO);
+}
+#endif
+
+/* Portable encoder, used for the bytes the vectorized kernels leave
+   over: see base64_encode below.  */
+static void
+base64_encode_scalar (const char *restrict in, size_t inlen,
+		      char *restrict out, size_t outlen)
 {
   static const char b64str[64] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -101,6 +354,24 @@ base64_encode (const char *restrict in, size_t inlen,
     *out = '\0';
 }
 
+/* Base64 encode IN array of size INLEN into OUT array of size OUTLEN.
+   If OUTLEN is less than BASE64_LENGTH(INLEN), write as many bytes as
+   possible.  If OUTLEN is larger than BASE64_LENGTH(INLEN), also zero
+   terminate the output buffer. */
+void
+base64_encode (const char *restrict in, size_t inlen,
+	       char *restrict out, size_t outlen)
+{
+  /* Only hand the kernel the whole 3-byte groups that fit in OUT; the
+     portable loop then deals with the tail, the padding and the
+     terminating zero exactly as before.  */
+  size_t room = outlen / 4 * 3;
+  size_t done = encode_kernel (in, inlen < room ? inlen : room, out);
+
+  base64_encode_scalar (in + done, inlen - done,
+			out + done / 3 * 4, outlen - done / 3 * 4);
+}
+
 /* Allocate a buffer and store zero terminated base64 encoded data
    from array IN of size INLEN, returning BASE64_LENGTH(INLEN), i.e.,
    the length of the encoded data, excluding the terminating zero.  On
@@ -300,18 +571,13 @@ isbase64 (char ch)
   return uchar_in_range (to_uchar (ch)) && 0 <= b64[to_uchar (ch)];
 }
 
-/* Decode base64 encoded input array IN of length INLEN to output
-   array OUT that can hold *OUTLEN bytes.  Return true if decoding was
-   successful, i.e. if the input was valid base64 data, false
-   otherwise.  If *OUTLEN is too small, as many bytes as possible will
-   be written to OUT.  On return, *OUTLEN holds the length of decoded
-   bytes in OUT.  Note that as soon as any non-alphabet characters are
-   encountered, decoding is stopped and false is returned.  This means
-   that, when applicable, you must remove any line terminators that is
-   part of the data stream before calling this function.  */
-bool
-base64_decode (const char *restrict in, size_t inlen,
-	       char *restrict out, size_t *outlen)
+/* Portable decoder, used for the blocks the vectorized kernels leave
+   over: see base64_decode below.  OUT may also be IN itself, or come
+   before it: each quantum is read before the bytes it decodes to are
+   written over, at most, its first 3 characters.  */
+static bool
+base64_decode_scalar (const char *in, size_t inlen,
+		      char *out, size_t *outlen)
 {
   size_t outleft = *outlen;
 
@@ -385,6 +651,54 @@ base64_decode (const char *restrict in, size_t inlen,
   return true;
 }
 
+/* Decode base64 encoded input array IN of length INLEN to output
+   array OUT that can hold *OUTLEN bytes.  Return true if decoding was
+   successful, i.e. if the input was valid base64 data, false
+   otherwise.  If *OUTLEN is too small, as many bytes as possible will
+   be written to OUT.  On return, *OUTLEN holds the length of decoded
+   bytes in OUT.  Note that as soon as any non-alphabet characters are
+   encountered, decoding is stopped and false is returned.  This means
+   that, when applicable, you must remove any line terminators that is
+   part of the data stream before calling this function, or call
+   base64_decode_wrapped instead.  */
+bool
+base64_decode (const char *restrict in, size_t inlen,
+	       char *restrict out, size_t *outlen)
+{
+  /* The kernel stops before the first block that is not made of
+     alphabet characters only (which includes the padded one), and the
+     portable loop resumes from there, so errors and partial outputs
+     are reported exactly as before.  */
+  size_t done = decode_kernel (in, inlen, out, *outlen);
+  size_t written = done / 4 * 3;
+  size_t left = *outlen - written;
+  bool ok = base64_decode_scalar (in + done, inlen - done,
+				  out + written, &left);
+
+  *outlen = written + left;
+  return ok;
+}
+
+/* Same as base64_decode, writing the decoded bytes over the front of
+   BUF, which holds the INLEN characters to decode, as the decoded data
+   is never longer than its encoding.  The kernels load each block
+   before storing the bytes it decodes to, which never go past the
+   block, so they run as they do out of place.  On return, *OUTLEN
+   holds the number of bytes decoded at the front of BUF; what follows
+   them is undefined.  */
+bool
+base64_decode_inplace (char *buf, size_t inlen, size_t *outlen)
+{
+  size_t done = decode_kernel (buf, inlen, buf, inlen);
+  size_t written = done / 4 * 3;
+  size_t left = inlen - written;
+  bool ok = base64_decode_scalar (buf + done, inlen - done,
+				  buf + written, &left);
+
+  *outlen = written + left;
+  return ok;
+}
+
 /* Allocate an output buffer in *OUT, and decode the base64 encoded
    data stored in IN of size INLEN to the *OUT buffer.  On return, the
    size of the decoded data is stored in *OUTLEN.  OUTLEN may be NULL,
@@ -423,3 +737,575 @@ base64_decode_alloc (const char *in, size_t inlen, char **out,
 
   return true;
 }
+
+/* Check that IN of length INLEN is accepted by base64_decode, without
+   decoding it.  Return true if it is, storing in *OUTLEN the exact
+   number of bytes it decodes to.  Otherwise return false, storing in
+   *OFFSET the length of the longest prefix of IN that can start valid
+   input: the offset of the first character that is out of the
+   alphabet or misplaced (padding anywhere but at the end of the last
+   quantum, data after it), or INLEN if IN is only truncated.  OUTLEN
+   and OFFSET may be NULL.  */
+bool
+base64_validate (const char *in, size_t inlen, size_t *outlen,
+		 size_t *offset)
+{
+  /* The kernel checks whole blocks of alphabet characters, and the
+     first character out of the alphabet is searched from there.  */
+  size_t i = validate_kernel (in, inlen);
+  size_t bad, end;
+
+  while (i < inlen && isbase64 (in[i]))
+    i++;
+
+  if (i == inlen)
+    {
+      if (inlen % 4 == 0)
+	{
+	  if (outlen)
+	    *outlen = inlen / 4 * 3;
+	  return true;
+	}
+      bad = inlen;
+    }
+  else if (in[i] != '=' || i % 4 < 2)
+    bad = i;
+  else
+    {
+      /* Padding must fill the rest of the last quantum.  */
+      end = i - i % 4 + 4;
+      bad = i + 1;
+      while (bad < end && bad < inlen && in[bad] == '=')
+	bad++;
+      if (bad == end && end == inlen)
+	{
+	  if (outlen)
+	    *outlen = i / 4 * 3 + i % 4 - 1;
+	  return true;
+	}
+    }
+
+  if (offset)
+    *offset = bad;
+  return false;
+}
+
+/* Bytes of input past the end of a line that base64_encode_wrapped
+   hands to the kernel, so that the blocks it loads reach the end of
+   the line; it may encode them too, writing up to
+   BASE64_LENGTH (WRAP_SLACK) characters past the line.  */
+#define WRAP_SLACK 16
+
+/* Encode the group of 3 bytes (fewer at the end of IN) starting at
+   byte START of IN to the 4 characters of QUANTUM.  */
+static inline void
+encode_group (const char *in, size_t inlen, size_t start, char *quantum)
+{
+  base64_encode_scalar (in + start, inlen - start < 3 ? inlen - start : 3,
+			quantum, 4);
+}
+
+/* Base64 encode IN array of size INLEN into OUT array of size OUTLEN,
+   as base64_encode does, ending every LINE characters and the last
+   line with the EOL string.  LINE may be 0 for a single line without
+   terminator, i.e. the output of base64_encode.  */
+void
+base64_encode_wrapped (const char *restrict in, size_t inlen,
+		       char *restrict out, size_t outlen,
+		       size_t line, const char *eol)
+{
+  const size_t margin = BASE64_LENGTH (WRAP_SLACK);
+  size_t eollen = strlen (eol);
+  size_t total = BASE64_LENGTH (inlen);
+  size_t pos = 0, column = 0;
+  char quantum[4];
+
+  if (!line)
+    {
+      base64_encode (in, inlen, out, outlen);
+      return;
+    }
+
+  /* Lines of whole groups are left to the wrapped kernels.  */
+  if (line % 4 == 0 && eollen <= 4)
+    {
+      size_t done = encode_wrapped_kernel (in, inlen, out, outlen,
+					   line, eol, eollen);
+      size_t n = done / (line / 4 * 3) * (line + eollen);
+
+      out += n;
+      outlen -= n;
+      pos = done / 3 * 4;
+    }
+
+  /* The other ones have their whole groups encoded by the plain kernel
+     straight to OUT.  It may go on past the end of the line, which the
+     terminator and the next lines then write over, so this is only
+     done while enough of the output follows.  The groups that a
+     terminator splits are encoded to QUANTUM and copied around it.  */
+  while (line >= 4 && total - pos >= line + margin
+	 && outlen >= line + eollen + margin)
+    {
+      size_t head = (4 - pos % 4) % 4;
+      size_t tail = (line - head) % 4;
+      size_t start = (pos + head) / 4 * 3;
+      size_t len = (line - head) / 4 * 3;
+      size_t done;
+
+      if (head)
+	{
+	  encode_group (in, inlen, pos / 4 * 3, quantum);
+	  memcpy (out, quantum + 4 - head, head);
+	  out += head;
+	}
+
+      done = encode_kernel (in + start, (inlen - start < len + WRAP_SLACK
+					 ? inlen - start : len + WRAP_SLACK),
+			    out);
+      if (done < len)
+	base64_encode_scalar (in + start + done, len - done,
+			      out + done / 3 * 4, (len - done) / 3 * 4);
+      out += len / 3 * 4;
+
+      if (tail)
+	{
+	  encode_group (in, inlen, start + len, quantum);
+	  memcpy (out, quantum, tail);
+	  out += tail;
+	}
+
+      memcpy (out, eol, eollen);
+      out += eollen;
+      outlen -= line + eollen;
+      pos += line;
+    }
+
+  /* The last lines, and those that do not fit in OUTLEN, are written a
+     character at a time.  */
+  if (pos < total)
+    encode_group (in, inlen, pos / 4 * 3, quantum);
+
+  while (pos < total && outlen)
+    {
+      *out++ = quantum[pos % 4];
+      outlen--;
+      pos++;
+      if (pos < total && pos % 4 == 0)
+	encode_group (in, inlen, pos / 4 * 3, quantum);
+
+      if (++column == line || pos == total)
+	{
+	  size_t k = eollen < outlen ? eollen : outlen;
+
+	  memcpy (out, eol, k);
+	  out += k;
+	  outlen -= k;
+	  column = 0;
+	}
+    }
+
+  if (outlen)
+    *out = '\0';
+}
+
+static inline bool
+isspace64 (char ch)
+{
+  return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+/* Decode base64 encoded input array IN of length INLEN to output
+   array OUT that can hold *OUTLEN bytes, as base64_decode does, except
+   that whitespace (space, '\t', '\n', '\v', '\f' and '\r') is skipped
+   wherever it appears, e.g. the line terminators of MIME or PEM
+   data.  */
+bool
+base64_decode_wrapped (const char *restrict in, size_t inlen,
+		       char *restrict out, size_t *outlen)
+{
+  size_t outleft = *outlen;
+  bool ok = true;
+
+  while (ok)
+    {
+      char quantum[4];
+      size_t len = outleft, i = 0;
+      size_t done = decode_wrapped_kernel (in, inlen, out, &len);
+
+      in += done;
+      inlen -= done;
+      out += len;
+      outleft -= len;
+
+      /* The kernel stops at the whitespace found within a quantum, at
+	 invalid characters and at the padding: the next quantum is
+	 gathered and decoded here, then the kernel resumes after the
+	 whitespace that follows it.  */
+      for (; inlen && i < 4; in++, inlen--)
+	if (!isspace64 (*in))
+	  quantum[i++] = *in;
+      while (inlen && isspace64 (*in))
+	in++, inlen--;
+
+      if (!i)
+	break;
+
+      len = outleft;
+      ok = (base64_decode_scalar (quantum, i, out, &len)
+	    && !(inlen && quantum[3] == '='));
+      out += len;
+      outleft -= len;
+    }
+
+  *outlen -= outleft;
+  return ok;
+}
+
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+# define BASE64_BIG_ENDIAN 1
+#else
+# define BASE64_BIG_ENDIAN 0
+#endif
+
+/* Size of the buffer through which base64_encode_be and
+   base64_decode_be swap the bytes the kernels leave over: a multiple
+   of 3 and of every element width.  */
+#define SWAP_BUFFER_SIZE 768
+
+/* Copy the LEN bytes of IN to OUT, reversing the bytes of each
+   element of WIDTH bytes.  The bytes of an incomplete last element
+   are copied as they are.  */
+static void
+swap_elements (char *restrict out, const char *restrict in, size_t len,
+	       size_t width)
+{
+  size_t i, j;
+
+  for (i = 0; i + width <= len; i += width)
+    for (j = 0; j < width; j++)
+      out[i + j] = in[i + width - 1 - j];
+  for (; i < len; i++)
+    out[i] = in[i];
+}
+
+/* Base64 encode the elements of WIDTH bytes of IN, of total size
+   INLEN, in big-endian order into OUT array of size OUTLEN, as
+   base64_encode does.  */
+void
+base64_encode_be (const char *restrict in, size_t inlen,
+		  char *restrict out, size_t outlen, size_t width)
+{
+  char buf[SWAP_BUFFER_SIZE];
+  size_t room = outlen / 4 * 3;
+  size_t done;
+
+  if (BASE64_BIG_ENDIAN || width <= 1)
+    {
+      base64_encode (in, inlen, out, outlen);
+      return;
+    }
+
+  /* The kernel swaps the bytes as it encodes whole groups; the rest,
+     which includes the padding, is swapped through BUF then encoded
+     by the portable loop.  */
+  done = encode_be_kernel (in, inlen < room ? inlen : room, out, width);
+  out += done / 3 * 4;
+  outlen -= done / 3 * 4;
+
+  do
+    {
+      size_t len = inlen - done < sizeof buf ? inlen - done : sizeof buf;
+      size_t written = len / 3 * 4;
+
+      swap_elements (buf, in + done, len, width);
+      base64_encode_scalar (buf, len, out, outlen);
+      if (outlen <= written)
+	break;
+
+      done += len;
+      out += written;
+      outlen -= written;
+    }
+  while (done < inlen);
+}
+
+/* Decode base64 encoded input array IN of length INLEN to the
+   elements of WIDTH bytes stored in big-endian order it holds, written
+   to OUT in the byte order of the machine.  OUT must hold the whole
+   decoded data: see base64.h.  */
+bool
+base64_decode_be (const char *restrict in, size_t inlen,
+		  char *restrict out, size_t *outlen, size_t width)
+{
+  char buf[SWAP_BUFFER_SIZE];
+  size_t done, written;
+
+  /* Valid input is made of whole quanta, only the last one being
+     padded.  */
+  written = inlen / 4 * 3;
+  if (inlen >= 1 && in[inlen - 1] == '=')
+    written--;
+  if (inlen >= 2 && in[inlen - 2] == '=')
+    written--;
+  if (written > *outlen || written % (width ? width : 1) != 0)
+    return false;
+
+  if (BASE64_BIG_ENDIAN || width <= 1)
+    return base64_decode (in, inlen, out, outlen);
+
+  done = decode_be_kernel (in, inlen, out, *outlen, width);
+  written = done / 4 * 3;
+
+  /* Decode the rest by blocks of SWAP_BUFFER_SIZE bytes, which hold
+     whole elements, then swap them to OUT.  Only the last block may
+     be padded.  */
+  while (done < inlen)
+    {
+      size_t chunk = inlen - done;
+      size_t len = sizeof buf;
+
+      if (chunk > sizeof buf / 3 * 4)
+	chunk = sizeof buf / 3 * 4;
+
+      if (!base64_decode_scalar (in + done, chunk, buf, &len)
+	  || (done + chunk < inlen && len != sizeof buf)
+	  || len > *outlen - written)
+	return false;
+
+      swap_elements (out + written, buf, len, width);
+      done += chunk;
+      written += len;
+    }
+
+  *outlen = written;
+  return true;
+}
+
+/* Prepare CTX for a new incremental encoding.  */
+void
+base64_encode_ctx_init (struct base64_encode_context *ctx)
+{
+  ctx->i = 0;
+}
+
+/* Encode the INLEN bytes of IN, following those given to the previous
+   calls on CTX, to OUT, which must hold at least
+   BASE64_ENCODE_UPDATE_LENGTH (CTX, INLEN) bytes.  Only whole 3-byte
+   groups are encoded, the remaining bytes being kept in CTX.  Return
+   the number of characters written, which are not zero
+   terminated.  */
+size_t
+base64_encode_update (struct base64_encode_context *ctx,
+		      const char *restrict in, size_t inlen,
+		      char *restrict out)
+{
+  size_t written = 0;
+  size_t n;
+
+  if (ctx->i)
+    {
+      while (ctx->i < 3 && inlen)
+	{
+	  ctx->buf[ctx->i++] = *in++;
+	  inlen--;
+	}
+
+      if (ctx->i < 3)
+	return 0;
+
+      base64_encode (ctx->buf, 3, out, 4);
+      ctx->i = 0;
+      written += 4;
+    }
+
+  n = inlen / 3 * 3;
+  base64_encode (in, n, out + written, n / 3 * 4);
+  written += n / 3 * 4;
+
+  for (; n < inlen; n++)
+    ctx->buf[ctx->i++] = in[n];
+
+  return written;
+}
+
+/* Encode the bytes left in CTX, with padding, to OUT, which must hold
+   at least 4 bytes.  Return the number of characters written, which
+   are not zero terminated.  */
+size_t
+base64_encode_finish (struct base64_encode_context *ctx, char *out)
+{
+  if (!ctx->i)
+    return 0;
+
+  base64_encode (ctx->buf, ctx->i, out, 4);
+  ctx->i = 0;
+
+  return 4;
+}
+
+/* Prepare CTX for a new incremental decoding.  */
+void
+base64_decode_ctx_init (struct base64_decode_context *ctx)
+{
+  ctx->i = 0;
+  ctx->done = false;
+}
+
+/* Decode the INLEN characters of IN, following those given to the
+   previous calls on CTX, to OUT, which must hold at least
+   BASE64_DECODE_UPDATE_LENGTH (CTX, INLEN) bytes.  Only whole
+   quanta are decoded, the remaining characters being kept in CTX.
+   On return, *OUTLEN holds the number of bytes written.  Return false
+   as soon as the input is found not to be valid base64 data, which
+   includes data following the padding.  */
+bool
+base64_decode_update (struct base64_decode_context *ctx,
+		      const char *restrict in, size_t inlen,
+		      char *restrict out, size_t *outlen)
+{
+  size_t written = 0;
+  size_t n, len;
+
+  *outlen = 0;
+
+  if (!inlen)
+    return true;
+
+  if (ctx->done)
+    return false;
+
+  if (ctx->i)
+    {
+      while (ctx->i < 4 && inlen)
+	{
+	  ctx->buf[ctx->i++] = *in++;
+	  inlen--;
+	}
+
+      if (ctx->i < 4)
+	return true;
+
+      len = 3;
+      if (!base64_decode (ctx->buf, 4, out, &len))
+	return false;
+
+      ctx->i = 0;
+      ctx->done = ctx->buf[3] == '=';
+      written += len;
+
+      if (ctx->done && inlen)
+	{
+	  *outlen = written;
+	  return false;
+	}
+    }
+
+  /* A padded quantum is only accepted by base64_decode at the end of
+     its input, which is where it stops being valid in a stream too,
+     unless nothing else follows.  */
+  n = inlen / 4 * 4;
+  if (n)
+    {
+      len = n / 4 * 3;
+      if (!base64_decode (in, n, out + written, &len))
+	{
+	  *outlen = written + len;
+	  return false;
+	}
+
+      written += len;
+      ctx->done = in[n - 1] == '=';
+
+      if (ctx->done && n < inlen)
+	{
+	  *outlen = written;
+	  return false;
+	}
+    }
+
+  for (; n < inlen; n++)
+    ctx->buf[ctx->i++] = in[n];
+
+  *outlen = written;
+  return true;
+}
+
+/* Check that the input given to CTX ended on a whole quantum.  */
+bool
+base64_decode_finish (struct base64_decode_context *ctx)
+{
+  return ctx->i == 0;
+}
+
+/* Encode the N messages IN[i] of INLEN[i] bytes back to back into OUT,
+   without terminating zero, and store in OFFSETS, of N + 1 entries,
+   the offset of the encoding of each message in OUT followed by their
+   total length, which is returned.  Nothing is written to OUT if that
+   length exceeds OUTLEN, so that a first call with an OUTLEN of 0
+   gives the size of the buffer to allocate.  The vectorized kernels
+   fill their lanes from several messages at once, which keeps them
+   busy on messages shorter than a vector.  */
+size_t
+base64_encode_batch (const char *const *in, const size_t *inlen, size_t n,
+		     char *restrict out, size_t outlen, size_t *offsets)
+{
+  size_t i, total = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      offsets[i] = total;
+      total += BASE64_LENGTH (inlen[i]);
+    }
+  offsets[n] = total;
+
+  if (total > outlen)
+    return total;
+
+  for (i = encode_batch_kernel (in, inlen, n, out, total, offsets); i < n; i++)
+    base64_encode (in[i], inlen[i], out + offsets[i],
+		   offsets[i + 1] - offsets[i]);
+  return total;
+}
+
+/* Decode the N messages IN[i] of INLEN[i] characters back to back
+   into OUT, which can hold OUTLEN bytes, storing in OFFSETS, of N + 1
+   entries, the offset of each decoded message in OUT followed by their
+   total size.  Return the number of messages decoded: N on success,
+   otherwise the index of the first message that is not valid base64
+   or does not fit in OUT, the offsets being only meaningful up to
+   it.  OUTLEN is large enough if it is the sum of INLEN[i] / 4 * 3.  */
+size_t
+base64_decode_batch (const char *const *in, const size_t *inlen, size_t n,
+		     char *restrict out, size_t outlen, size_t *offsets)
+{
+  size_t i, limit, total = 0;
+
+  /* The decoded size of a message only depends on its length and its
+     padding, which lays out the output before anything is decoded.  */
+  for (i = 0; i < n; i++)
+    {
+      size_t len = inlen[i] / 4 * 3;
+
+      offsets[i] = total;
+      if (inlen[i] % 4)
+	break;
+      if (len && in[i][inlen[i] - 1] == '=')
+	len -= 1 + (in[i][inlen[i] - 2] == '=');
+      if (len > outlen - total)
+	break;
+      total += len;
+    }
+  offsets[i] = total;
+  limit = i;
+
+  for (i = decode_batch_kernel (in, inlen, limit, out, total, offsets);
+       i < limit; i++)
+    {
+      size_t len = offsets[i + 1] - offsets[i];
+
+      if (!base64_decode (in[i], inlen[i], out + offsets[i], &len)
+	  || len != offsets[i + 1] - offsets[i])
+	return i;
+    }
+  return limit;
+}
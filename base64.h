@@ -38,6 +38,28 @@ extern "C"
 {
 #endif
 
+/* Implementations of the encoder and decoder.  The fastest one
+   supported by the processor is selected when the library is loaded;
+   base64_set_backend may be used to force another one (e.g. for
+   testing or benchmarking).  It must not be called while another
+   thread is encoding or decoding.  BASE64_BACKEND_SCALAR is the
+   original byte-at-a-time loop; BASE64_BACKEND_SWAR, its table-driven
+   replacement working on 64-bit words, runs on any processor.  */
+enum base64_backend
+{
+  BASE64_BACKEND_AUTO,
+  BASE64_BACKEND_SCALAR,
+  BASE64_BACKEND_SWAR,
+  BASE64_BACKEND_SSSE3,
+  BASE64_BACKEND_AVX2
+};
+
+extern bool base64_set_backend (enum base64_backend backend);
+
+extern enum base64_backend base64_get_backend (void);
+
+extern const char *base64_backend_name (enum base64_backend backend);
+
 extern bool isbase64 (char ch);
 
 extern void base64_encode (const char *RESTRICT in, size_t inlen,
@@ -51,6 +73,109 @@ extern bool base64_decode (const char *RESTRICT in, size_t inlen,
 extern bool base64_decode_alloc (const char *in, size_t inlen,
 				 char **out, size_t *outlen);
 
+/* Same as base64_decode, decoding BUF over itself.  */
+extern bool base64_decode_inplace (char *buf, size_t inlen, size_t *outlen);
+
+/* Check that IN is accepted by base64_decode without decoding it:
+   see base64.c for the offset reported on failure.  */
+extern bool base64_validate (const char *in, size_t inlen, size_t *outlen,
+			     size_t *offset);
+
+/* Line length of MIME (RFC 2045) base64 data.  */
+# define BASE64_MIME_LINE_LENGTH 76
+
+/* Length of the output of base64_encode_wrapped for INLEN bytes,
+   lines of LINE characters and terminators of EOLLEN characters.  */
+# define BASE64_WRAPPED_LENGTH(inlen, line, eollen) \
+  (BASE64_LENGTH (inlen) \
+   + ((line) ? (BASE64_LENGTH (inlen) + (line) - 1) / (line) * (eollen) : 0))
+
+/* Same as base64_encode, ending every line of LINE characters (0 for
+   no wrapping), the last one included, with the EOL string, e.g.
+   "\r\n" for MIME.  */
+extern void base64_encode_wrapped (const char *RESTRICT in, size_t inlen,
+				   char *RESTRICT out, size_t outlen,
+				   size_t line, const char *eol);
+
+/* Same as base64_decode, skipping the whitespace found anywhere in
+   IN (line terminators included) instead of failing on it.  */
+extern bool base64_decode_wrapped (const char *RESTRICT in, size_t inlen,
+				   char *RESTRICT out, size_t *outlen);
+
+/* Encode or decode the N messages IN[i] of INLEN[i] bytes back to
+   back into OUT, the offset of each one in OUT being stored in
+   OFFSETS[i] and the total length in OFFSETS[N].  base64_encode_batch
+   returns that length, and only writes to OUT if it fits in OUTLEN;
+   base64_decode_batch returns the number of messages decoded, which is
+   N unless one of them is invalid or does not fit.  */
+extern size_t base64_encode_batch (const char *const *in,
+				   const size_t *inlen, size_t n,
+				   char *RESTRICT out, size_t outlen,
+				   size_t *offsets);
+
+extern size_t base64_decode_batch (const char *const *in,
+				   const size_t *inlen, size_t n,
+				   char *RESTRICT out, size_t outlen,
+				   size_t *offsets);
+
+/* Same as base64_encode and base64_decode, for arrays of integers or
+   floating point numbers of WIDTH bytes (1, 2, 4 or 8) stored in the
+   byte order of the machine: each element is encoded most significant
+   byte first, i.e. in network byte order, so that the data can be
+   exchanged between machines of different endianness.  INLEN should
+   be a multiple of WIDTH; the bytes of an incomplete last element are
+   encoded as they are.  base64_decode_be returns false if the input is
+   invalid, if its decoded size is not a multiple of WIDTH, or if it
+   does not fit in *OUTLEN bytes.  */
+extern void base64_encode_be (const char *RESTRICT in, size_t inlen,
+			      char *RESTRICT out, size_t outlen,
+			      size_t width);
+
+extern bool base64_decode_be (const char *RESTRICT in, size_t inlen,
+			      char *RESTRICT out, size_t *outlen,
+			      size_t width);
+
+/* State of an incremental encoder: the bytes of an incomplete 3-byte
+   group, kept until the next call.  */
+struct base64_encode_context
+{
+  unsigned int i;
+  char buf[3];
+};
+
+/* State of an incremental decoder: the characters of an incomplete
+   4-character quantum, and whether the padding has been seen.  */
+struct base64_decode_context
+{
+  unsigned int i;
+  char buf[4];
+  bool done;
+};
+
+/* Largest number of bytes written by base64_encode_update and
+   base64_decode_update when called on INLEN more bytes.  */
+# define BASE64_ENCODE_UPDATE_LENGTH(ctx, inlen) \
+  ((((ctx)->i + (inlen)) / 3) * 4)
+# define BASE64_DECODE_UPDATE_LENGTH(ctx, inlen) \
+  ((((ctx)->i + (inlen)) / 4) * 3)
+
+extern void base64_encode_ctx_init (struct base64_encode_context *ctx);
+
+extern size_t base64_encode_update (struct base64_encode_context *ctx,
+				    const char *RESTRICT in, size_t inlen,
+				    char *RESTRICT out);
+
+extern size_t base64_encode_finish (struct base64_encode_context *ctx,
+				    char *out);
+
+extern void base64_decode_ctx_init (struct base64_decode_context *ctx);
+
+extern bool base64_decode_update (struct base64_decode_context *ctx,
+				  const char *RESTRICT in, size_t inlen,
+				  char *RESTRICT out, size_t *outlen);
+
+extern bool base64_decode_finish (struct base64_decode_context *ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,572 @@
+#ifndef BASE64_ALPHABET
+#define BASE64_ALPHABET
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef RESTRICT
+#define RESTRICT
+#endif
+#include "base64.h"
+
+#if (defined __x86_64__ || defined __i386__) && defined __GNUC__
+#define BASE64_ALPHABET_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define BASE64_ALPHABET_X86_KERNELS 0
+#endif
+
+// Alphabet policies provide the character of each of the 64 values through
+// a constexpr symbol(value) function. Any alphabet of 64 distinct characters
+// other than '=' can be used; those made of A-Z, a-z and 0-9 followed by two
+// other characters, like the ones below, are also handled by the SSSE3 and
+// AVX2 kernels.
+template<char C62, char C63>
+struct base64_alphanumeric_alphabet
+{
+  static constexpr char symbol(unsigned value)
+  {
+    return value < 26 ? 'A' + value
+         : value < 52 ? 'a' + (value - 26)
+         : value < 62 ? '0' + (value - 52)
+         : value == 62 ? C62 : C63;
+  }
+};
+
+// RFC 4648, section 4.
+using base64_standard_alphabet = base64_alphanumeric_alphabet<'+', '/'>;
+
+// RFC 4648, section 5, used in URLs, file names and JSON Web Tokens.
+using base64_url_alphabet = base64_alphanumeric_alphabet<'-', '_'>;
+
+// Padding policies: whether the encoded data is completed with '=' to a
+// multiple of 4 characters, which the decoder then requires.
+struct base64_padded
+{
+  static constexpr bool pad = true;
+};
+
+struct base64_unpadded
+{
+  static constexpr bool pad = false;
+};
+
+template<typename V, size_t N>
+struct base64_table
+{
+  V values[N];
+
+  constexpr V operator[](size_t i) const { return values[i]; }
+};
+
+// Encoding and decoding tables of Alphabet, built at compile time. The
+// decoding table maps the characters outside of the alphabet to -1.
+template<typename Alphabet>
+struct base64_tables
+{
+  static constexpr base64_table<char, 64> make_encode()
+  {
+    base64_table<char, 64> table{};
+    for(unsigned i = 0; i < 64; ++i)
+      table.values[i] = Alphabet::symbol(i);
+    return table;
+  }
+
+  static constexpr base64_table<signed char, 256> make_decode()
+  {
+    base64_table<signed char, 256> table{};
+    for(unsigned i = 0; i < 256; ++i)
+      table.values[i] = -1;
+    for(unsigned i = 0; i < 64; ++i)
+      table.values[static_cast<unsigned char>(Alphabet::symbol(i))] = static_cast<signed char>(i);
+    return table;
+  }
+
+  static constexpr bool valid()
+  {
+    for(unsigned i = 0; i < 64; ++i) {
+      if (Alphabet::symbol(i) == '=')
+        return false;
+      for(unsigned j = 0; j < i; ++j)
+        if (Alphabet::symbol(i) == Alphabet::symbol(j))
+          return false;
+    }
+    return true;
+  }
+
+  static constexpr bool alphanumeric()
+  {
+    for(unsigned i = 0; i < 62; ++i)
+      if (Alphabet::symbol(i) != base64_standard_alphabet::symbol(i))
+        return false;
+    return true;
+  }
+
+  static constexpr base64_table<char, 64> encode = make_encode();
+  static constexpr base64_table<signed char, 256> decode = make_decode();
+};
+
+template<typename Alphabet>
+constexpr base64_table<char, 64> base64_tables<Alphabet>::encode;
+
+template<typename Alphabet>
+constexpr base64_table<signed char, 256> base64_tables<Alphabet>::decode;
+
+#if BASE64_ALPHABET_X86_KERNELS
+
+// Vectorized kernels of the alphanumeric alphabets, following base64_simd.c.
+// The encoder only differs by the offsets of the last two classes of its
+// translation table. The decoder validates the letters and digits by
+// looking up the range of low nibbles allowed for their high nibble, and
+// recognizes C62 and C63 by comparison, so that it works whatever these
+// two are. Like their base64_simd.c counterparts, the kernels return the
+// number of input bytes they consumed.
+template<char C62, char C63>
+struct base64_alphanumeric_kernels
+{
+  __attribute__ ((target ("ssse3")))
+  static __m128i reshuffle_128(__m128i in)
+  {
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+    return _mm_or_si128(t1, t3);
+  }
+
+  __attribute__ ((target ("ssse3")))
+  static __m128i translate_128(__m128i in)
+  {
+    const __m128i lut = _mm_setr_epi8('A', 'a' - 26,
+                                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                      C62 - 62, C63 - 63, 0, 0);
+
+    __m128i classes = _mm_subs_epu8(in, _mm_set1_epi8(51));
+    classes = _mm_sub_epi8(classes, _mm_cmpgt_epi8(in, _mm_set1_epi8(25)));
+
+    return _mm_add_epi8(in, _mm_shuffle_epi8(lut, classes));
+  }
+
+  __attribute__ ((target ("ssse3")))
+  static size_t encode_ssse3(const char* in, size_t inlen, char* out)
+  {
+    size_t done = 0;
+
+    for(; inlen - done >= 16; done += 12, out += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out), translate_128(reshuffle_128(v)));
+    }
+
+    return done;
+  }
+
+  __attribute__ ((target ("avx2")))
+  static size_t encode_avx2(const char* in, size_t inlen, char* out)
+  {
+    const __m256i lut = _mm256_setr_epi8('A', 'a' - 26,
+                                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                         C62 - 62, C63 - 63, 0, 0,
+                                         'A', 'a' - 26,
+                                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                         C62 - 62, C63 - 63, 0, 0);
+    size_t done = 0;
+
+    for(; inlen - done >= 28; done += 24, out += 32) {
+      const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done));
+      const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done + 12));
+      __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+      v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                                  1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+      const __m256i t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+      const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+      const __m256i t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+      const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+      v = _mm256_or_si256(t1, t3);
+
+      __m256i classes = _mm256_subs_epu8(v, _mm256_set1_epi8(51));
+      classes = _mm256_sub_epi8(classes, _mm256_cmpgt_epi8(v, _mm256_set1_epi8(25)));
+      v = _mm256_add_epi8(v, _mm256_shuffle_epi8(lut, classes));
+
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), v);
+    }
+
+    return done + encode_ssse3(in + done, inlen - done, out);
+  }
+
+  // Offset from the letters and digits to their 6-bit values, by high
+  // nibble, and the correction C62 and C63 need on top of the offset of
+  // their own high nibble.
+  static constexpr signed char roll(unsigned hi)
+  {
+    return hi == 3 ? 4 : hi == 4 || hi == 5 ? -65 : hi == 6 || hi == 7 ? -71 : 0;
+  }
+
+  static constexpr char fix_62 = static_cast<char>(62 - C62 - roll(static_cast<unsigned char>(C62) >> 4));
+  static constexpr char fix_63 = static_cast<char>(63 - C63 - roll(static_cast<unsigned char>(C63) >> 4));
+
+  // The letters and digits with high nibble h have a low nibble greater
+  // than BELOW[h] and less than ABOVE[h].
+#define BASE64_ALPHANUMERIC_BELOW 15, 15, 15, -1, 0, -1, 0, -1, 15, 15, 15, 15, 15, 15, 15, 15
+#define BASE64_ALPHANUMERIC_ABOVE 0, 0, 0, 10, 16, 11, 16, 11, 0, 0, 0, 0, 0, 0, 0, 0
+#define BASE64_ALPHANUMERIC_ROLL 0, 0, 0, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+
+  __attribute__ ((target ("ssse3")))
+  static size_t decode_ssse3(const char* in, size_t inlen, char* out, size_t outlen)
+  {
+    const __m128i below = _mm_setr_epi8(BASE64_ALPHANUMERIC_BELOW);
+    const __m128i above = _mm_setr_epi8(BASE64_ALPHANUMERIC_ABOVE);
+    const __m128i rolls = _mm_setr_epi8(BASE64_ALPHANUMERIC_ROLL);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    size_t done = 0;
+
+    for(; inlen - done >= 16 && outlen >= 16; done += 16, out += 12, outlen -= 12) {
+      __m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done));
+
+      const __m128i hi = _mm_and_si128(_mm_srli_epi32(str, 4), nibble);
+      const __m128i lo = _mm_and_si128(str, nibble);
+      const __m128i s62 = _mm_cmpeq_epi8(str, _mm_set1_epi8(C62));
+      const __m128i s63 = _mm_cmpeq_epi8(str, _mm_set1_epi8(C63));
+      const __m128i alnum = _mm_and_si128(_mm_cmpgt_epi8(lo, _mm_shuffle_epi8(below, hi)),
+                                          _mm_cmpgt_epi8(_mm_shuffle_epi8(above, hi), lo));
+
+      if (_mm_movemask_epi8(_mm_or_si128(alnum, _mm_or_si128(s62, s63))) != 0xffff)
+        break;
+
+      __m128i roll = _mm_shuffle_epi8(rolls, hi);
+      roll = _mm_add_epi8(roll, _mm_and_si128(s62, _mm_set1_epi8(fix_62)));
+      roll = _mm_add_epi8(roll, _mm_and_si128(s63, _mm_set1_epi8(fix_63)));
+      str = _mm_add_epi8(str, roll);
+
+      str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+      str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+      str = _mm_shuffle_epi8(str, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out), str);
+    }
+
+    return done;
+  }
+
+  __attribute__ ((target ("avx2")))
+  static size_t decode_avx2(const char* in, size_t inlen, char* out, size_t outlen)
+  {
+    const __m256i below = _mm256_setr_epi8(BASE64_ALPHANUMERIC_BELOW, BASE64_ALPHANUMERIC_BELOW);
+    const __m256i above = _mm256_setr_epi8(BASE64_ALPHANUMERIC_ABOVE, BASE64_ALPHANUMERIC_ABOVE);
+    const __m256i rolls = _mm256_setr_epi8(BASE64_ALPHANUMERIC_ROLL, BASE64_ALPHANUMERIC_ROLL);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    size_t done = 0;
+
+    for(; inlen - done >= 32 && outlen >= 32; done += 32, out += 24, outlen -= 24) {
+      __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + done));
+
+      const __m256i hi = _mm256_and_si256(_mm256_srli_epi32(str, 4), nibble);
+      const __m256i lo = _mm256_and_si256(str, nibble);
+      const __m256i s62 = _mm256_cmpeq_epi8(str, _mm256_set1_epi8(C62));
+      const __m256i s63 = _mm256_cmpeq_epi8(str, _mm256_set1_epi8(C63));
+      const __m256i alnum = _mm256_and_si256(_mm256_cmpgt_epi8(lo, _mm256_shuffle_epi8(below, hi)),
+                                             _mm256_cmpgt_epi8(_mm256_shuffle_epi8(above, hi), lo));
+
+      if (_mm256_movemask_epi8(_mm256_or_si256(alnum, _mm256_or_si256(s62, s63))) != -1)
+        break;
+
+      __m256i roll = _mm256_shuffle_epi8(rolls, hi);
+      roll = _mm256_add_epi8(roll, _mm256_and_si256(s62, _mm256_set1_epi8(fix_62)));
+      roll = _mm256_add_epi8(roll, _mm256_and_si256(s63, _mm256_set1_epi8(fix_63)));
+      str = _mm256_add_epi8(str, roll);
+
+      str = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+      str = _mm256_madd_epi16(str, _mm256_set1_epi32(0x00011000));
+      str = _mm256_shuffle_epi8(str, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+      str = _mm256_permutevar8x32_epi32(str, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), str);
+    }
+
+    return done + decode_ssse3(in + done, inlen - done, out, outlen);
+  }
+
+#undef BASE64_ALPHANUMERIC_BELOW
+#undef BASE64_ALPHANUMERIC_ABOVE
+#undef BASE64_ALPHANUMERIC_ROLL
+};
+
+#endif
+
+// Base64 codec of the given alphabet and padding policies. The vectorized
+// kernel is chosen once per call from base64_get_backend(); the scalar code
+// completing it looks every character up in the tables of Alphabet.
+template<typename Alphabet = base64_standard_alphabet, typename Padding = base64_padded>
+class base64_codec
+{
+  using tables = base64_tables<Alphabet>;
+
+  static_assert(tables::valid(), "A base64 alphabet needs 64 distinct characters other than '='");
+
+public:
+  // Number of characters encoding bytes bytes.
+  static constexpr size_t encoded_size(size_t bytes)
+  {
+    return Padding::pad ? (bytes + 2) / 3 * 4 : bytes / 3 * 4 + (bytes % 3 ? bytes % 3 + 1 : 0);
+  }
+
+  // Number of bytes encoded in the sz characters of in, assuming they are
+  // valid.
+  static constexpr size_t decoded_size(const char* in, size_t sz)
+  {
+    if (Padding::pad)
+      while (sz > 0 && in[sz - 1] == '=')
+        --sz;
+    return sz / 4 * 3 + (sz % 4 ? sz % 4 - 1 : 0);
+  }
+
+  // Encodes the inlen bytes of in to the encoded_size(inlen) characters of
+  // out, and returns their number. out is not zero-terminated.
+  static size_t encode(const char* in, size_t inlen, char* out)
+  {
+    const size_t done = encode_kernel(in, inlen, out);
+    return done / 3 * 4 + encode_scalar(in + done, inlen - done, out + done / 3 * 4);
+  }
+
+  // Decodes the inlen characters of in to out, which has room for *outlen
+  // bytes, and sets *outlen to the number of bytes written. Returns false
+  // if in is not valid for this alphabet and padding, or if out is too
+  // small.
+  static bool decode(const char* in, size_t inlen, char* out, size_t* outlen)
+  {
+    if (!decodable(in, inlen, *outlen))
+      return false;
+
+    const size_t done = decode_kernel(in, body_size(inlen), out, *outlen);
+    return decode_scalar(in, inlen, done, out, outlen);
+  }
+
+  // Same as encode and decode without the vectorized kernels, usable in
+  // constant expressions, on bytes of type Byte (char, unsigned char or
+  // uint8_t).
+  template<typename Byte>
+  static constexpr size_t encode_constexpr(const Byte* in, size_t inlen, char* out)
+  {
+    return encode_scalar(in, inlen, out);
+  }
+
+  template<typename Byte>
+  static constexpr bool decode_constexpr(const char* in, size_t inlen, Byte* out, size_t* outlen)
+  {
+    return decodable(in, inlen, *outlen) && decode_scalar(in, inlen, 0, out, outlen);
+  }
+
+private:
+  template<typename Byte>
+  static constexpr unsigned byte(Byte c) { return static_cast<unsigned char>(c); }
+
+  // Size of the characters before the last quantum, which may be
+  // incomplete or padded.
+  static constexpr size_t body_size(size_t inlen) { return inlen == 0 ? 0 : (inlen - 1) / 4 * 4; }
+
+  static constexpr bool decodable(const char* in, size_t inlen, size_t outlen)
+  {
+    return inlen % 4 != 1 && (!Padding::pad || inlen % 4 == 0) && outlen >= decoded_size(in, inlen);
+  }
+
+  // Encodes the bytes left by the kernels, one group at a time.
+  template<typename Byte>
+  static constexpr size_t encode_scalar(const Byte* in, size_t inlen, char* out)
+  {
+    char* end = out;
+
+    for(; inlen >= 3; in += 3, inlen -= 3, end += 4) {
+      const unsigned v = byte(in[0]) << 16 | byte(in[1]) << 8 | byte(in[2]);
+      end[0] = tables::encode[v >> 18];
+      end[1] = tables::encode[v >> 12 & 0x3f];
+      end[2] = tables::encode[v >> 6 & 0x3f];
+      end[3] = tables::encode[v & 0x3f];
+    }
+
+    if (inlen > 0) {
+      const unsigned v = byte(in[0]) << 16 | (inlen > 1 ? byte(in[1]) << 8 : 0);
+      *end++ = tables::encode[v >> 18];
+      *end++ = tables::encode[v >> 12 & 0x3f];
+      if (inlen > 1)
+        *end++ = tables::encode[v >> 6 & 0x3f];
+      if (Padding::pad)
+        for(size_t i = inlen; i < 3; ++i)
+          *end++ = '=';
+    }
+
+    return end - out;
+  }
+
+  // Decodes the characters of in from done, a multiple of 4 decoded by the
+  // kernels, up to the last quantum, then the last quantum.
+  template<typename Byte>
+  static constexpr bool decode_scalar(const char* in, size_t inlen, size_t done, Byte* out, size_t* outlen)
+  {
+    const size_t body = body_size(inlen);
+    Byte* end = out + done / 4 * 3;
+
+    for(size_t i = done; i < body; i += 4, end += 3)
+      if (!decode_quantum(in + i, 4, end))
+        return false;
+
+    size_t last = inlen - body;
+    if (Padding::pad && last == 4 && in[body + 3] == '=')
+      last = in[body + 2] == '=' ? 2 : 3;
+
+    if (last > 0 && !decode_quantum(in + body, last, end))
+      return false;
+
+    *outlen = end - out + (last > 0 ? last - 1 : 0);
+    return true;
+  }
+
+  // Decodes the sz (2 to 4) characters of in to sz - 1 bytes of out.
+  template<typename Byte>
+  static constexpr bool decode_quantum(const char* in, size_t sz, Byte* out)
+  {
+    const int a = tables::decode[byte(in[0])];
+    const int b = tables::decode[byte(in[1])];
+    const int c = sz > 2 ? tables::decode[byte(in[2])] : 0;
+    const int d = sz > 3 ? tables::decode[byte(in[3])] : 0;
+    if ((a | b | c | d) < 0)
+      return false;
+
+    const unsigned v = a << 18 | b << 12 | c << 6 | d;
+    out[0] = static_cast<Byte>(v >> 16);
+    if (sz > 2)
+      out[1] = static_cast<Byte>(v >> 8);
+    if (sz > 3)
+      out[2] = static_cast<Byte>(v);
+    return true;
+  }
+
+  static size_t encode_kernel(const char* in, size_t inlen, char* out)
+  {
+#if BASE64_ALPHABET_X86_KERNELS
+    using kernels = base64_alphanumeric_kernels<Alphabet::symbol(62), Alphabet::symbol(63)>;
+    if (tables::alphanumeric()) {
+      switch (base64_get_backend()) {
+        case BASE64_BACKEND_AVX2: return kernels::encode_avx2(in, inlen, out);
+        case BASE64_BACKEND_SSSE3: return kernels::encode_ssse3(in, inlen, out);
+        default: break;
+      }
+    }
+#endif
+    (void) in; (void) inlen; (void) out;
+    return 0;
+  }
+
+  static size_t decode_kernel(const char* in, size_t inlen, char* out, size_t outlen)
+  {
+#if BASE64_ALPHABET_X86_KERNELS
+    using kernels = base64_alphanumeric_kernels<Alphabet::symbol(62), Alphabet::symbol(63)>;
+    if (tables::alphanumeric()) {
+      switch (base64_get_backend()) {
+        case BASE64_BACKEND_AVX2: return kernels::decode_avx2(in, inlen, out, outlen);
+        case BASE64_BACKEND_SSSE3: return kernels::decode_ssse3(in, inlen, out, outlen);
+        default: break;
+      }
+    }
+#endif
+    (void) in; (void) inlen; (void) out; (void) outlen;
+    return 0;
+  }
+};
+
+// Typed helpers, like encode_base64_rfc and decode_base64_rfc, for any
+// alphabet and padding.
+template<typename Alphabet, typename Padding = base64_padded, typename T>
+std::string encode_base64_with(const T* in, size_t sz)
+{
+  using codec = base64_codec<Alphabet, Padding>;
+
+  std::string out(codec::encoded_size(sz * sizeof(T)), '\0');
+  codec::encode(reinterpret_cast<const char*>(in), sz * sizeof(T), &out[0]);
+  return out;
+}
+
+template<typename Alphabet, typename Padding = base64_padded, typename T>
+std::string encode_base64_with(const std::vector<T>& in)
+{
+  return encode_base64_with<Alphabet, Padding>(in.data(), in.size());
+}
+
+template<typename T, typename Alphabet, typename Padding = base64_padded>
+std::vector<T> decode_base64_with(const char* in, size_t sz)
+{
+  using codec = base64_codec<Alphabet, Padding>;
+
+  size_t bytes = codec::decoded_size(in, sz);
+  if (bytes % sizeof(T) != 0)
+    throw std::runtime_error("Invalid amount of data to build an array of T");
+
+  std::vector<T> out(bytes / sizeof(T));
+  if (!codec::decode(in, sz, reinterpret_cast<char*>(out.data()), &bytes))
+    throw std::runtime_error("Input was not base64 encoded");
+
+  return out;
+}
+
+template<typename T, typename Alphabet, typename Padding = base64_padded>
+std::vector<T> decode_base64_with(const std::string& in)
+{
+  return decode_base64_with<T, Alphabet, Padding>(in.data(), in.size());
+}
+
+// Compile-time encoding of the N bytes of in, e.g. an asset embedded in the
+// program, with the tables of base64_codec. The characters are followed by
+// a terminating zero. Like base64_decode_array, this needs the C++17 the
+// build asks for: std::array::data() is not constexpr before it.
+template<typename Alphabet = base64_standard_alphabet, typename Padding = base64_padded, size_t N>
+constexpr std::array<char, base64_codec<Alphabet, Padding>::encoded_size(N) + 1>
+base64_encode_array(const std::array<uint8_t, N>& in)
+{
+  std::array<char, base64_codec<Alphabet, Padding>::encoded_size(N) + 1> out{};
+  base64_codec<Alphabet, Padding>::encode_constexpr(in.data(), N, out.data());
+  return out;
+}
+
+// Number of bytes encoded by a string literal, to size the array decoded by
+// base64_decode_array:
+//
+//   constexpr char key_base64[] = "...";
+//   constexpr auto key = base64_decode_array<base64_decoded_size(key_base64)>(key_base64);
+template<typename Alphabet = base64_standard_alphabet, typename Padding = base64_padded, size_t M>
+constexpr size_t base64_decoded_size(const char (&in)[M])
+{
+  return base64_codec<Alphabet, Padding>::decoded_size(in, M - 1);
+}
+
+// Compile-time decoding of the sz characters of in, which must encode
+// exactly N bytes. Invalid input throws, which makes the evaluation fail
+// at compile time in a constant expression.
+template<size_t N, typename Alphabet = base64_standard_alphabet, typename Padding = base64_padded>
+constexpr std::array<uint8_t, N> base64_decode_array(const char* in, size_t sz)
+{
+  using codec = base64_codec<Alphabet, Padding>;
+
+  if (codec::decoded_size(in, sz) != N)
+    throw std::runtime_error("Invalid amount of data to build an array of T");
+
+  std::array<uint8_t, N> out{};
+  size_t decoded = N;
+  if (!codec::decode_constexpr(in, sz, out.data(), &decoded))
+    throw std::runtime_error("Input was not base64 encoded");
+  return out;
+}
+
+template<size_t N, typename Alphabet = base64_standard_alphabet, typename Padding = base64_padded, size_t M>
+constexpr std::array<uint8_t, N> base64_decode_array(const char (&in)[M])
+{
+  return base64_decode_array<N, Alphabet, Padding>(in, M - 1);
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "base64_archive.hxx"
+
+#include <boost/archive/archive_exception.hpp>
+#include <boost/archive/impl/archive_serializer_map.ipp>
+#include <boost/archive/impl/basic_text_oarchive.ipp>
+#include <boost/archive/impl/basic_text_iarchive.ipp>
+#include <boost/archive/impl/text_oarchive_impl.ipp>
+#include <boost/archive/impl/text_iarchive_impl.ipp>
+#include <boost/archive/impl/basic_xml_oarchive.ipp>
+#include <boost/archive/impl/basic_xml_iarchive.ipp>
+#include <boost/archive/impl/xml_oarchive_impl.ipp>
+#include <boost/archive/impl/xml_iarchive_impl.ipp>
+
+#include <memory>
+
+#define RESTRICT
+#include "base64.h"
+
+void write_base64_array(std::ostream& os, const void* data, size_t size)
+{
+  const size_t length = BASE64_LENGTH(size);
+  std::unique_ptr<char[]> encoded(new char[length]);
+  base64_encode(static_cast<const char*>(data), size, encoded.get(), length);
+  os.write(encoded.get(), length);
+}
+
+void read_base64_array(std::istream& is, void* data, size_t size)
+{
+  const size_t length = BASE64_LENGTH(size);
+  std::unique_ptr<char[]> encoded(new char[length]);
+  is >> std::ws;
+  is.read(encoded.get(), length);
+
+  size_t decoded = size;
+  if (!is || !base64_decode(encoded.get(), length, static_cast<char*>(data), &decoded) || decoded != size)
+    boost::serialization::throw_exception(
+      boost::archive::archive_exception(boost::archive::archive_exception::input_stream_error));
+}
+
+base64_text_oarchive::base64_text_oarchive(std::ostream& os, unsigned int flags)
+  : boost::archive::text_oarchive_impl<base64_text_oarchive>(os, flags)
+{
+  if ((flags & boost::archive::no_header) == 0)
+    init();
+}
+
+base64_text_iarchive::base64_text_iarchive(std::istream& is, unsigned int flags)
+  : boost::archive::text_iarchive_impl<base64_text_iarchive>(is, flags)
+{
+  if ((flags & boost::archive::no_header) == 0)
+    init();
+}
+
+base64_xml_oarchive::base64_xml_oarchive(std::ostream& os, unsigned int flags)
+  : boost::archive::xml_oarchive_impl<base64_xml_oarchive>(os, flags)
+{
+  if ((flags & boost::archive::no_header) == 0)
+    init();
+}
+
+base64_xml_iarchive::base64_xml_iarchive(std::istream& is, unsigned int flags)
+  : boost::archive::xml_iarchive_impl<base64_xml_iarchive>(is, flags)
+{
+  if ((flags & boost::archive::no_header) == 0)
+    init();
+}
+
+// The archive templates are only instantiated by the Boost library for its
+// own archive classes.
+template class boost::archive::detail::archive_serializer_map<base64_text_oarchive>;
+template class boost::archive::basic_text_oarchive<base64_text_oarchive>;
+template class boost::archive::text_oarchive_impl<base64_text_oarchive>;
+
+template class boost::archive::detail::archive_serializer_map<base64_text_iarchive>;
+template class boost::archive::basic_text_iarchive<base64_text_iarchive>;
+template class boost::archive::text_iarchive_impl<base64_text_iarchive>;
+
+template class boost::archive::detail::archive_serializer_map<base64_xml_oarchive>;
+template class boost::archive::basic_xml_oarchive<base64_xml_oarchive>;
+template class boost::archive::xml_oarchive_impl<base64_xml_oarchive>;
+
+template class boost::archive::detail::archive_serializer_map<base64_xml_iarchive>;
+template class boost::archive::basic_xml_iarchive<base64_xml_iarchive>;
+template class boost::archive::xml_iarchive_impl<base64_xml_iarchive>;
@@ -0,0 +1,109 @@
+#ifndef BASE64_ARCHIVE
+#define BASE64_ARCHIVE
+
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/xml_oarchive.hpp>
+#include <boost/archive/xml_iarchive.hpp>
+#include <boost/mpl/bool.hpp>
+#include <boost/serialization/array_optimization.hpp>
+#include <boost/serialization/array_wrapper.hpp>
+
+#include <istream>
+#include <ostream>
+#include <type_traits>
+
+// Text and XML archives that store contiguous arrays of arithmetic types
+// (std::vector, std::array, C arrays...) as a single base64 token of their
+// memory, instead of one token per element. Everything else, including the
+// element count, is written as by text_oarchive and xml_oarchive. As with
+// binary_oarchive, the elements are stored in the byte order of the machine.
+
+// Writes the size bytes of data to os as one base64 token, without padding
+// whitespace.
+void write_base64_array(std::ostream& os, const void* data, size_t size);
+
+// Skips whitespace then reads the token written by write_base64_array for
+// size bytes. Throws an archive_exception if it is missing or invalid.
+void read_base64_array(std::istream& is, void* data, size_t size);
+
+struct base64_array_optimization
+{
+  template<class T>
+  struct apply : boost::mpl::bool_<std::is_arithmetic<T>::value> {};
+};
+
+class base64_text_oarchive : public boost::archive::text_oarchive_impl<base64_text_oarchive>
+{
+public:
+  typedef base64_array_optimization use_array_optimization;
+
+  base64_text_oarchive(std::ostream& os, unsigned int flags = 0);
+
+  template<class T>
+  void save_array(const boost::serialization::array_wrapper<T>& a, unsigned int)
+  {
+    this->newtoken();
+    write_base64_array(this->os, a.address(), a.count() * sizeof(T));
+  }
+};
+
+class base64_text_iarchive : public boost::archive::text_iarchive_impl<base64_text_iarchive>
+{
+public:
+  typedef base64_array_optimization use_array_optimization;
+
+  base64_text_iarchive(std::istream& is, unsigned int flags = 0);
+
+  template<class T>
+  void load_array(boost::serialization::array_wrapper<T>& a, unsigned int)
+  {
+    read_base64_array(this->is, a.address(), a.count() * sizeof(T));
+  }
+};
+
+// The arrays are written as the text of a <base64> element.
+class base64_xml_oarchive : public boost::archive::xml_oarchive_impl<base64_xml_oarchive>
+{
+public:
+  typedef base64_array_optimization use_array_optimization;
+
+  base64_xml_oarchive(std::ostream& os, unsigned int flags = 0);
+
+  template<class T>
+  void save_array(const boost::serialization::array_wrapper<T>& a, unsigned int)
+  {
+    this->save_start("base64");
+    this->end_preamble();
+    write_base64_array(this->os, a.address(), a.count() * sizeof(T));
+    this->save_end("base64");
+  }
+};
+
+class base64_xml_iarchive : public boost::archive::xml_iarchive_impl<base64_xml_iarchive>
+{
+public:
+  typedef base64_array_optimization use_array_optimization;
+
+  base64_xml_iarchive(std::istream& is, unsigned int flags = 0);
+
+  template<class T>
+  void load_array(boost::serialization::array_wrapper<T>& a, unsigned int)
+  {
+    this->load_start("base64");
+    read_base64_array(this->is, a.address(), a.count() * sizeof(T));
+    this->load_end("base64");
+  }
+};
+
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(base64_text_oarchive)
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(base64_text_iarchive)
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(base64_xml_oarchive)
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(base64_xml_iarchive)
+
+BOOST_SERIALIZATION_USE_ARRAY_OPTIMIZATION(base64_text_oarchive)
+BOOST_SERIALIZATION_USE_ARRAY_OPTIMIZATION(base64_text_iarchive)
+BOOST_SERIALIZATION_USE_ARRAY_OPTIMIZATION(base64_xml_oarchive)
+BOOST_SERIALIZATION_USE_ARRAY_OPTIMIZATION(base64_xml_iarchive)
+
+#endif
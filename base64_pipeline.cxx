@@ -0,0 +1,359 @@
+#include "base64_pipeline.hxx"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#define RESTRICT
+#include "base64.h"
+
+namespace {
+
+// Buffer of the ring, handed from the reader to a worker, then to the
+// writer, which gives it back to the reader.
+struct chunk
+{
+  enum { empty, filled, processing, processed } state = empty;
+  std::vector<char> in;
+  std::vector<char> out;
+  size_t insize = 0;
+  size_t outsize = 0;
+  bool last = false;
+  // Whether the decoded chunk ends with padding.
+  bool padded = false;
+  // Whether the chunk belongs to line-wrapped input: it then ends with
+  // whole lines, and is decoded skipping the whitespace.
+  bool wrapped = false;
+};
+
+// Line-wrapped input, as written by base64(1) or MIME encoders, is told
+// apart by a line break in the chunks starting within its first
+// line_window characters.
+constexpr size_t line_window = 4096;
+
+// Chunk i of the stream goes through ring[i % ring.size()]. The reader and
+// the writer take the chunks in order, the workers in the order they claim
+// them, so that the state of a buffer is enough to tell whether it holds
+// the chunk a stage waits for.
+class pipeline
+{
+public:
+  pipeline(const base64_pipeline_reader& read, const base64_pipeline_writer& write,
+           const base64_pipeline_options& options);
+
+  base64_pipeline_result run();
+
+private:
+  void read_chunks();
+  void process_chunks();
+  void fill(chunk& c, uint64_t i);
+  void process(chunk& c) const;
+  void flush(const chunk& c);
+  void fail(std::exception_ptr e);
+
+  const base64_pipeline_reader& read;
+  const base64_pipeline_writer& write;
+  bool decode;
+  size_t workers;
+  size_t chunk_in;
+  // Characters read past a chunk when decoding, to know whether it is the
+  // last one before handing it over: more than the final line break, which
+  // is then stripped.
+  size_t lookahead;
+  std::vector<chunk> ring;
+
+  // State of the reader: the characters read past the last chunk, the
+  // number read in all, and whether the input was found to be line-wrapped.
+  std::vector<char> carry;
+  uint64_t total_read = 0;
+  bool wrapped = false;
+  // State of the writer: whether a chunk ended with padding.
+  uint64_t written = 0;
+  bool padded = false;
+
+  // Each stage waits on its own condition: a buffer given back to the
+  // reader, a chunk to process, or the chunk to write next.
+  std::mutex mutex;
+  std::condition_variable freed;
+  std::condition_variable filled;
+  std::condition_variable processed;
+  uint64_t next_work = 0;
+  // Number of chunks, once the reader has seen the end of the input.
+  uint64_t end = UINT64_MAX;
+  bool stopping = false;
+  std::exception_ptr error;
+};
+
+pipeline::pipeline(const base64_pipeline_reader& read, const base64_pipeline_writer& write,
+                   const base64_pipeline_options& options)
+  : read(read), write(write), decode(options.decode), workers(options.workers)
+{
+  size_t plain = (std::max<size_t>(1, options.chunk) + 2) / 3 * 3;
+  size_t chunk_out = decode ? plain : BASE64_LENGTH(plain);
+  chunk_in = decode ? plain / 3 * 4 : plain;
+  lookahead = decode ? 3 : 0;
+
+  if (workers == 0)
+    ring.resize(1);
+  else
+    ring.resize(options.buffers ? std::max<size_t>(2, options.buffers) : 2 * workers + 2);
+  for(chunk& c : ring) {
+    c.in.resize(chunk_in + lookahead);
+    c.out.resize(chunk_out);
+  }
+}
+
+base64_pipeline_result pipeline::run()
+{
+  // Without workers, each chunk is read, processed and written in turn.
+  if (workers == 0) {
+    chunk& c = ring[0];
+    for(uint64_t i = 0;; ++i) {
+      fill(c, i);
+      process(c);
+      flush(c);
+      if (c.last)
+        return {total_read, written};
+    }
+  }
+
+  std::vector<std::thread> threads;
+
+  try {
+    threads.emplace_back(&pipeline::read_chunks, this);
+    for(size_t i = 0; i < workers; ++i)
+      threads.emplace_back(&pipeline::process_chunks, this);
+
+    for(uint64_t i = 0;; ++i) {
+      chunk& c = ring[i % ring.size()];
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        processed.wait(lock, [&]() { return stopping || i == end || c.state == chunk::processed; });
+        if (stopping || i == end)
+          break;
+      }
+
+      flush(c);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        c.state = chunk::empty;
+      }
+      freed.notify_one();
+    }
+  } catch (...) {
+    fail(std::current_exception());
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  freed.notify_all();
+  filled.notify_all();
+  for(std::thread& thread : threads)
+    thread.join();
+
+  if (error)
+    std::rethrow_exception(error);
+  return {total_read, written};
+}
+
+void pipeline::read_chunks()
+{
+  try {
+    for(uint64_t i = 0;; ++i) {
+      chunk& c = ring[i % ring.size()];
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        freed.wait(lock, [&]() { return stopping || c.state == chunk::empty; });
+        if (stopping)
+          return;
+      }
+
+      fill(c, i);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        c.state = chunk::filled;
+        if (c.last)
+          end = i + 1;
+      }
+      // The last chunk also tells the idle workers and the writer to stop.
+      if (c.last) {
+        filled.notify_all();
+        processed.notify_one();
+      } else {
+        filled.notify_one();
+      }
+
+      if (c.last)
+        return;
+    }
+  } catch (...) {
+    fail(std::current_exception());
+  }
+}
+
+void pipeline::process_chunks()
+{
+  for(;;) {
+    chunk* c;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      filled.wait(lock, [&]() {
+        return stopping || next_work == end || ring[next_work % ring.size()].state == chunk::filled;
+      });
+      if (stopping || next_work == end)
+        return;
+
+      c = &ring[next_work++ % ring.size()];
+      c->state = chunk::processing;
+    }
+
+    try {
+      process(*c);
+    } catch (...) {
+      fail(std::current_exception());
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      c->state = chunk::processed;
+    }
+    processed.notify_one();
+  }
+}
+
+// Reads chunk i to c, after the characters carried over from chunk i - 1.
+void pipeline::fill(chunk& c, uint64_t i)
+{
+  std::copy(carry.begin(), carry.end(), c.in.data());
+  size_t size = carry.size();
+  while (size < c.in.size()) {
+    size_t n = read(c.in.data() + size, c.in.size() - size);
+    if (n == 0)
+      break;
+    size += n;
+  }
+  total_read += size - carry.size();
+
+  c.last = size < c.in.size();
+  c.insize = size;
+  // A final line break, as written by most encoders, is not data.
+  if (decode && c.last && c.insize > 0 && c.in[c.insize - 1] == '\n')
+    --c.insize;
+  if (decode && c.last && c.insize > 0 && c.in[c.insize - 1] == '\r')
+    --c.insize;
+
+  // Until then, the chunks are cut every chunk_in characters.
+  if (decode && !wrapped && i * chunk_in < line_window)
+    wrapped = std::memchr(c.in.data(), '\n', c.insize) != nullptr;
+  c.wrapped = wrapped;
+
+  if (!c.last) {
+    // Wrapped chunks end with whole lines, which hold whole quanta when
+    // wrapped at a multiple of 4 columns; the others end with whole
+    // quanta.
+    size_t line_end = size;
+    while (wrapped && line_end > 0 && c.in[line_end - 1] != '\n')
+      --line_end;
+    c.insize = wrapped && line_end > 0 ? line_end : chunk_in;
+    carry.assign(c.in.data() + c.insize, c.in.data() + size);
+  }
+}
+
+void pipeline::process(chunk& c) const
+{
+  if (!decode) {
+    c.outsize = BASE64_LENGTH(c.insize);
+    base64_encode(c.in.data(), c.insize, c.out.data(), c.outsize);
+    return;
+  }
+
+  if (!c.wrapped && c.insize % 4 != 0)
+    throw std::runtime_error("Input was not base64 encoded");
+
+  size_t end = c.insize;
+  while (c.wrapped && end > 0 && (c.in[end - 1] == '\n' || c.in[end - 1] == '\r'))
+    --end;
+  c.padded = end > 0 && c.in[end - 1] == '=';
+
+  c.outsize = c.out.size();
+  bool ok = c.wrapped ? base64_decode_wrapped(c.in.data(), c.insize, c.out.data(), &c.outsize)
+                      : base64_decode(c.in.data(), c.insize, c.out.data(), &c.outsize);
+  if (!ok)
+    throw std::runtime_error("Input was not base64 encoded");
+}
+
+// Writes the processed chunk c.
+void pipeline::flush(const chunk& c)
+{
+  // base64_decode accepts padding at the end of its input, which is only
+  // the end of the stream for the last chunk holding data.
+  if (padded && c.outsize > 0)
+    throw std::runtime_error("Input was not base64 encoded");
+  padded = padded || c.padded;
+
+  write(c.out.data(), c.outsize);
+  written += c.outsize;
+}
+
+// Records the first error and stops every stage.
+void pipeline::fail(std::exception_ptr e)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!error)
+      error = e;
+    stopping = true;
+  }
+  freed.notify_all();
+  filled.notify_all();
+  processed.notify_all();
+}
+
+}
+
+base64_pipeline_result base64_pipeline(const base64_pipeline_reader& read, const base64_pipeline_writer& write,
+                                       const base64_pipeline_options& options)
+{
+  return pipeline(read, write, options).run();
+}
+
+base64_pipeline_result base64_pipeline(int in, int out, const base64_pipeline_options& options)
+{
+  return base64_pipeline(
+    [in](char* buffer, size_t size) {
+      for(;;) {
+        ssize_t n = ::read(in, buffer, size);
+        if (n >= 0)
+          return static_cast<size_t>(n);
+        if (errno != EINTR)
+          throw std::system_error(errno, std::generic_category(), "read");
+      }
+    },
+    [out](const char* data, size_t size) {
+      while (size > 0) {
+        ssize_t n = ::write(out, data, size);
+        if (n < 0) {
+          if (errno == EINTR)
+            continue;
+          throw std::system_error(errno, std::generic_category(), "write");
+        }
+        data += n;
+        size -= n;
+      }
+    },
+    options);
+}
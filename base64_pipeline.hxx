@@ -0,0 +1,63 @@
+#ifndef BASE64_PIPELINE
+#define BASE64_PIPELINE
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Encoding or decoding of a stream that can only be read and written in
+// order, such as a pipe or a socket, by three stages running at once: a
+// reader thread filling chunks of input, worker threads encoding or decoding
+// them, and the calling thread writing their results in order. The stages
+// pass each other the buffers of a fixed ring, so that the memory used is
+// bounded whatever the length of the stream. Without workers, the calling
+// thread reads, processes and writes each chunk in turn instead.
+//
+// The chunks hold whole 3-byte groups (encoding) or 4-character quanta
+// (decoding), so that each one is processed independently with
+// base64_encode or base64_decode and the output is the one of these
+// functions on the whole stream. When decoding, a line break at the very
+// end of the input, as written by most encoders, is not data. Line-wrapped
+// input, such as the output of base64(1) or of MIME encoders, is cut in
+// chunks of whole lines and decoded with base64_decode_wrapped: its lines
+// have to hold whole quanta, i.e. be wrapped at a multiple of 4 columns.
+
+struct base64_pipeline_options
+{
+  bool decode = false;
+  // Encoding or decoding threads, besides the reader and the writer; 0 for
+  // none, the calling thread doing all the work.
+  size_t workers = 1;
+  // Plain bytes per chunk, rounded up to whole groups.
+  size_t chunk = 1 << 20;
+  // Chunks in the ring, at least 2; 0 for two per worker plus two, so that
+  // the reader and the writer never wait for a worker to give a buffer back.
+  // Without workers, a single chunk is used.
+  size_t buffers = 0;
+};
+
+struct base64_pipeline_result
+{
+  uint64_t read;
+  uint64_t written;
+};
+
+// Fills up to size bytes of buffer, and returns their number: 0 only at the
+// end of the input.
+using base64_pipeline_reader = std::function<size_t(char* buffer, size_t size)>;
+// Writes the size bytes of data.
+using base64_pipeline_writer = std::function<void(const char* data, size_t size)>;
+
+// Encodes or decodes everything read to write. Throws a runtime_error if
+// the input is not base64 encoded, or the first exception thrown by read or
+// write, once every thread has stopped. The reader thread is only stopped
+// between two calls to read.
+base64_pipeline_result base64_pipeline(const base64_pipeline_reader& read, const base64_pipeline_writer& write,
+                                       const base64_pipeline_options& options = base64_pipeline_options());
+
+// Same as above, from the file descriptor in to the file descriptor out,
+// with read and write, retried on EINTR. Throws a system_error if they fail.
+base64_pipeline_result base64_pipeline(int in, int out,
+                                       const base64_pipeline_options& options = base64_pipeline_options());
+
+#endif
@@ -0,0 +1,1397 @@
+/* base64_simd.c -- Vectorized base64 kernels for x86 processors.
+
+   The encoder follows the approach described by Wojciech Muła and
+   Daniel Lemire ("Faster Base64 Encoding and Decoding using AVX2
+   Instructions"): bytes are gathered with a shuffle, split into 6-bit
+   indices with two multiplications, then translated to ASCII through
+   a small offset table instead of a 64-entry lookup.  The decoder
+   classifies every character by its two nibbles, which both
+   validates the input and selects the offset that turns it back into
+   a 6-bit value; the values are then packed with two multiply-add
+   instructions.
+
+   Every function carries its own target attribute, so this file does
+   not need to be compiled with -mavx2; base64.c only calls a kernel
+   after checking that the processor supports it.  */
+
+#include "base64_simd.h"
+
+#if BASE64_HAVE_X86_KERNELS
+
+# include <immintrin.h>
+# include <stdbool.h>
+# include <string.h>
+
+/* Byte of the 12-byte block gathered in each byte of the vector
+   split by enc_split_*: every 3 bytes are spread over 4, swapping the
+   two bytes of every 16-bit lane.  */
+static const signed char enc_shuffle[16] = {
+  1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+};
+
+/* Turn the bytes gathered by enc_shuffle into 16 bytes holding one
+   6-bit index each.  */
+__attribute__ ((target ("ssse3")))
+static inline __m128i
+enc_split_128 (__m128i in)
+{
+  const __m128i t0 = _mm_and_si128 (in, _mm_set1_epi32 (0x0fc0fc00));
+  const __m128i t1 = _mm_mulhi_epu16 (t0, _mm_set1_epi32 (0x04000040));
+  const __m128i t2 = _mm_and_si128 (in, _mm_set1_epi32 (0x003f03f0));
+  const __m128i t3 = _mm_mullo_epi16 (t2, _mm_set1_epi32 (0x01000010));
+
+  return _mm_or_si128 (t1, t3);
+}
+
+/* Spread the 12 low bytes of IN over 16 bytes holding one 6-bit
+   index each.  */
+__attribute__ ((target ("ssse3")))
+static inline __m128i
+enc_reshuffle_128 (__m128i in)
+{
+  in = _mm_shuffle_epi8 (in, _mm_loadu_si128 ((const __m128i *) enc_shuffle));
+  return enc_split_128 (in);
+}
+
+/* Map 6-bit indices to the characters of the Base64 alphabet.  The
+   indices are first reduced to one of 14 classes (A-Z, a-z, each
+   digit, '+' and '/'), whose offset to the ASCII value is then looked
+   up with a single shuffle.  */
+__attribute__ ((target ("ssse3")))
+static inline __m128i
+enc_translate_128 (__m128i in)
+{
+  const __m128i lut = _mm_setr_epi8 ('A', 'a' - 26,
+				     '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+				     '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+				     '0' - 52, '0' - 52, '+' - 62, '/' - 63,
+				     0, 0);
+
+  __m128i classes = _mm_subs_epu8 (in, _mm_set1_epi8 (51));
+  classes = _mm_sub_epi8 (classes,
+			  _mm_cmpgt_epi8 (in, _mm_set1_epi8 (25)));
+
+  return _mm_add_epi8 (in, _mm_shuffle_epi8 (lut, classes));
+}
+
+__attribute__ ((target ("ssse3")))
+size_t
+base64_encode_ssse3 (const char *in, size_t inlen, char *out)
+{
+  size_t done = 0;
+
+  /* Each iteration uses 12 bytes but loads 16.  */
+  while (inlen - done >= 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (in + done));
+      v = enc_translate_128 (enc_reshuffle_128 (v));
+      _mm_storeu_si128 ((__m128i *) out, v);
+
+      done += 12;
+      out += 16;
+    }
+
+  return done;
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+enc_split_256 (__m256i in)
+{
+  const __m256i t0 = _mm256_and_si256 (in, _mm256_set1_epi32 (0x0fc0fc00));
+  const __m256i t1 = _mm256_mulhi_epu16 (t0, _mm256_set1_epi32 (0x04000040));
+  const __m256i t2 = _mm256_and_si256 (in, _mm256_set1_epi32 (0x003f03f0));
+  const __m256i t3 = _mm256_mullo_epi16 (t2, _mm256_set1_epi32 (0x01000010));
+
+  return _mm256_or_si256 (t1, t3);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+enc_reshuffle_256 (__m256i in)
+{
+  const __m128i shuffle = _mm_loadu_si128 ((const __m128i *) enc_shuffle);
+
+  in = _mm256_shuffle_epi8 (in, _mm256_broadcastsi128_si256 (shuffle));
+  return enc_split_256 (in);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+enc_translate_256 (__m256i in)
+{
+  const __m256i lut = _mm256_setr_epi8 ('A', 'a' - 26,
+					'0' - 52, '0' - 52, '0' - 52, '0' - 52,
+					'0' - 52, '0' - 52, '0' - 52, '0' - 52,
+					'0' - 52, '0' - 52, '+' - 62, '/' - 63,
+					0, 0,
+					'A', 'a' - 26,
+					'0' - 52, '0' - 52, '0' - 52, '0' - 52,
+					'0' - 52, '0' - 52, '0' - 52, '0' - 52,
+					'0' - 52, '0' - 52, '+' - 62, '/' - 63,
+					0, 0);
+
+  __m256i classes = _mm256_subs_epu8 (in, _mm256_set1_epi8 (51));
+  classes = _mm256_sub_epi8 (classes,
+			     _mm256_cmpgt_epi8 (in, _mm256_set1_epi8 (25)));
+
+  return _mm256_add_epi8 (in, _mm256_shuffle_epi8 (lut, classes));
+}
+
+__attribute__ ((target ("avx2")))
+size_t
+base64_encode_avx2 (const char *in, size_t inlen, char *out)
+{
+  size_t done = 0;
+
+  /* Each iteration uses 24 bytes, split over two 128-bit lanes of 12
+     bytes each.  The second load reads up to IN + 28.  */
+  while (inlen - done >= 28)
+    {
+      const __m128i lo = _mm_loadu_si128 ((const __m128i *) (in + done));
+      const __m128i hi = _mm_loadu_si128 ((const __m128i *) (in + done + 12));
+      __m256i v = _mm256_inserti128_si256 (_mm256_castsi128_si256 (lo), hi, 1);
+      v = enc_translate_256 (enc_reshuffle_256 (v));
+      _mm256_storeu_si256 ((__m256i *) out, v);
+
+      done += 24;
+      out += 32;
+    }
+
+  return done + base64_encode_ssse3 (in + done, inlen - done, out);
+}
+
+/* The wrapped encoders encode each line with the blocks of the plain
+   ones, straight to its place in OUT.  Its last block may run past
+   the end of the line: the terminator, stored as 4 bytes, and the
+   next line then write over the extra characters, which is why a
+   line is only encoded when at least 32 more bytes of IN follow it.  */
+__attribute__ ((target ("ssse3")))
+size_t
+base64_encode_wrapped_ssse3 (const char *in, size_t inlen, char *out,
+			     size_t outlen, size_t line, const char *eol,
+			     size_t eollen)
+{
+  const size_t len = line / 4 * 3;
+  char term[4] = { 0 };
+  size_t done = 0;
+
+  memcpy (term, eol, eollen);
+  while (inlen - done >= len + 32 && outlen >= line + eollen + 32)
+    {
+      const char *p = in + done;
+      char *o = out;
+      size_t k;
+
+      for (k = 0; k < len; k += 12, p += 12, o += 16)
+	{
+	  __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+	  _mm_storeu_si128 ((__m128i *) o,
+			    enc_translate_128 (enc_reshuffle_128 (v)));
+	}
+
+      memcpy (out + line, term, sizeof term);
+      done += len;
+      out += line + eollen;
+      outlen -= line + eollen;
+    }
+
+  return done;
+}
+
+__attribute__ ((target ("avx2")))
+size_t
+base64_encode_wrapped_avx2 (const char *in, size_t inlen, char *out,
+			    size_t outlen, size_t line, const char *eol,
+			    size_t eollen)
+{
+  const size_t len = line / 4 * 3;
+  char term[4] = { 0 };
+  size_t done = 0;
+
+  memcpy (term, eol, eollen);
+  while (inlen - done >= len + 32 && outlen >= line + eollen + 32)
+    {
+      const char *p = in + done;
+      char *o = out;
+      size_t k;
+
+      for (k = 0; k < len; k += 24, p += 24, o += 32)
+	{
+	  const __m128i lo = _mm_loadu_si128 ((const __m128i *) p);
+	  const __m128i hi = _mm_loadu_si128 ((const __m128i *) (p + 12));
+	  __m256i v = _mm256_inserti128_si256 (_mm256_castsi128_si256 (lo),
+					       hi, 1);
+	  _mm256_storeu_si256 ((__m256i *) o,
+			       enc_translate_256 (enc_reshuffle_256 (v)));
+	}
+
+      memcpy (out + line, term, sizeof term);
+      done += len;
+      out += line + eollen;
+      outlen -= line + eollen;
+    }
+
+  return done;
+}
+
+/* Classification tables of the decoder.  A character is valid if
+   and only if the entries selected by its low and high nibbles have
+   no bit in common.  */
+# define DEC_LUT_LO \
+  0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, \
+  0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a
+# define DEC_LUT_HI \
+  0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, \
+  0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+/* Offset from a character to its 6-bit value, indexed by its high
+   nibble ('/' being moved from 2 to 1).  */
+# define DEC_LUT_ROLL \
+  0, 16, 19, 4, -65, -65, -71, -71, \
+  0, 0, 0, 0, 0, 0, 0, 0
+
+/* Validate the 16 characters of *STR and replace them with their 24
+   bits, held in the 3 low bytes of each 32-bit lane in big-endian
+   order.  Return false, leaving *STR alone, if one of them is not
+   part of the alphabet.  */
+__attribute__ ((target ("ssse3")))
+static inline bool
+dec_pack_128 (__m128i *str)
+{
+  const __m128i mask_2f = _mm_set1_epi8 (0x2f);
+  const __m128i hi_nibbles = _mm_and_si128 (_mm_srli_epi32 (*str, 4),
+					    mask_2f);
+  const __m128i lo_nibbles = _mm_and_si128 (*str, mask_2f);
+  const __m128i hi = _mm_shuffle_epi8 (_mm_setr_epi8 (DEC_LUT_HI),
+				       hi_nibbles);
+  const __m128i lo = _mm_shuffle_epi8 (_mm_setr_epi8 (DEC_LUT_LO),
+				       lo_nibbles);
+
+  if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_and_si128 (lo, hi),
+					 _mm_setzero_si128 ()))
+      != 0xffff)
+    return false;
+
+  const __m128i eq_2f = _mm_cmpeq_epi8 (*str, mask_2f);
+  const __m128i roll = _mm_shuffle_epi8 (_mm_setr_epi8 (DEC_LUT_ROLL),
+					 _mm_add_epi8 (eq_2f, hi_nibbles));
+  __m128i v = _mm_add_epi8 (*str, roll);
+
+  /* Merge the four 6-bit values of each 32-bit lane into 24 bits.  */
+  v = _mm_maddubs_epi16 (v, _mm_set1_epi32 (0x01400140));
+  *str = _mm_madd_epi16 (v, _mm_set1_epi32 (0x00011000));
+  return true;
+}
+
+__attribute__ ((target ("avx2")))
+static inline bool
+dec_pack_256 (__m256i *str)
+{
+  const __m256i mask_2f = _mm256_set1_epi8 (0x2f);
+  const __m256i hi_nibbles = _mm256_and_si256 (_mm256_srli_epi32 (*str, 4),
+					       mask_2f);
+  const __m256i lo_nibbles = _mm256_and_si256 (*str, mask_2f);
+  const __m256i hi = _mm256_shuffle_epi8 (_mm256_setr_epi8 (DEC_LUT_HI,
+							    DEC_LUT_HI),
+					  hi_nibbles);
+  const __m256i lo = _mm256_shuffle_epi8 (_mm256_setr_epi8 (DEC_LUT_LO,
+							    DEC_LUT_LO),
+					  lo_nibbles);
+
+  if (!_mm256_testz_si256 (lo, hi))
+    return false;
+
+  const __m256i eq_2f = _mm256_cmpeq_epi8 (*str, mask_2f);
+  const __m256i roll = _mm256_shuffle_epi8 (_mm256_setr_epi8 (DEC_LUT_ROLL,
+							      DEC_LUT_ROLL),
+					    _mm256_add_epi8 (eq_2f,
+							     hi_nibbles));
+  __m256i v = _mm256_add_epi8 (*str, roll);
+
+  v = _mm256_maddubs_epi16 (v, _mm256_set1_epi32 (0x01400140));
+  *str = _mm256_madd_epi16 (v, _mm256_set1_epi32 (0x00011000));
+  return true;
+}
+
+/* Same as dec_pack_256, accumulating the classification of the
+   characters in *ERRORS instead of checking it: *STR is only valid if
+   *ERRORS is zero once all the blocks are done.  */
+__attribute__ ((target ("avx2")))
+static inline void
+dec_pack_unchecked_256 (__m256i *str, __m256i *errors)
+{
+  const __m256i mask_2f = _mm256_set1_epi8 (0x2f);
+  const __m256i hi_nibbles = _mm256_and_si256 (_mm256_srli_epi32 (*str, 4),
+					       mask_2f);
+  const __m256i lo_nibbles = _mm256_and_si256 (*str, mask_2f);
+  const __m256i hi = _mm256_shuffle_epi8 (_mm256_setr_epi8 (DEC_LUT_HI,
+							    DEC_LUT_HI),
+					  hi_nibbles);
+  const __m256i lo = _mm256_shuffle_epi8 (_mm256_setr_epi8 (DEC_LUT_LO,
+							    DEC_LUT_LO),
+					  lo_nibbles);
+  const __m256i eq_2f = _mm256_cmpeq_epi8 (*str, mask_2f);
+  const __m256i roll = _mm256_shuffle_epi8 (_mm256_setr_epi8 (DEC_LUT_ROLL,
+							      DEC_LUT_ROLL),
+					    _mm256_add_epi8 (eq_2f,
+							     hi_nibbles));
+  __m256i v = _mm256_add_epi8 (*str, roll);
+
+  *errors = _mm256_or_si256 (*errors, _mm256_and_si256 (lo, hi));
+  v = _mm256_maddubs_epi16 (v, _mm256_set1_epi32 (0x01400140));
+  *str = _mm256_madd_epi16 (v, _mm256_set1_epi32 (0x00011000));
+}
+
+/* Position, in each lane packed by dec_pack_*, of the Nth decoded
+   byte: the 3 meaningful bytes of every 32-bit lane, in order.  */
+static const signed char dec_gather[16] = {
+  2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+};
+
+__attribute__ ((target ("ssse3")))
+size_t
+base64_decode_ssse3 (const char *in, size_t inlen, char *out, size_t outlen)
+{
+  const __m128i gather = _mm_loadu_si128 ((const __m128i *) dec_gather);
+  size_t done = 0;
+
+  /* Each iteration decodes 12 bytes but stores 16.  */
+  while (inlen - done >= 16 && outlen >= 16)
+    {
+      __m128i str = _mm_loadu_si128 ((const __m128i *) (in + done));
+
+      if (!dec_pack_128 (&str))
+	break;
+
+      _mm_storeu_si128 ((__m128i *) out, _mm_shuffle_epi8 (str, gather));
+
+      done += 16;
+      out += 12;
+      outlen -= 12;
+    }
+
+  return done;
+}
+
+__attribute__ ((target ("avx2")))
+size_t
+base64_decode_avx2 (const char *in, size_t inlen, char *out, size_t outlen)
+{
+  const __m256i gather =
+    _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *)
+						  dec_gather));
+  /* Move the 12 bytes of the upper lane next to those of the lower
+     one.  */
+  const __m256i merge = _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 3, 7);
+  size_t done = 0;
+
+  /* Each iteration decodes 24 bytes but stores 32.  */
+  while (inlen - done >= 32 && outlen >= 32)
+    {
+      __m256i str = _mm256_loadu_si256 ((const __m256i *) (in + done));
+
+      if (!dec_pack_256 (&str))
+	break;
+
+      str = _mm256_shuffle_epi8 (str, gather);
+      str = _mm256_permutevar8x32_epi32 (str, merge);
+      _mm256_storeu_si256 ((__m256i *) out, str);
+
+      done += 32;
+      out += 24;
+      outlen -= 24;
+    }
+
+  return done + base64_decode_ssse3 (in + done, inlen - done, out, outlen);
+}
+
+/* Classification of the 16 or 32 characters of STR as dec_pack_*
+   does it: a nonzero byte for each one that is not part of the
+   alphabet.  */
+__attribute__ ((target ("ssse3")))
+static inline __m128i
+dec_errors_128 (__m128i str)
+{
+  const __m128i mask_2f = _mm_set1_epi8 (0x2f);
+  const __m128i hi_nibbles = _mm_and_si128 (_mm_srli_epi32 (str, 4),
+					    mask_2f);
+  const __m128i lo_nibbles = _mm_and_si128 (str, mask_2f);
+
+  return _mm_and_si128 (_mm_shuffle_epi8 (_mm_setr_epi8 (DEC_LUT_LO),
+					  lo_nibbles),
+			_mm_shuffle_epi8 (_mm_setr_epi8 (DEC_LUT_HI),
+					  hi_nibbles));
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+dec_errors_256 (__m256i str)
+{
+  const __m256i mask_2f = _mm256_set1_epi8 (0x2f);
+  const __m256i hi_nibbles = _mm256_and_si256 (_mm256_srli_epi32 (str, 4),
+					       mask_2f);
+  const __m256i lo_nibbles = _mm256_and_si256 (str, mask_2f);
+
+  return _mm256_and_si256 (_mm256_shuffle_epi8 (_mm256_setr_epi8 (DEC_LUT_LO,
+								  DEC_LUT_LO),
+						lo_nibbles),
+			   _mm256_shuffle_epi8 (_mm256_setr_epi8 (DEC_LUT_HI,
+								  DEC_LUT_HI),
+						hi_nibbles));
+}
+
+__attribute__ ((target ("ssse3")))
+size_t
+base64_validate_ssse3 (const char *in, size_t inlen)
+{
+  const __m128i *p = (const __m128i *) in;
+  size_t done = 0;
+
+  /* The classification of 4 blocks is checked at once; a group
+     holding an invalid character is retried one block at a time.  */
+  while (inlen - done >= 64)
+    {
+      __m128i errors =
+	_mm_or_si128 (_mm_or_si128 (dec_errors_128 (_mm_loadu_si128 (p)),
+				    dec_errors_128 (_mm_loadu_si128 (p + 1))),
+		      _mm_or_si128 (dec_errors_128 (_mm_loadu_si128 (p + 2)),
+				    dec_errors_128 (_mm_loadu_si128 (p + 3))));
+
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (errors, _mm_setzero_si128 ()))
+	  != 0xffff)
+	break;
+
+      done += 64;
+      p += 4;
+    }
+
+  while (inlen - done >= 16)
+    {
+      __m128i errors = dec_errors_128 (_mm_loadu_si128 (p));
+
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (errors, _mm_setzero_si128 ()))
+	  != 0xffff)
+	break;
+
+      done += 16;
+      p++;
+    }
+
+  return done;
+}
+
+__attribute__ ((target ("avx2")))
+size_t
+base64_validate_avx2 (const char *in, size_t inlen)
+{
+  const __m256i *p = (const __m256i *) in;
+  size_t done = 0;
+
+  while (inlen - done >= 128)
+    {
+      __m256i errors =
+	_mm256_or_si256 (_mm256_or_si256
+			 (dec_errors_256 (_mm256_loadu_si256 (p)),
+			  dec_errors_256 (_mm256_loadu_si256 (p + 1))),
+			 _mm256_or_si256
+			 (dec_errors_256 (_mm256_loadu_si256 (p + 2)),
+			  dec_errors_256 (_mm256_loadu_si256 (p + 3))));
+
+      if (!_mm256_testz_si256 (errors, errors))
+	break;
+
+      done += 128;
+      p += 4;
+    }
+
+  while (inlen - done >= 32)
+    {
+      __m256i errors = dec_errors_256 (_mm256_loadu_si256 (p));
+
+      if (!_mm256_testz_si256 (errors, errors))
+	break;
+
+      done += 32;
+      p++;
+    }
+
+  return done + base64_validate_ssse3 (in + done, inlen - done);
+}
+
+/* The byte-swapping kernels work on groups of 24 bytes, which hold a
+   whole number of elements of any width up to 8, so that the swap can
+   be folded into the shuffles the encoder and the decoder already
+   do.  Position of the byte that ends up at position J of such a group
+   once each element of WIDTH bytes is reversed.  */
+static inline int
+swap_index (int j, int width)
+{
+  return j - j % width + width - 1 - j % width;
+}
+
+static inline bool
+swap_width_supported (size_t width)
+{
+  return width == 2 || width == 4 || width == 8;
+}
+
+/* Build the shuffles gathering the 12 bytes encoded by the lower
+   half of a group, loaded from its start, and those of the upper half,
+   loaded from its 8th byte so that the elements it shares with the
+   lower half are whole.  */
+static inline void
+enc_swap_shuffles (int width, signed char lo[16], signed char hi[16])
+{
+  int k;
+
+  for (k = 0; k < 16; k++)
+    {
+      lo[k] = swap_index (enc_shuffle[k], width);
+      hi[k] = swap_index (12 + enc_shuffle[k], width) - 8;
+    }
+}
+
+__attribute__ ((target ("ssse3")))
+size_t
+base64_encode_be_ssse3 (const char *in, size_t inlen, char *out,
+			size_t width)
+{
+  signed char lo[16], hi[16];
+  size_t done = 0;
+
+  if (!swap_width_supported (width))
+    return 0;
+
+  enc_swap_shuffles (width, lo, hi);
+  const __m128i shuffle_lo = _mm_loadu_si128 ((const __m128i *) lo);
+  const __m128i shuffle_hi = _mm_loadu_si128 ((const __m128i *) hi);
+
+  while (inlen - done >= 24)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (in + done));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (in + done + 8));
+      a = enc_translate_128 (enc_split_128 (_mm_shuffle_epi8 (a, shuffle_lo)));
+      b = enc_translate_128 (enc_split_128 (_mm_shuffle_epi8 (b, shuffle_hi)));
+      _mm_storeu_si128 ((__m128i *) out, a);
+      _mm_storeu_si128 ((__m128i *) (out + 16), b);
+
+      done += 24;
+      out += 32;
+    }
+
+  return done;
+}
+
+__attribute__ ((target ("avx2")))
+size_t
+base64_encode_be_avx2 (const char *in, size_t inlen, char *out,
+		       size_t width)
+{
+  signed char lo[16], hi[16];
+  size_t done = 0;
+
+  if (!swap_width_supported (width))
+    return 0;
+
+  enc_swap_shuffles (width, lo, hi);
+  const __m256i shuffle =
+    _mm256_inserti128_si256 (_mm256_castsi128_si256
+			     (_mm_loadu_si128 ((const __m128i *) lo)),
+			     _mm_loadu_si128 ((const __m128i *) hi), 1);
+
+  while (inlen - done >= 24)
+    {
+      const __m128i a = _mm_loadu_si128 ((const __m128i *) (in + done));
+      const __m128i b = _mm_loadu_si128 ((const __m128i *) (in + done + 8));
+      __m256i v = _mm256_inserti128_si256 (_mm256_castsi128_si256 (a), b, 1);
+      v = enc_translate_256 (enc_split_256 (_mm256_shuffle_epi8 (v, shuffle)));
+      _mm256_storeu_si256 ((__m256i *) out, v);
+
+      done += 24;
+      out += 32;
+    }
+
+  return done;
+}
+
+__attribute__ ((target ("ssse3")))
+size_t
+base64_decode_be_ssse3 (const char *in, size_t inlen, char *out,
+			size_t outlen, size_t width)
+{
+  const __m128i gather = _mm_loadu_si128 ((const __m128i *) dec_gather);
+  signed char swap[16];
+  size_t done = 0;
+  int k;
+
+  if (!swap_width_supported (width))
+    return 0;
+
+  for (k = 0; k < 16; k++)
+    swap[k] = swap_index (k, width);
+  const __m128i shuffle = _mm_loadu_si128 ((const __m128i *) swap);
+
+  /* Each iteration decodes a group of 24 bytes in two halves, which
+     are then put back together so that the elements they share can be
+     swapped: bytes 0 to 15 in one vector, 16 to 23 in another.  */
+  while (inlen - done >= 32 && outlen >= 24)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (in + done));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (in + done + 16));
+
+      if (!dec_pack_128 (&a) || !dec_pack_128 (&b))
+	break;
+
+      a = _mm_shuffle_epi8 (a, gather);
+      b = _mm_shuffle_epi8 (b, gather);
+      a = _mm_or_si128 (a, _mm_slli_si128 (b, 12));
+      b = _mm_srli_si128 (b, 4);
+      _mm_storeu_si128 ((__m128i *) out, _mm_shuffle_epi8 (a, shuffle));
+      _mm_storel_epi64 ((__m128i *) (out + 16), _mm_shuffle_epi8 (b, shuffle));
+
+      done += 32;
+      out += 24;
+      outlen -= 24;
+    }
+
+  return done;
+}
+
+__attribute__ ((target ("avx2")))
+size_t
+base64_decode_be_avx2 (const char *in, size_t inlen, char *out,
+		       size_t outlen, size_t width)
+{
+  signed char swap[16];
+  __m256i merge;
+  size_t done = 0;
+  int k;
+
+  if (!swap_width_supported (width))
+    return 0;
+
+  /* Elements of up to 4 bytes do not cross the lanes, and are swapped
+     by the gathering shuffle itself.  Those of 8 bytes have their two
+     32-bit halves swapped in the lanes, which are then exchanged when
+     the lanes are merged.  */
+  for (k = 0; k < 16; k++)
+    swap[k] = k < 12 ? dec_gather[swap_index (k, width < 8 ? width : 4)] : -1;
+  if (width < 8)
+    merge = _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 3, 7);
+  else
+    merge = _mm256_setr_epi32 (1, 0, 4, 2, 6, 5, 3, 7);
+  const __m256i shuffle =
+    _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *) swap));
+
+  /* Each iteration decodes 24 bytes but stores 32.  */
+  while (inlen - done >= 32 && outlen >= 32)
+    {
+      __m256i str = _mm256_loadu_si256 ((const __m256i *) (in + done));
+
+      if (!dec_pack_256 (&str))
+	break;
+
+      str = _mm256_shuffle_epi8 (str, shuffle);
+      str = _mm256_permutevar8x32_epi32 (str, merge);
+      _mm256_storeu_si256 ((__m256i *) out, str);
+
+      done += 32;
+      out += 24;
+      outlen -= 24;
+    }
+
+  return done + base64_decode_be_ssse3 (in + done, inlen - done, out, outlen,
+					width);
+}
+
+/* Mask of the whitespace characters of IN: space, and '\t' to '\r'.  */
+__attribute__ ((target ("ssse3")))
+static inline __m128i
+ws_classify_128 (__m128i in)
+{
+  const __m128i controls = _mm_sub_epi8 (in, _mm_set1_epi8 ('\t'));
+
+  return _mm_or_si128 (_mm_cmpeq_epi8 (_mm_min_epu8 (controls,
+						      _mm_set1_epi8 (4)),
+				       controls),
+		       _mm_cmpeq_epi8 (in, _mm_set1_epi8 (' ')));
+}
+
+/* Number of characters of a block of WIDTH characters, whose
+   whitespace is set in MASK, decoded and skipped by the wrapped
+   decoders: the quanta before the first whitespace, then the
+   whitespace that follows them.  Return false if the whitespace does
+   not fall between two quanta.  */
+static inline bool
+ws_split (unsigned int mask, unsigned int width, unsigned int *len,
+	  unsigned int *skip)
+{
+  unsigned int rest;
+
+  *len = mask ? (unsigned int) __builtin_ctz (mask) : width;
+  if (*len % 4)
+    return false;
+
+  rest = *len < width ? ~(mask >> *len) & ((2u << (width - *len - 1)) - 1) : 0;
+  *skip = rest ? (unsigned int) __builtin_ctz (rest) : width - *len;
+  return true;
+}
+
+/* Layout of the lines seen by a wrapped decoder.  Finding where a
+   line ends takes the classification of its last block, which the
+   load of the next block would have to wait for: once two lines in a
+   row have the same length and terminator, the next ones are assumed
+   to have them too, which is checked as they are decoded.  */
+struct ws_lines
+{
+  size_t start;
+  size_t length;
+  size_t eol;
+};
+
+# define WS_LINES_UNKNOWN ((size_t) -1)
+
+/* Record that the current line ends at END, followed by EOL
+   characters of whitespace.  Return its length if the previous line
+   had the same layout, it is made of whole quanta and its terminator
+   is at most 4 characters long, 0 otherwise.  */
+static inline size_t
+ws_learn (struct ws_lines *lines, size_t end, size_t eol)
+{
+  size_t length = lines->start == WS_LINES_UNKNOWN ? 0 : end - lines->start;
+  bool same = length == lines->length && eol == lines->eol;
+
+  lines->start = end + eol;
+  lines->length = length;
+  lines->eol = eol;
+  return same && length % 4 == 0 && eol <= 4 ? length : 0;
+}
+
+/* Decode the lines of LENGTH characters at the start of IN, each
+   followed by the same EOL (at most 4) characters of whitespace as the
+   line before IN, as long as they have this layout and fit in INLEN
+   and OUTLEN.  Return the number of characters consumed, and add the
+   number of bytes written to *WRITTEN.  */
+__attribute__ ((target ("ssse3"), noinline))
+static size_t
+decode_lines_ssse3 (const char *in, size_t inlen, char *out, size_t outlen,
+		    size_t length, size_t eol, size_t *written)
+{
+  const __m128i gather = _mm_loadu_si128 ((const __m128i *) dec_gather);
+  const unsigned int mask = eol < 4 ? (1u << 8 * eol) - 1 : ~0u;
+  unsigned int term, next;
+  size_t done = 0, w = 0;
+
+  if (length < 16 || inlen < 4)
+    return 0;
+
+  memcpy (&term, in - eol, sizeof term);
+  while (inlen - done >= length + eol + 16
+	 && outlen - w >= length / 4 * 3 + 16)
+    {
+      const char *p = in + done;
+      char *o = out + w;
+      __m128i str;
+      bool ok = true;
+      size_t k;
+
+      for (k = 0; ok && k + 16 <= length; k += 16, p += 16, o += 12)
+	{
+	  str = _mm_loadu_si128 ((const __m128i *) p);
+	  ok = dec_pack_128 (&str);
+	  _mm_storeu_si128 ((__m128i *) o, _mm_shuffle_epi8 (str, gather));
+	}
+
+      /* The last block ends with the line, overlapping the one before
+	 it if the line is not made of whole blocks: both decode the
+	 same bytes.  */
+      if (ok && length % 16)
+	{
+	  p = in + done + length - 16;
+	  str = _mm_loadu_si128 ((const __m128i *) p);
+	  ok = dec_pack_128 (&str);
+	  _mm_storeu_si128 ((__m128i *) (out + w + (length - 16) / 4 * 3),
+			    _mm_shuffle_epi8 (str, gather));
+	}
+
+      memcpy (&next, in + done + length, sizeof next);
+      if (!ok || ((next ^ term) & mask))
+	break;
+
+      done += length + eol;
+      w += length / 4 * 3;
+    }
+
+  *written += w;
+  return done;
+}
+
+/* The wrapped decoders decode the blocks as the plain ones, and only
+   look for whitespace in the blocks that fail validation: the quanta
+   before it are decoded, its characters being replaced by valid ones
+   so that the whole block can still be validated and packed at once,
+   then the decoding resumes after it.  Regular lines are then decoded
+   by decode_lines_*.  */
+__attribute__ ((target ("ssse3")))
+size_t
+base64_decode_wrapped_ssse3 (const char *in, size_t inlen, char *out,
+			     size_t *outlen)
+{
+  const __m128i gather = _mm_loadu_si128 ((const __m128i *) dec_gather);
+  struct ws_lines lines = { 0, 0, 0 };
+  size_t done = 0, written = 0;
+
+  while (inlen - done >= 16 && *outlen - written >= 16)
+    {
+      __m128i str = _mm_loadu_si128 ((const __m128i *) (in + done));
+      __m128i ws;
+      unsigned int len, skip;
+
+      if (__builtin_expect (dec_pack_128 (&str), 1))
+	{
+	  _mm_storeu_si128 ((__m128i *) (out + written),
+			    _mm_shuffle_epi8 (str, gather));
+	  done += 16;
+	  written += 12;
+	  continue;
+	}
+
+      ws = ws_classify_128 (str);
+      if (!ws_split (_mm_movemask_epi8 (ws), 16, &len, &skip))
+	break;
+
+      if (len)
+	{
+	  str = _mm_or_si128 (_mm_andnot_si128 (ws, str),
+			      _mm_and_si128 (ws, _mm_set1_epi8 ('A')));
+	  if (!dec_pack_128 (&str))
+	    break;
+
+	  _mm_storeu_si128 ((__m128i *) (out + written),
+			    _mm_shuffle_epi8 (str, gather));
+	  written += len / 4 * 3;
+	}
+
+      done += len + skip;
+
+      if (len + skip < 16)
+	{
+	  size_t length = ws_learn (&lines, done - skip, skip);
+
+	  if (length)
+	    {
+	      done += decode_lines_ssse3 (in + done, inlen - done,
+					  out + written, *outlen - written,
+					  length, skip, &written);
+	      lines.start = done;
+	    }
+	}
+      else
+	lines.start = WS_LINES_UNKNOWN;
+    }
+
+  *outlen = written;
+  return done;
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+ws_classify_256 (__m256i in)
+{
+  const __m256i controls = _mm256_sub_epi8 (in, _mm256_set1_epi8 ('\t'));
+
+  return _mm256_or_si256 (_mm256_cmpeq_epi8 (_mm256_min_epu8 (controls,
+							      _mm256_set1_epi8 (4)),
+					     controls),
+			  _mm256_cmpeq_epi8 (in, _mm256_set1_epi8 (' ')));
+}
+
+/* Pack the 24 bytes decoded by dec_pack_256 next to each other, and
+   store them to OUT, which must have room for 32 bytes.  */
+__attribute__ ((target ("avx2")))
+static inline void
+dec_store_256 (__m256i str, char *out)
+{
+  const __m256i gather =
+    _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *)
+						  dec_gather));
+  /* Move the 12 bytes of the upper lane next to those of the lower
+     one.  */
+  const __m256i merge = _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 3, 7);
+
+  str = _mm256_shuffle_epi8 (str, gather);
+  str = _mm256_permutevar8x32_epi32 (str, merge);
+  _mm256_storeu_si256 ((__m256i *) out, str);
+}
+
+__attribute__ ((target ("avx2"), noinline))
+static size_t
+decode_lines_avx2 (const char *in, size_t inlen, char *out, size_t outlen,
+		   size_t length, size_t eol, size_t *written)
+{
+  const unsigned int mask = eol < 4 ? (1u << 8 * eol) - 1 : ~0u;
+  unsigned int term, next;
+  size_t done = 0, w = 0;
+
+  if (length < 32 || inlen < 4)
+    return 0;
+
+  memcpy (&term, in - eol, sizeof term);
+  while (inlen - done >= length + eol + 32
+	 && outlen - w >= length / 4 * 3 + 32)
+    {
+      __m256i errors = _mm256_setzero_si256 ();
+      const char *p = in + done;
+      char *o = out + w;
+      __m256i str;
+      size_t k;
+
+      for (k = 0; k + 32 <= length; k += 32, p += 32, o += 24)
+	{
+	  str = _mm256_loadu_si256 ((const __m256i *) p);
+	  dec_pack_unchecked_256 (&str, &errors);
+	  dec_store_256 (str, o);
+	}
+
+      /* As in decode_lines_ssse3.  */
+      if (length % 32)
+	{
+	  p = in + done + length - 32;
+	  str = _mm256_loadu_si256 ((const __m256i *) p);
+	  dec_pack_unchecked_256 (&str, &errors);
+	  dec_store_256 (str, out + w + (length - 32) / 4 * 3);
+	}
+
+      memcpy (&next, in + done + length, sizeof next);
+      if (((next ^ term) & mask) | !_mm256_testz_si256 (errors, errors))
+	break;
+
+      done += length + eol;
+      w += length / 4 * 3;
+    }
+
+  *written += w;
+  return done;
+}
+
+__attribute__ ((target ("avx2")))
+size_t
+base64_decode_wrapped_avx2 (const char *in, size_t inlen, char *out,
+			    size_t *outlen)
+{
+  struct ws_lines lines = { 0, 0, 0 };
+  size_t done = 0, written = 0, rest;
+
+  while (inlen - done >= 32 && *outlen - written >= 32)
+    {
+      __m256i str = _mm256_loadu_si256 ((const __m256i *) (in + done));
+      __m256i ws;
+      unsigned int len, skip;
+
+      if (__builtin_expect (dec_pack_256 (&str), 1))
+	{
+	  dec_store_256 (str, out + written);
+	  done += 32;
+	  written += 24;
+	  continue;
+	}
+
+      ws = ws_classify_256 (str);
+      if (!ws_split (_mm256_movemask_epi8 (ws), 32, &len, &skip))
+	break;
+
+      if (len)
+	{
+	  str = _mm256_blendv_epi8 (str, _mm256_set1_epi8 ('A'), ws);
+	  if (!dec_pack_256 (&str))
+	    break;
+
+	  dec_store_256 (str, out + written);
+	  written += len / 4 * 3;
+	}
+
+      done += len + skip;
+
+      if (len + skip < 32)
+	{
+	  size_t length = ws_learn (&lines, done - skip, skip);
+
+	  if (length)
+	    {
+	      done += decode_lines_avx2 (in + done, inlen - done,
+					 out + written, *outlen - written,
+					 length, skip, &written);
+	      lines.start = done;
+	    }
+	}
+      else
+	lines.start = WS_LINES_UNKNOWN;
+    }
+
+  rest = *outlen - written;
+  done += base64_decode_wrapped_ssse3 (in + done, inlen - done,
+				       out + written, &rest);
+  *outlen = written + rest;
+  return done;
+}
+
+/* The batch kernels encode or decode each message with the usual
+   loops, except for its tail: the last bytes (at most 15) or
+   characters (at most 16, including the padding), which do not fill a
+   vector, are loaded in a 128-bit lane by batch_load_tail instead of
+   going through the portable code, and the AVX2 kernels pair the tail
+   of a message with the one of the next message in a single vector.
+   The tail of a message is processed before its body, whose stores
+   are exact, and the tails are written in order by 16-byte stores,
+   the excess of which is overwritten by the messages that follow;
+   only the stores that would cross the end of OUT go through a
+   copy.  */
+struct batch_tail
+{
+  size_t msg;			/* Message the tail belongs to.  */
+  char *out;
+  size_t outlen;		/* Bytes or characters produced.  */
+  size_t valid;			/* Characters of the output that are not
+				   padding (encoding).  */
+  __m128i v;
+};
+
+/* Load the LEN first of the LEFT <= 16 last bytes of a message of SIZE
+   bytes, which start at IN, in the low bytes of a vector whose other
+   bytes are zero.  The load ends at the end of the message and is
+   shifted into place, so that the message is never read past its end;
+   only messages shorter than a vector are copied first.  */
+__attribute__ ((target ("ssse3")))
+static inline __m128i
+batch_load_tail (const char *in, size_t left, size_t len, size_t size)
+{
+  const __m128i iota = _mm_setr_epi8 (0, 1, 2, 3, 4, 5, 6, 7,
+				      8, 9, 10, 11, 12, 13, 14, 15);
+  __m128i shift;
+
+  if (size < 16)
+    {
+      char buf[16] = { 0 };
+
+      memcpy (buf, in, len);
+      return _mm_loadu_si128 ((const __m128i *) buf);
+    }
+
+  /* Indices with their high bit set select zero.  */
+  shift = _mm_add_epi8 (iota, _mm_set1_epi8 (16 - left));
+  shift = _mm_or_si128 (shift, _mm_cmpgt_epi8 (iota, _mm_set1_epi8 (len - 1)));
+  return _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *)
+					    (in + left - 16)), shift);
+}
+
+/* Store the 16 bytes of V, the first OUTLEN of which are meant for OUT,
+   before END.  */
+__attribute__ ((target ("ssse3")))
+static inline void
+batch_store_tail (char *out, size_t outlen, __m128i v, const char *end)
+{
+  if (end - out >= 16)
+    _mm_storeu_si128 ((__m128i *) out, v);
+  else
+    {
+      char buf[16];
+
+      _mm_storeu_si128 ((__m128i *) buf, v);
+      memcpy (out, buf, outlen);
+    }
+}
+
+/* Number of bytes of a message of SIZE bytes that the encoding loops
+   leave over: the encoders below stop before the last 16 bytes.  */
+static inline size_t
+enc_tail_size (size_t size)
+{
+  return size < 16 ? size : (size - 4) % 12 + 4;
+}
+
+/* Prepare in *TAIL the LEN bytes found LEFT bytes before the end of
+   message MSG of SIZE bytes, whose encoding starts at OUT.  */
+__attribute__ ((target ("ssse3")))
+static inline void
+enc_tail_load (struct batch_tail *tail, size_t msg, const char *in,
+	       size_t size, char *out, size_t left, size_t len)
+{
+  tail->msg = msg;
+  tail->out = out + (size - left) / 3 * 4;
+  tail->outlen = (len + 2) / 3 * 4;
+  tail->valid = (len * 4 + 2) / 3;
+  /* Zero bytes complete the last group as the padding requires.  */
+  tail->v = batch_load_tail (in + size - left, left, len, size);
+}
+
+/* Store the characters V encoded from *TAIL, whose padding is filled
+   in first.  */
+__attribute__ ((target ("ssse3")))
+static inline void
+enc_tail_store (const struct batch_tail *tail, __m128i v, const char *end)
+{
+  const __m128i iota = _mm_setr_epi8 (0, 1, 2, 3, 4, 5, 6, 7,
+				      8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i pad = _mm_cmpgt_epi8 (iota, _mm_set1_epi8 (tail->valid - 1));
+
+  v = _mm_or_si128 (_mm_andnot_si128 (pad, v),
+		    _mm_and_si128 (pad, _mm_set1_epi8 ('=')));
+  batch_store_tail (tail->out, tail->outlen, v, end);
+}
+
+__attribute__ ((target ("ssse3")))
+size_t
+base64_encode_batch_ssse3 (const char *const *in, const size_t *inlen,
+			   size_t n, char *out, size_t outlen,
+			   const size_t *offsets)
+{
+  struct batch_tail tail;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      size_t left = enc_tail_size (inlen[i]);
+      char *o = out + offsets[i];
+
+      while (left)
+	{
+	  size_t len = left < 12 ? left : 12;
+
+	  enc_tail_load (&tail, i, in[i], inlen[i], o, left, len);
+	  enc_tail_store (&tail, enc_translate_128 (enc_reshuffle_128 (tail.v)),
+			  out + outlen);
+	  left -= len;
+	}
+
+      base64_encode_ssse3 (in[i], inlen[i], o);
+    }
+
+  return n;
+}
+
+__attribute__ ((target ("avx2")))
+size_t
+base64_encode_batch_avx2 (const char *const *in, const size_t *inlen,
+			  size_t n, char *out, size_t outlen,
+			  const size_t *offsets)
+{
+  struct batch_tail pending, tail;
+  bool busy = false;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      size_t left = enc_tail_size (inlen[i]);
+      char *o = out + offsets[i];
+
+      while (left)
+	{
+	  size_t len = left < 12 ? left : 12;
+	  __m256i v;
+
+	  left -= len;
+	  if (!busy)
+	    {
+	      enc_tail_load (&pending, i, in[i], inlen[i], o, left + len, len);
+	      busy = true;
+	      continue;
+	    }
+
+	  enc_tail_load (&tail, i, in[i], inlen[i], o, left + len, len);
+	  v = _mm256_inserti128_si256 (_mm256_castsi128_si256 (pending.v),
+				       tail.v, 1);
+	  v = enc_translate_256 (enc_reshuffle_256 (v));
+	  enc_tail_store (&pending, _mm256_castsi256_si128 (v), out + outlen);
+	  enc_tail_store (&tail, _mm256_extracti128_si256 (v, 1), out + outlen);
+	  busy = false;
+	}
+
+      base64_encode_avx2 (in[i], inlen[i], o);
+    }
+
+  if (busy)
+    enc_tail_store (&pending,
+		    enc_translate_128 (enc_reshuffle_128 (pending.v)),
+		    out + outlen);
+  return n;
+}
+
+/* Prepare in *TAIL the end of message MSG of SIZE characters, whose
+   decoding starts at OUT: the characters left over by the decoding
+   loops below, which stop before the padded quantum, are decoded with
+   the padding replaced by 'A'.  Return false if there is none.  */
+__attribute__ ((target ("ssse3")))
+static inline bool
+dec_tail_load (struct batch_tail *tail, size_t msg, const char *in,
+	       size_t size, char *out)
+{
+  const __m128i iota = _mm_setr_epi8 (0, 1, 2, 3, 4, 5, 6, 7,
+				      8, 9, 10, 11, 12, 13, 14, 15);
+  size_t pad, left;
+
+  if (size == 0)
+    return false;
+  pad = in[size - 1] == '=' ? 1 + (in[size - 2] == '=') : 0;
+  left = (size - (pad ? 4 : 0)) % 16 + (pad ? 4 : 0);
+  if (left == 0)
+    return false;
+
+  tail->msg = msg;
+  tail->out = out + (size - left) / 4 * 3;
+  tail->outlen = left / 4 * 3 - pad;
+  tail->v = batch_load_tail (in + size - left, left, left - pad, size);
+  tail->v = _mm_or_si128 (tail->v,
+			  _mm_and_si128 (_mm_cmpgt_epi8 (iota,
+							 _mm_set1_epi8 (left - pad - 1)),
+					 _mm_set1_epi8 ('A')));
+  return true;
+}
+
+/* Decode the whole 16-character blocks of the SIZE characters of IN
+   that come before the padded quantum, storing exactly the decoded
+   bytes.  Return false if one of them is not valid.  */
+__attribute__ ((target ("ssse3")))
+static inline bool
+dec_body_ssse3 (const char *in, size_t size, char *out)
+{
+  const __m128i gather = _mm_loadu_si128 ((const __m128i *) dec_gather);
+  size_t done;
+
+  if (size && in[size - 1] == '=')
+    size -= 4;
+
+  for (done = 0; size - done >= 16; done += 16, out += 12)
+    {
+      __m128i str = _mm_loadu_si128 ((const __m128i *) (in + done));
+
+      if (!dec_pack_128 (&str))
+	return false;
+
+      str = _mm_shuffle_epi8 (str, gather);
+      _mm_storel_epi64 ((__m128i *) out, str);
+      *(int *) (out + 8) = _mm_cvtsi128_si32 (_mm_srli_si128 (str, 8));
+    }
+
+  return true;
+}
+
+__attribute__ ((target ("avx2")))
+static inline bool
+dec_body_avx2 (const char *in, size_t size, char *out)
+{
+  const __m256i gather =
+    _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *)
+						  dec_gather));
+  const __m256i merge = _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 3, 7);
+  size_t done, body = size && in[size - 1] == '=' ? size - 4 : size;
+
+  for (done = 0; body - done >= 32; done += 32, out += 24)
+    {
+      __m256i str = _mm256_loadu_si256 ((const __m256i *) (in + done));
+
+      if (!dec_pack_256 (&str))
+	return false;
+
+      str = _mm256_permutevar8x32_epi32 (_mm256_shuffle_epi8 (str, gather),
+					 merge);
+      _mm_storeu_si128 ((__m128i *) out, _mm256_castsi256_si128 (str));
+      _mm_storel_epi64 ((__m128i *) (out + 16),
+			_mm256_extracti128_si256 (str, 1));
+    }
+
+  return dec_body_ssse3 (in + done, size - done, out);
+}
+
+/* Decode and store *TAIL on its own.  Return false if it is not
+   valid.  */
+__attribute__ ((target ("ssse3")))
+static inline bool
+dec_tail_store_ssse3 (struct batch_tail *tail, const char *end)
+{
+  if (!dec_pack_128 (&tail->v))
+    return false;
+
+  batch_store_tail (tail->out, tail->outlen,
+		    _mm_shuffle_epi8 (tail->v,
+				      _mm_loadu_si128 ((const __m128i *)
+						       dec_gather)),
+		    end);
+  return true;
+}
+
+__attribute__ ((target ("ssse3")))
+size_t
+base64_decode_batch_ssse3 (const char *const *in, const size_t *inlen,
+			   size_t n, char *out, size_t outlen,
+			   const size_t *offsets)
+{
+  struct batch_tail tail;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (dec_tail_load (&tail, i, in[i], inlen[i], out + offsets[i])
+	  && !dec_tail_store_ssse3 (&tail, out + outlen))
+	return i;
+
+      if (!dec_body_ssse3 (in[i], inlen[i], out + offsets[i]))
+	return i;
+    }
+
+  return n;
+}
+
+__attribute__ ((target ("avx2")))
+size_t
+base64_decode_batch_avx2 (const char *const *in, const size_t *inlen,
+			  size_t n, char *out, size_t outlen,
+			  const size_t *offsets)
+{
+  const __m256i gather =
+    _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *)
+						  dec_gather));
+  struct batch_tail pending, tail;
+  bool busy = false;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      /* A pending tail has to be written before the body of the next
+	 message, which its store overlaps.  */
+      if (!dec_tail_load (&tail, i, in[i], inlen[i], out + offsets[i]))
+	{
+	  if (busy && !dec_tail_store_ssse3 (&pending, out + outlen))
+	    return pending.msg;
+	  busy = false;
+	}
+      else if (!busy)
+	{
+	  pending = tail;
+	  busy = true;
+	}
+      else
+	{
+	  __m256i str = _mm256_inserti128_si256 (_mm256_castsi128_si256
+						 (pending.v), tail.v, 1);
+
+	  if (!dec_pack_256 (&str))
+	    return pending.msg;
+
+	  str = _mm256_shuffle_epi8 (str, gather);
+	  batch_store_tail (pending.out, pending.outlen,
+			    _mm256_castsi256_si128 (str), out + outlen);
+	  batch_store_tail (tail.out, tail.outlen,
+			    _mm256_extracti128_si256 (str, 1), out + outlen);
+	  busy = false;
+	}
+
+      if (!dec_body_avx2 (in[i], inlen[i], out + offsets[i]))
+	return busy ? pending.msg : i;
+    }
+
+  if (busy && !dec_tail_store_ssse3 (&pending, out + outlen))
+    return pending.msg;
+  return n;
+}
+
+#endif /* BASE64_HAVE_X86_KERNELS */
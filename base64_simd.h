@@ -0,0 +1,143 @@
+/* base64_simd.h -- Vectorized and SWAR kernels used by base64.c.
+
+   These are internal helpers: they only process whole blocks and
+   leave the remaining bytes (and the padding) to the portable code in
+   base64.c.  Each kernel returns the number of input bytes it
+   consumed.  */
+
+#ifndef BASE64_SIMD_H
+# define BASE64_SIMD_H
+
+# include <stddef.h>
+
+# if (defined __x86_64__ || defined __i386__) && defined __GNUC__
+#  define BASE64_HAVE_X86_KERNELS 1
+# else
+#  define BASE64_HAVE_X86_KERNELS 0
+# endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Portable kernels of base64_swar.c, working on 64-bit words.  The
+   encoder processes groups of 6 bytes but loads 8, and stops before
+   the last 8 bytes of IN; the decoder processes blocks of 32
+   characters whose last store writes 2 more bytes than it decodes, so
+   that OUTLEN must exceed the 24 bytes of a block by 2.  Like the
+   vectorized decoders, it stops before a block holding a character
+   that is not part of the alphabet, and so does the validator, which
+   only checks the blocks.  base64_swar_init fills their tables; the
+   load-time constructor of base64.c calls it first, so that the calls
+   made by base64_set_backend afterwards find them ready and write
+   nothing.  */
+extern void base64_swar_init (void);
+extern size_t base64_encode_swar (const char *in, size_t inlen, char *out);
+extern size_t base64_decode_swar (const char *in, size_t inlen,
+				  char *out, size_t outlen);
+extern size_t base64_validate_swar (const char *in, size_t inlen);
+
+# if BASE64_HAVE_X86_KERNELS
+
+/* Encode as many 12-byte (SSSE3) or 24-byte (AVX2) blocks of IN as
+   can be loaded without reading past IN + INLEN.  OUT must have room
+   for BASE64_LENGTH (INLEN) bytes.  The return value is always a
+   multiple of 3.  */
+extern size_t base64_encode_ssse3 (const char *in, size_t inlen, char *out);
+extern size_t base64_encode_avx2 (const char *in, size_t inlen, char *out);
+
+/* Encode the lines of LINE characters (a multiple of 4) at the start
+   of IN, each followed by the EOLLEN (at most 4) characters of EOL, as
+   long as 32 more bytes of IN follow the line and OUTLEN has room for
+   32 more characters.  These may be written past the terminator of
+   the last line, for base64.c to write over.  Return the number of
+   bytes encoded, a multiple of LINE / 4 * 3.  */
+extern size_t base64_encode_wrapped_ssse3 (const char *in, size_t inlen,
+					   char *out, size_t outlen,
+					   size_t line, const char *eol,
+					   size_t eollen);
+extern size_t base64_encode_wrapped_avx2 (const char *in, size_t inlen,
+					  char *out, size_t outlen,
+					  size_t line, const char *eol,
+					  size_t eollen);
+
+/* Decode as many 16-character (SSSE3) or 32-character (AVX2) blocks
+   of IN as fit, validating them on the way.  Each store writes a full
+   vector, so OUTLEN must exceed the decoded size of a block by 4
+   (SSSE3) or 8 (AVX2) bytes for it to be processed.  Decoding stops
+   before the first block holding a character that is not part of the
+   Base64 alphabet, padding included, so that base64.c can report the
+   error.  The return value is always a multiple of 4.  */
+extern size_t base64_decode_ssse3 (const char *in, size_t inlen,
+				   char *out, size_t outlen);
+extern size_t base64_decode_avx2 (const char *in, size_t inlen,
+				  char *out, size_t outlen);
+
+/* Check as many 16-character (SSSE3) or 32-character (AVX2) blocks of
+   IN as fit, without decoding them.  Like the decoders, they stop
+   before the first block holding a character that is not part of the
+   alphabet, and return a multiple of 4.  */
+extern size_t base64_validate_ssse3 (const char *in, size_t inlen);
+extern size_t base64_validate_avx2 (const char *in, size_t inlen);
+
+/* Same as above, for arrays of WIDTH-byte elements (2, 4 or 8; the
+   kernels do nothing otherwise) whose bytes are reversed on the way:
+   see base64_encode_be.  They work on groups of 24 bytes (32
+   characters), which hold whole elements, so that the return value is
+   a multiple of 24 (encoders) or 32 (decoders).  The SSSE3 decoder
+   only stores the bytes it decodes; the AVX2 one needs 8 more.  */
+extern size_t base64_encode_be_ssse3 (const char *in, size_t inlen,
+				      char *out, size_t width);
+extern size_t base64_encode_be_avx2 (const char *in, size_t inlen,
+				     char *out, size_t width);
+extern size_t base64_decode_be_ssse3 (const char *in, size_t inlen,
+				      char *out, size_t outlen, size_t width);
+extern size_t base64_decode_be_avx2 (const char *in, size_t inlen,
+				     char *out, size_t outlen, size_t width);
+
+/* Same as the decoders above, skipping the runs of whitespace
+   (space, '\t', '\n', '\v', '\f' and '\r') that fall between two
+   quanta.  They stop before whitespace found within a quantum, and
+   before a block holding a character that is neither whitespace nor
+   part of the alphabet.  *OUTLEN is the room left in OUT, which
+   must exceed the decoded size of a block by 4 (SSSE3) or 8 (AVX2)
+   bytes for it to be processed; on return, it holds the number of
+   bytes written.  */
+extern size_t base64_decode_wrapped_ssse3 (const char *in, size_t inlen,
+					   char *out, size_t *outlen);
+extern size_t base64_decode_wrapped_avx2 (const char *in, size_t inlen,
+					  char *out, size_t *outlen);
+
+/* Encode or decode the N messages IN[i] of INLEN[i] bytes, back to
+   back, to OUT + OFFSETS[i]; the OUTLEN bytes of OUT must hold them
+   all.  The messages of the decoders must be made of whole quanta,
+   with their decoded size laid out in OFFSETS.  The return value is
+   the number of messages processed.  The encoders process them all;
+   the decoders stop at the latest before the first message holding a
+   character that is not part of the alphabet, which base64.c then
+   decodes on its own to report the error.  */
+extern size_t base64_encode_batch_ssse3 (const char *const *in,
+					 const size_t *inlen, size_t n,
+					 char *out, size_t outlen,
+					 const size_t *offsets);
+extern size_t base64_encode_batch_avx2 (const char *const *in,
+					const size_t *inlen, size_t n,
+					char *out, size_t outlen,
+					const size_t *offsets);
+extern size_t base64_decode_batch_ssse3 (const char *const *in,
+					 const size_t *inlen, size_t n,
+					 char *out, size_t outlen,
+					 const size_t *offsets);
+extern size_t base64_decode_batch_avx2 (const char *const *in,
+					const size_t *inlen, size_t n,
+					char *out, size_t outlen,
+					const size_t *offsets);
+
+# endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BASE64_SIMD_H */
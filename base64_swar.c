@@ -0,0 +1,222 @@
+/* base64_swar.c -- Portable table-driven base64 kernels.
+
+   These kernels need no vector extension, only 64-bit arithmetic.
+   The encoder turns every 12 bits of input into two characters with a
+   single lookup in a 4096-entry table.  The decoder looks each
+   character up in one of four tables holding its 6-bit value already
+   shifted to its place in a 24-bit group, so that a quantum is decoded
+   by ORing four entries.  The entries of invalid characters have their
+   high byte set, and are ORed into an error flag that is only checked
+   once per block, which keeps the loops free of data-dependent
+   branches.  */
+
+#include "base64_simd.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char b64str[64] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* Characters of each 12-bit value.  */
+static char enc_pairs[4096][2];
+
+/* Value of each character, shifted to its place in a 24-bit group for
+   each of the 4 positions of a quantum, or DEC_INVALID.  */
+static uint32_t dec_shifted[4][256];
+
+#define DEC_INVALID 0xff000000u
+
+void
+base64_swar_init (void)
+{
+  static bool ready;
+  int i, j;
+
+  if (ready)
+    return;
+  ready = true;
+
+  for (i = 0; i < 4096; i++)
+    {
+      enc_pairs[i][0] = b64str[i >> 6];
+      enc_pairs[i][1] = b64str[i & 0x3f];
+    }
+
+  for (j = 0; j < 4; j++)
+    for (i = 0; i < 256; i++)
+      dec_shifted[j][i] = DEC_INVALID;
+  for (i = 0; i < 64; i++)
+    for (j = 0; j < 4; j++)
+      dec_shifted[j][(unsigned char) b64str[i]] = (uint32_t) i << (18 - 6 * j);
+}
+
+/* Big-endian loads and stores, whatever the byte order of the machine.
+   GCC and Clang turn them into a single access and a byte swap; other
+   compilers get the byte-at-a-time version.  */
+#if defined __GNUC__ && defined __BYTE_ORDER__
+# if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define SWAR_TO_BE64(v) __builtin_bswap64 (v)
+# elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#  define SWAR_TO_BE64(v) (v)
+# endif
+#endif
+
+static inline uint64_t
+load_be64 (const char *p)
+{
+#ifdef SWAR_TO_BE64
+  uint64_t v;
+
+  memcpy (&v, p, sizeof v);
+  return SWAR_TO_BE64 (v);
+#else
+  const unsigned char *q = (const unsigned char *) p;
+
+  return ((uint64_t) q[0] << 56 | (uint64_t) q[1] << 48
+	  | (uint64_t) q[2] << 40 | (uint64_t) q[3] << 32
+	  | (uint64_t) q[4] << 24 | (uint64_t) q[5] << 16
+	  | (uint64_t) q[6] << 8 | (uint64_t) q[7]);
+#endif
+}
+
+static inline void
+store_be64 (char *p, uint64_t v)
+{
+#ifdef SWAR_TO_BE64
+  v = SWAR_TO_BE64 (v);
+  memcpy (p, &v, sizeof v);
+#else
+  unsigned char *q = (unsigned char *) p;
+
+  q[0] = v >> 56;
+  q[1] = v >> 48;
+  q[2] = v >> 40;
+  q[3] = v >> 32;
+  q[4] = v >> 24;
+  q[5] = v >> 16;
+  q[6] = v >> 8;
+  q[7] = v;
+#endif
+}
+
+/* Encode the 6 bytes found at the top of V into 8 characters.  */
+static inline void
+enc_swar (uint64_t v, char *out)
+{
+  memcpy (out, enc_pairs[(v >> 52) & 0xfff], 2);
+  memcpy (out + 2, enc_pairs[(v >> 40) & 0xfff], 2);
+  memcpy (out + 4, enc_pairs[(v >> 28) & 0xfff], 2);
+  memcpy (out + 6, enc_pairs[(v >> 16) & 0xfff], 2);
+}
+
+size_t
+base64_encode_swar (const char *in, size_t inlen, char *out)
+{
+  size_t done = 0;
+
+  /* Each iteration uses 24 bytes but loads up to IN + 26.  */
+  for (; inlen - done >= 26; done += 24, out += 32)
+    {
+      enc_swar (load_be64 (in + done), out);
+      enc_swar (load_be64 (in + done + 6), out + 8);
+      enc_swar (load_be64 (in + done + 12), out + 16);
+      enc_swar (load_be64 (in + done + 18), out + 24);
+    }
+
+  for (; inlen - done >= 8; done += 6, out += 8)
+    enc_swar (load_be64 (in + done), out);
+
+  return done;
+}
+
+/* Decode the 8 characters at IN into the 48 bits at the top of the
+   result, ORing the entries of invalid characters into *ERRORS.  */
+static inline uint64_t
+dec_swar (const char *in, uint32_t *errors)
+{
+  const unsigned char *q = (const unsigned char *) in;
+  uint32_t hi = (dec_shifted[0][q[0]] | dec_shifted[1][q[1]]
+		 | dec_shifted[2][q[2]] | dec_shifted[3][q[3]]);
+  uint32_t lo = (dec_shifted[0][q[4]] | dec_shifted[1][q[5]]
+		 | dec_shifted[2][q[6]] | dec_shifted[3][q[7]]);
+
+  *errors |= hi | lo;
+  return (uint64_t) hi << 40 | (uint64_t) lo << 16;
+}
+
+size_t
+base64_decode_swar (const char *in, size_t inlen, char *out, size_t outlen)
+{
+  size_t done = 0;
+
+  /* Each block decodes 24 bytes but its last store writes 26.  A block
+     holding an invalid character is left to the portable code.  */
+  while (inlen - done >= 32 && outlen >= 26)
+    {
+      uint32_t errors = 0;
+      uint64_t v0 = dec_swar (in + done, &errors);
+      uint64_t v1 = dec_swar (in + done + 8, &errors);
+      uint64_t v2 = dec_swar (in + done + 16, &errors);
+      uint64_t v3 = dec_swar (in + done + 24, &errors);
+
+      if (errors & DEC_INVALID)
+	break;
+
+      store_be64 (out, v0);
+      store_be64 (out + 6, v1);
+      store_be64 (out + 12, v2);
+      store_be64 (out + 18, v3);
+
+      done += 32;
+      out += 24;
+      outlen -= 24;
+    }
+
+  return done;
+}
+
+/* Bytes of X, whose high bits are clear, that lie between LO and HI:
+   adding 0x80 - LO sets the high bit of those at least equal to LO,
+   adding 0x7f - HI that of those above HI, without carrying to the
+   next byte.  The result only keeps the high bits.  */
+#define SWAR_ONES 0x0101010101010101u
+#define SWAR_IN_RANGE(x, lo, hi) \
+  (((x) + (0x80 - (lo)) * SWAR_ONES) & ~((x) + (0x7f - (hi)) * SWAR_ONES) \
+   & 0x80 * SWAR_ONES)
+
+/* High bit of each of the 8 characters of V that is not part of the
+   alphabet.  */
+static inline uint64_t
+val_swar (uint64_t v)
+{
+  uint64_t x = v & 0x7f * SWAR_ONES;
+  uint64_t valid = (SWAR_IN_RANGE (x, 'A', 'Z') | SWAR_IN_RANGE (x, 'a', 'z')
+		    | SWAR_IN_RANGE (x, '0', '9') | SWAR_IN_RANGE (x, '+', '+')
+		    | SWAR_IN_RANGE (x, '/', '/'));
+
+  return (~valid | v) & 0x80 * SWAR_ONES;
+}
+
+size_t
+base64_validate_swar (const char *in, size_t inlen)
+{
+  size_t done = 0;
+
+  /* Blocks of 32 characters, like the decoder, checked 8 at a time
+     with no lookup.  */
+  while (inlen - done >= 32)
+    {
+      uint64_t w[4];
+
+      memcpy (w, in + done, sizeof w);
+      if (val_swar (w[0]) | val_swar (w[1]) | val_swar (w[2])
+	  | val_swar (w[3]))
+	break;
+
+      done += 32;
+    }
+
+  return done;
+}
@@ -0,0 +1,750 @@
+/* base85.c -- Encode binary data with the Z85 alphabet.
+
+   The portable code encodes and decodes a group of 4 bytes at a time.
+   The vectorized kernels work on 4 (SSSE3) or 8 (AVX2) groups, one
+   per 32-bit lane.  The encoder divides them twice by 85^2 with
+   multiplications by a reciprocal, then splits both remainders into
+   two digits at once in 16-bit lanes, and maps the digits to the
+   alphabet with shuffles.  The decoder looks up the digit of every
+   character with a shuffle per high nibble.  It then merges the
+   digits of a group with two multiply-add instructions, and one more
+   multiplication by 85 that is checked for overflow.
+
+   The kernels return the number of input bytes they consumed, and
+   leave the rest to the portable code, which reports the errors.  */
+
+/* Get prototype. */
+#include "base85.h"
+
+/* Get base64_get_backend and the kernels' target check. */
+#define RESTRICT restrict
+#include "base64.h"
+#include "base64_simd.h"
+
+/* Get malloc. */
+#include <stdlib.h>
+
+/* Get uint32_t and uint64_t. */
+#include <stdint.h>
+
+/* Get memcpy. */
+#include <string.h>
+
+static const char z85[85] =
+  "0123456789abcdefghijklmnopqrstuvwxyz"
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZ.-:+=^!/*?&<>()[]{}@%$#";
+
+/* Digit of every character, -1 for those out of the alphabet.  */
+static const signed char z85_digits[256] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, 68, -1, 84, 83, 82, 72, -1, 75, 76, 70, 65, -1, 63, 62, 69,
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 64, -1, 73, 66, 74, 71,
+  81, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50,
+  51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 77, -1, 78, 67, -1,
+  -1, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+  25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 79, -1, 80, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+/* C89 compliant way to cast 'char' to 'unsigned char'. */
+static inline unsigned char
+to_uchar (char ch)
+{
+  return ch;
+}
+
+bool
+isbase85 (char ch)
+{
+  return z85_digits[to_uchar (ch)] >= 0;
+}
+
+#if BASE64_HAVE_X86_KERNELS
+
+# include <immintrin.h>
+
+/* Reverse the bytes of every 32-bit lane.  */
+static const signed char bswap32[16] = {
+  3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+};
+
+/* Gather the 20 digits of 4 groups in the order they are written,
+   from the first digit of each group, in the low byte of each lane of
+   one vector, and the 4 others, stored as 3, 4, 1, 2 in the lanes of
+   another: the first 16 digits in one vector, the last 4 in
+   another.  */
+static const signed char enc_first_lead[16] = {
+  0, -1, -1, -1, -1, 4, -1, -1, -1, -1, 8, -1, -1, -1, -1, 12
+};
+static const signed char enc_first_rest[16] = {
+  -1, 2, 3, 0, 1, -1, 6, 7, 4, 5, -1, 10, 11, 8, 9, -1
+};
+static const signed char enc_last_rest[16] = {
+  14, 15, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+/* Digits above 61, which are not letters or digits.  */
+static const char enc_punct[32] = ".-:+=^!/*?&<>()[]{}@%$#";
+
+/* Quotient of the 32-bit lanes of X by 85^2, and their remainder in
+   *REM.  The quotient is the high part of the product by 2^44 / 85^2,
+   rounded up, which is exact for every 32-bit value; the
+   multiplication only takes the even lanes, so the odd ones are
+   shifted down first.  */
+__attribute__ ((target ("ssse3")))
+static inline __m128i
+enc_div7225_128 (__m128i x, __m128i *rem)
+{
+  const __m128i magic = _mm_set1_epi32 ((int) 0x9121b243);
+  const __m128i even = _mm_srli_epi64 (_mm_mul_epu32 (x, magic), 44);
+  const __m128i odd = _mm_mul_epu32 (_mm_srli_epi64 (x, 32), magic);
+  const __m128i q = _mm_or_si128 (even,
+				  _mm_and_si128 (_mm_srli_epi64 (odd, 12),
+						 _mm_set1_epi64x ((long long) 0xffffffff00000000ULL)));
+  __m128i q85 = _mm_add_epi32 (q, _mm_slli_epi32 (q, 2));
+
+  q85 = _mm_add_epi32 (q85, _mm_slli_epi32 (q85, 4));
+  q85 = _mm_add_epi32 (q85, _mm_slli_epi32 (q85, 2));
+  *rem = _mm_sub_epi32 (x, _mm_add_epi32 (q85, _mm_slli_epi32 (q85, 4)));
+  return q;
+}
+
+/* Split the 16-bit lanes of X, below 85^2, into their quotient by 85
+   (the high part of the product by 2^20 / 85, rounded up) in *HIGH
+   and their remainder in *LOW.  */
+__attribute__ ((target ("ssse3")))
+static inline void
+enc_split85_128 (__m128i x, __m128i *high, __m128i *low)
+{
+  *high = _mm_srli_epi16 (_mm_mulhi_epu16 (x, _mm_set1_epi16 (12337)), 4);
+  *low = _mm_sub_epi16 (x, _mm_mullo_epi16 (*high, _mm_set1_epi16 (85)));
+}
+
+/* Map digits to the characters of the alphabet: the digits, the
+   lowercase and the uppercase letters are each a range, whose offset
+   is looked up with a shuffle, and the other characters come from two
+   16-byte tables.  */
+__attribute__ ((target ("ssse3")))
+static inline __m128i
+enc_translate_128 (__m128i in)
+{
+  const __m128i offsets = _mm_setr_epi8 ('0', 'a' - 10, 'A' - 36, 0,
+					 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i punct0 = _mm_loadu_si128 ((const __m128i *) enc_punct);
+  const __m128i punct1 = _mm_loadu_si128 ((const __m128i *) (enc_punct + 16));
+  const __m128i punct = _mm_cmpgt_epi8 (in, _mm_set1_epi8 (61));
+  __m128i classes, letters, index, high, symbols;
+
+  classes = _mm_sub_epi8 (_mm_setzero_si128 (),
+			  _mm_cmpgt_epi8 (in, _mm_set1_epi8 (9)));
+  classes = _mm_sub_epi8 (classes, _mm_cmpgt_epi8 (in, _mm_set1_epi8 (35)));
+  letters = _mm_add_epi8 (in, _mm_shuffle_epi8 (offsets, classes));
+
+  /* Negative below 62, so that both shuffles give 0 there.  */
+  index = _mm_sub_epi8 (in, _mm_set1_epi8 (62));
+  high = _mm_cmpgt_epi8 (index, _mm_set1_epi8 (15));
+  symbols = _mm_or_si128 (_mm_shuffle_epi8 (punct0,
+					    _mm_or_si128 (index, high)),
+			  _mm_shuffle_epi8 (punct1,
+					    _mm_sub_epi8 (index,
+							  _mm_set1_epi8 (16))));
+
+  return _mm_or_si128 (_mm_andnot_si128 (punct, letters), symbols);
+}
+
+/* Encode the 4 groups of IN to the 16 first characters in *FIRST and
+   the 4 last ones in the low bytes of *LAST.  */
+__attribute__ ((target ("ssse3")))
+static inline void
+enc_groups_128 (__m128i in, __m128i *first, __m128i *last)
+{
+  __m128i lead, low, high, rest;
+
+  /* The first digit, then the 2 next ones and the 2 last ones as
+     numbers below 85^2, which share a lane to be split.  */
+  in = _mm_shuffle_epi8 (in, _mm_loadu_si128 ((const __m128i *) bswap32));
+  in = enc_div7225_128 (in, &low);
+  lead = enc_div7225_128 (in, &high);
+  enc_split85_128 (_mm_or_si128 (low, _mm_slli_epi32 (high, 16)), &high, &low);
+  rest = _mm_or_si128 (high, _mm_slli_epi32 (low, 8));
+
+  *first = _mm_or_si128
+    (_mm_shuffle_epi8 (lead, _mm_loadu_si128 ((const __m128i *) enc_first_lead)),
+     _mm_shuffle_epi8 (rest, _mm_loadu_si128 ((const __m128i *) enc_first_rest)));
+  *last = _mm_shuffle_epi8 (rest, _mm_loadu_si128 ((const __m128i *) enc_last_rest));
+  *first = enc_translate_128 (*first);
+  *last = enc_translate_128 (*last);
+}
+
+/* Encode as many 16-byte (SSSE3) or 32-byte (AVX2) blocks of IN as
+   fit in INLEN.  OUT must have room for BASE85_LENGTH (INLEN)
+   bytes.  */
+__attribute__ ((target ("ssse3")))
+static size_t
+base85_encode_ssse3 (const char *in, size_t inlen, char *out)
+{
+  size_t done = 0;
+
+  while (inlen - done >= 16)
+    {
+      __m128i first, last;
+      int tail;
+
+      enc_groups_128 (_mm_loadu_si128 ((const __m128i *) (in + done)),
+		      &first, &last);
+      tail = _mm_cvtsi128_si32 (last);
+      _mm_storeu_si128 ((__m128i *) out, first);
+      memcpy (out + 16, &tail, 4);
+
+      done += 16;
+      out += 20;
+    }
+
+  return done;
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+enc_div7225_256 (__m256i x, __m256i *rem)
+{
+  const __m256i magic = _mm256_set1_epi32 ((int) 0x9121b243);
+  const __m256i even = _mm256_srli_epi64 (_mm256_mul_epu32 (x, magic), 44);
+  const __m256i odd = _mm256_mul_epu32 (_mm256_srli_epi64 (x, 32), magic);
+  const __m256i q = _mm256_or_si256 (even,
+				     _mm256_and_si256 (_mm256_srli_epi64 (odd, 12),
+						       _mm256_set1_epi64x ((long long) 0xffffffff00000000ULL)));
+
+  *rem = _mm256_sub_epi32 (x, _mm256_mullo_epi32 (q, _mm256_set1_epi32 (7225)));
+  return q;
+}
+
+__attribute__ ((target ("avx2")))
+static inline void
+enc_split85_256 (__m256i x, __m256i *high, __m256i *low)
+{
+  *high = _mm256_srli_epi16 (_mm256_mulhi_epu16 (x, _mm256_set1_epi16 (12337)), 4);
+  *low = _mm256_sub_epi16 (x, _mm256_mullo_epi16 (*high, _mm256_set1_epi16 (85)));
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+enc_translate_256 (__m256i in)
+{
+  const __m256i offsets = _mm256_setr_epi8 ('0', 'a' - 10, 'A' - 36, 0,
+					    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+					    '0', 'a' - 10, 'A' - 36, 0,
+					    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i punct0 = _mm256_broadcastsi128_si256
+    (_mm_loadu_si128 ((const __m128i *) enc_punct));
+  const __m256i punct1 = _mm256_broadcastsi128_si256
+    (_mm_loadu_si128 ((const __m128i *) (enc_punct + 16)));
+  const __m256i punct = _mm256_cmpgt_epi8 (in, _mm256_set1_epi8 (61));
+  __m256i classes, letters, index, high, symbols;
+
+  classes = _mm256_sub_epi8 (_mm256_setzero_si256 (),
+			     _mm256_cmpgt_epi8 (in, _mm256_set1_epi8 (9)));
+  classes = _mm256_sub_epi8 (classes,
+			     _mm256_cmpgt_epi8 (in, _mm256_set1_epi8 (35)));
+  letters = _mm256_add_epi8 (in, _mm256_shuffle_epi8 (offsets, classes));
+
+  index = _mm256_sub_epi8 (in, _mm256_set1_epi8 (62));
+  high = _mm256_cmpgt_epi8 (index, _mm256_set1_epi8 (15));
+  symbols = _mm256_or_si256
+    (_mm256_shuffle_epi8 (punct0, _mm256_or_si256 (index, high)),
+     _mm256_shuffle_epi8 (punct1,
+			  _mm256_sub_epi8 (index, _mm256_set1_epi8 (16))));
+
+  return _mm256_or_si256 (_mm256_andnot_si256 (punct, letters), symbols);
+}
+
+/* Same as enc_groups_128, on 8 groups: each lane of *FIRST and *LAST
+   holds the characters of its 4 groups.  */
+__attribute__ ((target ("avx2")))
+static inline void
+enc_groups_256 (__m256i in, __m256i *first, __m256i *last)
+{
+# define BROADCAST(table) \
+  _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *) (table)))
+  __m256i lead, low, high, rest;
+
+  in = _mm256_shuffle_epi8 (in, BROADCAST (bswap32));
+  in = enc_div7225_256 (in, &low);
+  lead = enc_div7225_256 (in, &high);
+  enc_split85_256 (_mm256_or_si256 (low, _mm256_slli_epi32 (high, 16)), &high, &low);
+  rest = _mm256_or_si256 (high, _mm256_slli_epi32 (low, 8));
+
+  *first = _mm256_or_si256 (_mm256_shuffle_epi8 (lead, BROADCAST (enc_first_lead)),
+			    _mm256_shuffle_epi8 (rest, BROADCAST (enc_first_rest)));
+  *last = _mm256_shuffle_epi8 (rest, BROADCAST (enc_last_rest));
+  *first = enc_translate_256 (*first);
+  *last = enc_translate_256 (*last);
+# undef BROADCAST
+}
+
+__attribute__ ((target ("avx2")))
+static size_t
+base85_encode_avx2 (const char *in, size_t inlen, char *out)
+{
+  size_t done = 0;
+
+  while (inlen - done >= 32)
+    {
+      __m256i first, last;
+      int tail;
+
+      enc_groups_256 (_mm256_loadu_si256 ((const __m256i *) (in + done)),
+		      &first, &last);
+      _mm_storeu_si128 ((__m128i *) out, _mm256_castsi256_si128 (first));
+      tail = _mm256_extract_epi32 (last, 0);
+      memcpy (out + 16, &tail, 4);
+      _mm_storeu_si128 ((__m128i *) (out + 20),
+			_mm256_extracti128_si256 (first, 1));
+      tail = _mm256_extract_epi32 (last, 4);
+      memcpy (out + 36, &tail, 4);
+
+      done += 32;
+      out += 40;
+    }
+
+  return done + base85_encode_ssse3 (in + done, inlen - done, out);
+}
+
+/* Digit of each character plus one, or 0 if it is out of the
+   alphabet, by high nibble from 2 to 7 (the alphabet lies between
+   '!' and '}') and low nibble.  */
+static const signed char dec_digits[6][16] = {
+  {0, 69, 0, 85, 84, 83, 73, 0, 76, 77, 71, 66, 0, 64, 63, 70},
+  {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 65, 0, 74, 67, 75, 72},
+  {82, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51},
+  {52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 78, 0, 79, 68, 0},
+  {0, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25},
+  {26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 80, 0, 81, 0, 0}
+};
+
+/* Gather the 4 first digits of each group of a block of 20
+   characters, from the 16 first characters (only the first group) and
+   the 16 last ones, and its last digit, zero extended.  */
+static const signed char dec_first_head[16] = {
+  0, 1, 2, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+static const signed char dec_first_tail[16] = {
+  -1, -1, -1, -1, 1, 2, 3, 4, 6, 7, 8, 9, 11, 12, 13, 14
+};
+static const signed char dec_last_tail[16] = {
+  0, -1, -1, -1, 5, -1, -1, -1, 10, -1, -1, -1, 15, -1, -1, -1
+};
+
+/* Largest value of the 4 first digits of a group that fits in 32 bits
+   once multiplied by 85, with a last digit of 0 only.  */
+# define DEC_LIMIT 50529027
+
+__attribute__ ((target ("ssse3")))
+static inline __m128i
+dec_translate_128 (__m128i in)
+{
+  const __m128i lo = _mm_and_si128 (in, _mm_set1_epi8 (0x0f));
+  const __m128i hi = _mm_and_si128 (_mm_srli_epi16 (in, 4),
+				    _mm_set1_epi8 (0x0f));
+  __m128i digits = _mm_setzero_si128 ();
+  int h;
+
+  for (h = 0; h < 6; h++)
+    {
+      const __m128i lut = _mm_loadu_si128 ((const __m128i *) dec_digits[h]);
+      digits = _mm_or_si128 (digits,
+			     _mm_and_si128 (_mm_cmpeq_epi8 (hi, _mm_set1_epi8 (h + 2)),
+					    _mm_shuffle_epi8 (lut, lo)));
+    }
+
+  return digits;
+}
+
+/* Decode the 4 groups of the block whose 16 first characters are in
+   HEAD and 16 last ones in TAIL, to 16 bytes.  The lanes of *ERRORS
+   are set if a character is out of the alphabet or a group does not
+   fit in 32 bits.  */
+__attribute__ ((target ("ssse3")))
+static inline __m128i
+dec_groups_128 (__m128i head, __m128i tail, __m128i *errors)
+{
+  const __m128i one = _mm_set1_epi8 (1);
+  const __m128i limit = _mm_set1_epi32 (DEC_LIMIT);
+  __m128i first, last, value;
+
+  head = dec_translate_128 (head);
+  tail = dec_translate_128 (tail);
+  *errors = _mm_or_si128 (_mm_cmpeq_epi8 (head, _mm_setzero_si128 ()),
+			  _mm_cmpeq_epi8 (tail, _mm_setzero_si128 ()));
+  head = _mm_sub_epi8 (head, one);
+  tail = _mm_sub_epi8 (tail, one);
+
+  first = _mm_or_si128
+    (_mm_shuffle_epi8 (head, _mm_loadu_si128 ((const __m128i *) dec_first_head)),
+     _mm_shuffle_epi8 (tail, _mm_loadu_si128 ((const __m128i *) dec_first_tail)));
+  last = _mm_shuffle_epi8 (tail, _mm_loadu_si128 ((const __m128i *) dec_last_tail));
+
+  first = _mm_maddubs_epi16 (first, _mm_set1_epi16 (0x0155));
+  first = _mm_madd_epi16 (first, _mm_set1_epi32 (0x00011c39));
+
+  *errors = _mm_or_si128
+    (*errors,
+     _mm_or_si128 (_mm_cmpgt_epi32 (first, limit),
+		   _mm_and_si128 (_mm_cmpeq_epi32 (first, limit),
+				  _mm_cmpgt_epi32 (last, _mm_setzero_si128 ()))));
+
+  value = _mm_add_epi32 (first, _mm_slli_epi32 (first, 2));
+  value = _mm_add_epi32 (_mm_add_epi32 (value, _mm_slli_epi32 (value, 4)),
+			 last);
+  return _mm_shuffle_epi8 (value, _mm_loadu_si128 ((const __m128i *) bswap32));
+}
+
+/* Decode as many 20-character (SSSE3) or 40-character (AVX2) blocks
+   of IN as fit, with room for their 16 or 32 bytes in OUTLEN, and stop
+   before the first one holding an error.  */
+__attribute__ ((target ("ssse3")))
+static size_t
+base85_decode_ssse3 (const char *in, size_t inlen, char *out, size_t outlen)
+{
+  size_t done = 0;
+
+  while (inlen - done >= 20 && outlen >= 16)
+    {
+      __m128i errors;
+      __m128i v = dec_groups_128
+	(_mm_loadu_si128 ((const __m128i *) (in + done)),
+	 _mm_loadu_si128 ((const __m128i *) (in + done + 4)), &errors);
+
+      if (_mm_movemask_epi8 (errors))
+	break;
+      _mm_storeu_si128 ((__m128i *) out, v);
+
+      done += 20;
+      out += 16;
+      outlen -= 16;
+    }
+
+  return done;
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+dec_translate_256 (__m256i in)
+{
+  const __m256i lo = _mm256_and_si256 (in, _mm256_set1_epi8 (0x0f));
+  const __m256i hi = _mm256_and_si256 (_mm256_srli_epi16 (in, 4),
+				       _mm256_set1_epi8 (0x0f));
+  __m256i digits = _mm256_setzero_si256 ();
+  int h;
+
+  for (h = 0; h < 6; h++)
+    {
+      const __m256i lut = _mm256_broadcastsi128_si256
+	(_mm_loadu_si128 ((const __m128i *) dec_digits[h]));
+      digits = _mm256_or_si256
+	(digits,
+	 _mm256_and_si256 (_mm256_cmpeq_epi8 (hi, _mm256_set1_epi8 (h + 2)),
+			   _mm256_shuffle_epi8 (lut, lo)));
+    }
+
+  return digits;
+}
+
+/* Same as dec_groups_128, on the 8 groups of a 40-character block
+   whose halves are in the lanes of HEAD and TAIL.  */
+__attribute__ ((target ("avx2")))
+static inline __m256i
+dec_groups_256 (__m256i head, __m256i tail, __m256i *errors)
+{
+# define BROADCAST(table) \
+  _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *) (table)))
+  const __m256i one = _mm256_set1_epi8 (1);
+  const __m256i limit = _mm256_set1_epi32 (DEC_LIMIT);
+  __m256i first, last, value;
+
+  head = dec_translate_256 (head);
+  tail = dec_translate_256 (tail);
+  *errors = _mm256_or_si256 (_mm256_cmpeq_epi8 (head, _mm256_setzero_si256 ()),
+			     _mm256_cmpeq_epi8 (tail, _mm256_setzero_si256 ()));
+  head = _mm256_sub_epi8 (head, one);
+  tail = _mm256_sub_epi8 (tail, one);
+
+  first = _mm256_or_si256 (_mm256_shuffle_epi8 (head, BROADCAST (dec_first_head)),
+			   _mm256_shuffle_epi8 (tail, BROADCAST (dec_first_tail)));
+  last = _mm256_shuffle_epi8 (tail, BROADCAST (dec_last_tail));
+
+  first = _mm256_maddubs_epi16 (first, _mm256_set1_epi16 (0x0155));
+  first = _mm256_madd_epi16 (first, _mm256_set1_epi32 (0x00011c39));
+
+  *errors = _mm256_or_si256
+    (*errors,
+     _mm256_or_si256 (_mm256_cmpgt_epi32 (first, limit),
+		      _mm256_and_si256 (_mm256_cmpeq_epi32 (first, limit),
+					_mm256_cmpgt_epi32 (last, _mm256_setzero_si256 ()))));
+
+  value = _mm256_add_epi32 (first, _mm256_slli_epi32 (first, 2));
+  value = _mm256_add_epi32 (_mm256_add_epi32 (value, _mm256_slli_epi32 (value, 4)),
+			    last);
+  return _mm256_shuffle_epi8 (value, BROADCAST (bswap32));
+# undef BROADCAST
+}
+
+__attribute__ ((target ("avx2")))
+static size_t
+base85_decode_avx2 (const char *in, size_t inlen, char *out, size_t outlen)
+{
+  size_t done = 0;
+
+  while (inlen - done >= 40 && outlen >= 32)
+    {
+      const char *block = in + done;
+      __m256i errors;
+      __m256i head = _mm256_inserti128_si256
+	(_mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *) block)),
+	 _mm_loadu_si128 ((const __m128i *) (block + 20)), 1);
+      __m256i tail = _mm256_inserti128_si256
+	(_mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *) (block + 4))),
+	 _mm_loadu_si128 ((const __m128i *) (block + 24)), 1);
+      __m256i v = dec_groups_256 (head, tail, &errors);
+
+      if (_mm256_movemask_epi8 (errors))
+	break;
+      _mm256_storeu_si256 ((__m256i *) out, v);
+
+      done += 40;
+      out += 32;
+      outlen -= 32;
+    }
+
+  return done + base85_decode_ssse3 (in + done, inlen - done, out, outlen);
+}
+
+#endif
+
+/* Kernels of the backend selected by base64_set_backend, which only
+   has vectorized ones for base85: the portable code does all the work
+   of the others.  */
+static size_t
+encode_kernel (const char *in, size_t inlen, char *out)
+{
+#if BASE64_HAVE_X86_KERNELS
+  switch (base64_get_backend ())
+    {
+    case BASE64_BACKEND_AVX2:
+      return base85_encode_avx2 (in, inlen, out);
+    case BASE64_BACKEND_SSSE3:
+      return base85_encode_ssse3 (in, inlen, out);
+    default:
+      break;
+    }
+#endif
+  (void) in;
+  (void) inlen;
+  (void) out;
+  return 0;
+}
+
+static size_t
+decode_kernel (const char *in, size_t inlen, char *out, size_t outlen)
+{
+#if BASE64_HAVE_X86_KERNELS
+  switch (base64_get_backend ())
+    {
+    case BASE64_BACKEND_AVX2:
+      return base85_decode_avx2 (in, inlen, out, outlen);
+    case BASE64_BACKEND_SSSE3:
+      return base85_decode_ssse3 (in, inlen, out, outlen);
+    default:
+      break;
+    }
+#endif
+  (void) in;
+  (void) inlen;
+  (void) out;
+  (void) outlen;
+  return 0;
+}
+
+/* Write the 5 digits of VALUE to OUT.  */
+static inline void
+encode_group (uint32_t value, char *out)
+{
+  int i;
+
+  for (i = 4; i >= 0; i--)
+    {
+      out[i] = z85[value % 85];
+      value /= 85;
+    }
+}
+
+/* Portable encoder, used for the bytes the vectorized kernels leave
+   over: see base85_encode below.  */
+static void
+base85_encode_scalar (const char *restrict in, size_t inlen,
+		      char *restrict out, size_t outlen)
+{
+  while (inlen >= 4 && outlen >= 5)
+    {
+      encode_group ((uint32_t) to_uchar (in[0]) << 24
+		    | (uint32_t) to_uchar (in[1]) << 16
+		    | (uint32_t) to_uchar (in[2]) << 8
+		    | to_uchar (in[3]), out);
+      in += 4;
+      inlen -= 4;
+      out += 5;
+      outlen -= 5;
+    }
+
+  /* A last group of less than 4 bytes, or one that OUT cuts.  */
+  if (inlen && outlen)
+    {
+      size_t n = inlen < 4 ? inlen : 4;
+      size_t len = n + 1 < outlen ? n + 1 : outlen;
+      unsigned char bytes[4] = { 0, 0, 0, 0 };
+      char group[5];
+
+      memcpy (bytes, in, n);
+      encode_group ((uint32_t) bytes[0] << 24 | (uint32_t) bytes[1] << 16
+		    | (uint32_t) bytes[2] << 8 | bytes[3], group);
+      memcpy (out, group, len);
+      out += len;
+      outlen -= len;
+    }
+
+  if (outlen)
+    *out = '\0';
+}
+
+/* Base85 encode IN array of size INLEN into OUT array of size OUTLEN.
+   If OUTLEN is less than BASE85_LENGTH(INLEN), write as many bytes as
+   possible.  If OUTLEN is larger than BASE85_LENGTH(INLEN), also zero
+   terminate the output buffer. */
+void
+base85_encode (const char *restrict in, size_t inlen,
+	       char *restrict out, size_t outlen)
+{
+  /* Only hand the kernel the whole groups that fit in OUT.  */
+  size_t room = outlen / 5 * 4;
+  size_t done = encode_kernel (in, inlen < room ? inlen : room, out);
+
+  base85_encode_scalar (in + done, inlen - done,
+			out + done / 4 * 5, outlen - done / 4 * 5);
+}
+
+/* Allocate a buffer and store zero terminated base85 encoded data
+   from array IN of size INLEN, returning BASE85_LENGTH(INLEN).  OUT
+   is set to NULL, and 0 returned, if the length would overflow, or
+   the size of the requested memory block returned if the allocation
+   failed, as base64_encode_alloc does.  */
+size_t
+base85_encode_alloc (const char *in, size_t inlen, char **out)
+{
+  size_t outlen;
+
+  if (inlen > ((size_t) -1 - 6) / 5 * 4)
+    {
+      *out = NULL;
+      return 0;
+    }
+
+  outlen = 1 + BASE85_LENGTH (inlen);
+  *out = malloc (outlen);
+  if (!*out)
+    return outlen;
+
+  base85_encode (in, inlen, *out, outlen);
+
+  return outlen - 1;
+}
+
+/* Value of the group of the N characters (2 to 5) of IN, padded with
+   the largest digit, in *VALUE.  Return false if a character is out
+   of the alphabet or the value does not fit in 32 bits.  */
+static bool
+decode_group (const char *in, size_t n, uint32_t *value)
+{
+  uint64_t v = 0;
+  size_t i;
+
+  for (i = 0; i < 5; i++)
+    {
+      int digit = i < n ? z85_digits[to_uchar (in[i])] : 84;
+
+      if (digit < 0)
+	return false;
+      v = v * 85 + digit;
+    }
+
+  if (v > UINT32_MAX)
+    return false;
+
+  *value = v;
+  return true;
+}
+
+/* Portable decoder, used for the blocks the vectorized kernels leave
+   over: see base85_decode below.  */
+static bool
+base85_decode_scalar (const char *restrict in, size_t inlen,
+		      char *restrict out, size_t *outlen)
+{
+  size_t outleft = *outlen;
+
+  while (inlen >= 2)
+    {
+      size_t n = inlen < 5 ? inlen : 5;
+      size_t bytes = n - 1;
+      uint32_t value;
+      char group[4];
+
+      if (!decode_group (in, n, &value))
+	break;
+
+      group[0] = value >> 24;
+      group[1] = value >> 16;
+      group[2] = value >> 8;
+      group[3] = value;
+      if (bytes > outleft)
+	bytes = outleft;
+      memcpy (out, group, bytes);
+      out += bytes;
+      outleft -= bytes;
+
+      in += n;
+      inlen -= n;
+    }
+
+  *outlen -= outleft;
+
+  return inlen == 0;
+}
+
+/* Decode base85 encoded input array IN of length INLEN to output
+   array OUT that can hold *OUTLEN bytes.  Return true if decoding was
+   successful, i.e. if the input was valid base85 data, false
+   otherwise.  If *OUTLEN is too small, as many bytes as possible will
+   be written to OUT.  On return, *OUTLEN holds the length of decoded
+   bytes in OUT.  */
+bool
+base85_decode (const char *restrict in, size_t inlen,
+	       char *restrict out, size_t *outlen)
+{
+  /* The kernel stops before the first block holding an error, which
+     the portable loop then reports.  */
+  size_t done = decode_kernel (in, inlen, out, *outlen);
+  size_t written = done / 5 * 4;
+  size_t left = *outlen - written;
+  bool ok = base85_decode_scalar (in + done, inlen - done,
+				  out + written, &left);
+
+  *outlen = written + left;
+  return ok;
+}
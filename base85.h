@@ -0,0 +1,72 @@
+/* base85.h -- Encode binary data with the Z85 alphabet.
+
+   Z85 (ZeroMQ RFC 32) encodes every 4 bytes, read as a big-endian
+   32-bit number, as its 5 digits in base 85, most significant first,
+   which takes 25% more room than the data instead of the 33% of
+   base64.  Its alphabet leaves out the quotes and the backslash, so
+   that the encoded data can be pasted in a C or JSON string; it keeps
+   '<', '>' and '&', which must be escaped in XML.
+
+   Z85 itself only encodes whole groups.  As in Ascii85, a last group
+   of N bytes (1 to 3) is encoded as if padded with zeros, and only
+   its first N + 1 digits are written; the decoder pads such a group
+   with the largest digit.  A last group of a single character cannot
+   be decoded.  No padding character is ever written.
+
+   The functions follow the backend selected by base64_set_backend:
+   the SSSE3 and AVX2 ones encode and decode 4 or 8 groups at once,
+   the others a group at a time.  */
+
+#ifndef BASE85_H
+# define BASE85_H
+
+/* Get size_t. */
+# include <stddef.h>
+
+/* Get bool. */
+# include <stdbool.h>
+
+/* Number of characters encoding INLEN bytes.  */
+# define BASE85_LENGTH(inlen) \
+  ((inlen) / 4 * 5 + ((inlen) % 4 ? (inlen) % 4 + 1 : 0))
+
+/* Number of bytes decoded from INLEN characters, unless INLEN % 5 is
+   1, which base85_decode rejects.  */
+# define BASE85_DECODED_LENGTH(inlen) \
+  ((inlen) / 5 * 4 + ((inlen) % 5 ? (inlen) % 5 - 1 : 0))
+
+#ifndef RESTRICT
+#define RESTRICT restrict
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+extern bool isbase85 (char ch);
+
+/* Same as base64_encode: if OUTLEN is less than BASE85_LENGTH (INLEN),
+   write as many characters as possible; if it is larger, also zero
+   terminate the output.  */
+extern void base85_encode (const char *RESTRICT in, size_t inlen,
+			   char *RESTRICT out, size_t outlen);
+
+/* Same as base64_encode_alloc, returning BASE85_LENGTH (INLEN).  */
+extern size_t base85_encode_alloc (const char *in, size_t inlen, char **out);
+
+/* Same as base64_decode: decode the INLEN characters of IN to the
+   *OUTLEN bytes of OUT, store the number of bytes written in *OUTLEN,
+   and return false if IN holds a character out of the alphabet, a
+   group whose value does not fit in 32 bits, or ends with a single
+   character.  */
+extern bool base85_decode (const char *RESTRICT in, size_t inlen,
+			   char *RESTRICT out, size_t *outlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef RESTRICT
+
+#endif /* BASE85_H */
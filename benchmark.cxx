@@ -6,20 +6,23 @@
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/serialization/vector.hpp>
 
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
-#include <chrono>
+#include <memory>
+#include <memory_resource>
 #include <random>
+#include <sstream>
+#include <thread>
 #include <type_traits>
 
+#include "base64_alphabet.hxx"
+#include "base64_archive.hxx"
+#include "harness.hxx"
 #include "impl.hxx"
-
-using namespace std::chrono;
-
-template<typename T = milliseconds>
-unsigned long elapsed(const steady_clock::time_point& begin,
-                      const steady_clock::time_point& end) {
-  return duration_cast<T>(end - begin).count();
-}
+#include "thread_pool.hxx"
 
 template<typename T, typename std::enable_if<std::is_integral<T>::value, T>::type* = nullptr>
 std::vector<T> random_vector(size_t size) {
@@ -41,137 +44,589 @@ std::vector<T> random_vector(size_t size) {
   return data;
 }
 
-template<typename OArchive, typename IArchive, typename T>
-void benchmark_boost_archive(const std::vector<T>& in) {
-  std::stringstream ss;
+// Signal sampled from a sensor: slow sines with a little noise, around the
+// middle of the range of integral types.
+template<typename T>
+std::vector<T> smooth_vector(size_t size) {
+  const bool floating = std::is_floating_point<T>::value;
+  const double center = floating ? 0 : (double(std::numeric_limits<T>::lowest()) + std::numeric_limits<T>::max()) / 2;
+  const double amplitude = floating ? 1 : std::min<double>(std::numeric_limits<T>::max() / 4, 1000);
+  std::normal_distribution<double> noise(0, 0.01);
+  std::default_random_engine generator;
 
-  auto t0 = steady_clock::now();
+  std::vector<T> data(size);
+  for(size_t i = 0; i < size; ++i)
+    data[i] = static_cast<T>(center + amplitude * (0.6 * std::sin(i * 2e-3) + 0.3 * std::sin(i * 1.7e-2) + noise(generator)));
+  return data;
+}
 
-  OArchive oa(ss);
-  oa << boost::serialization::make_nvp("data", in);
+template<typename T> const char* type_name();
+template<> const char* type_name<char>() { return "char"; }
+template<> const char* type_name<unsigned short>() { return "short"; }
+template<> const char* type_name<int>() { return "int"; }
+template<> const char* type_name<long>() { return "long"; }
+template<> const char* type_name<float>() { return "float"; }
+template<> const char* type_name<double>() { return "double"; }
+
+size_t encoded_length(const std::string& encoded) { return encoded.size(); }
+size_t encoded_length(const std::vector<char>& encoded) { return encoded.size(); }
+size_t encoded_length(const std::unique_ptr<char, free_deleter<char>>& encoded) { return strlen(encoded.get()); }
+size_t encoded_length(const std::unique_ptr<std::stringstream>& encoded) { return encoded->tellp(); }
+size_t encoded_length(const base64_batch& encoded) { return encoded.offsets.back(); }
+size_t encoded_length(const std::vector<std::unique_ptr<char, free_deleter<char>>>& encoded) {
+  size_t length = 0;
+  for(const auto& e : encoded)
+    length += strlen(e.get());
+  return length;
+}
 
-  auto t1 = steady_clock::now();
+// Checks that decode(encode()) gives back in, then measures both phases
+// separately, the decoding always working on the same encoded data.
+template<typename T, typename Encode, typename Decode>
+void benchmark_codec(const options& opts, report& results,
+                     const std::string& codec, size_t threads, const std::vector<T>& in,
+                     Encode encode, Decode decode) {
+  if (!opts.selected(codec, type_name<T>(), threads))
+    return;
 
-  std::vector<T> out;
-  IArchive ia(ss);
-  ia >> boost::serialization::make_nvp("data", out);
+  auto encoded = encode();
+  if (decode(encoded) != in) throw std::runtime_error("Mismatch in " + codec);
 
-  auto t2 = steady_clock::now();
+  measurement m{codec, type_name<T>(), "encode", threads, in.size() * sizeof(T), encoded_length(encoded), {}};
 
-  if (in != out) throw std::runtime_error("Mismatch");
+  m.samples = measure(opts, encode);
+  results.add(m);
 
-  std::cout << __PRETTY_FUNCTION__ << std::endl;
-  std::cout << "Content size: " << ss.tellp() << std::endl;
-  std::cout << "Write time: " << elapsed(t0, t1) << std::endl;
-  std::cout << "Read time : " << elapsed(t1, t2) << std::endl;
+  m.phase = "decode";
+  m.samples = measure(opts, [&]() { return decode(encoded); });
+  results.add(m);
 }
 
-template<typename T>
-void benchmark_boost_archive() {
-  const std::vector<T> in = random_vector<T>(1000000);
-  benchmark_boost_archive<boost::archive::binary_oarchive, boost::archive::binary_iarchive, T>(in);
-  benchmark_boost_archive<boost::archive::text_oarchive, boost::archive::text_iarchive, T>(in);
-  benchmark_boost_archive<boost::archive::xml_oarchive, boost::archive::xml_iarchive, T>(in);
+// Same as benchmark_codec, encode taking the input. With --concurrent, the
+// codec is then also measured on that many threads at once, each encoding
+// its own copy of in and decoding its own copy of the encoded data, so that
+// the threads only share the allocator and the memory bandwidth.
+template<typename T, typename Encode, typename Decode>
+void benchmark_concurrent_codec(const options& opts, report& results,
+                                const std::string& codec, const std::vector<T>& in,
+                                Encode encode, Decode decode) {
+  benchmark_codec(opts, results, codec, 1, in, [&]() { return encode(in); }, decode);
+
+  for(size_t threads : opts.concurrent) {
+    // A single thread is the run above.
+    if (threads < 2 || !opts.selected(codec, type_name<T>(), threads))
+      continue;
+
+    thread_pool pool(threads);
+    const std::vector<std::vector<T>> inputs(threads, in);
+    std::vector<decltype(encode(in))> encoded;
+    for(const std::vector<T>& input : inputs)
+      encoded.push_back(encode(input));
+
+    measurement m{codec, type_name<T>(), "encode", threads, in.size() * sizeof(T), encoded_length(encoded[0]), {}};
+    m.concurrent = true;
+
+    m.samples = measure_concurrent(opts, pool, [&](size_t thread) { return encode(inputs[thread]); });
+    results.add(m);
+
+    m.phase = "decode";
+    m.samples = measure_concurrent(opts, pool, [&](size_t thread) { return decode(encoded[thread]); });
+    results.add(m);
+  }
 }
 
-void benchmark_boost_archive() {
-  benchmark_boost_archive<char>();
-  benchmark_boost_archive<unsigned short>();
-  benchmark_boost_archive<int>();
-  benchmark_boost_archive<long>();
-  benchmark_boost_archive<float>();
-  benchmark_boost_archive<double>();
+template<typename OArchive, typename IArchive, typename T>
+void benchmark_boost_archive(const options& opts, report& results, const std::string& codec, const std::vector<T>& in) {
+  benchmark_concurrent_codec(opts, results, codec, in,
+    [](const std::vector<T>& in) {
+      std::unique_ptr<std::stringstream> ss(new std::stringstream);
+      {
+        OArchive oa(*ss);
+        oa << boost::serialization::make_nvp("data", in);
+      }
+      return ss;
+    },
+    [](std::unique_ptr<std::stringstream>& ss) {
+      ss->clear();
+      ss->seekg(0);
+      std::vector<T> out;
+      IArchive ia(*ss);
+      ia >> boost::serialization::make_nvp("data", out);
+      return out;
+    });
 }
 
 template<typename T>
-void benchmark_base64_boost_raw(const std::vector<T> &in) {
-  auto t0 = steady_clock::now();
-
-  auto encoded = encode_base64(in);
+void benchmark_boost_archive(const options& opts, report& results, const std::vector<T>& in) {
+  benchmark_boost_archive<boost::archive::binary_oarchive, boost::archive::binary_iarchive>(opts, results, "binary_archive", in);
+  benchmark_boost_archive<boost::archive::text_oarchive, boost::archive::text_iarchive>(opts, results, "text_archive", in);
+  benchmark_boost_archive<boost::archive::xml_oarchive, boost::archive::xml_iarchive>(opts, results, "xml_archive", in);
+  benchmark_boost_archive<base64_text_oarchive, base64_text_iarchive>(opts, results, "text_archive_base64", in);
+  benchmark_boost_archive<base64_xml_oarchive, base64_xml_iarchive>(opts, results, "xml_archive_base64", in);
+}
 
-  auto t1 = steady_clock::now();
+template<typename T>
+void benchmark_base64_boost_raw(const options& opts, report& results, const std::vector<T> &in) {
+  benchmark_concurrent_codec(opts, results, "boost_raw", in,
+    [](const std::vector<T>& in) { return encode_base64(in); },
+    [](const std::string& encoded) { return decode_base64<T>(encoded); });
+}
 
-  auto decoded = decode_base64<T>(encoded);
+template<typename T, typename std::enable_if<std::is_integral<T>::value, T>::type* = nullptr>
+void benchmark_base64_boost_typed(const options& opts, report& results, const std::vector<T> &in) {
+  benchmark_concurrent_codec(opts, results, "boost_typed", in,
+    [](const std::vector<T>& in) { return encode_base64_2(in); },
+    [](const std::string& encoded) { return decode_base64_2<T>(encoded); });
+}
 
-  auto t2 = steady_clock::now();
+// Boost's typed encoding does not work on floating types.
+template<typename T, typename std::enable_if<std::is_floating_point<T>::value, T>::type* = nullptr>
+void benchmark_base64_boost_typed(const options&, report&, const std::vector<T>&) {}
 
-  if (in != decoded) throw std::runtime_error("Mismatch");
+template<typename T>
+void benchmark_base64_rfc(const options& opts, report& results, const std::vector<T> &in) {
+  benchmark_concurrent_codec(opts, results, "rfc", in,
+    [](const std::vector<T>& in) { return encode_base64_rfc(in); },
+    [](const std::unique_ptr<char, free_deleter<char>>& encoded) {
+      return decode_base64_rfc<T>(encoded.get(), strlen(encoded.get()));
+    });
+}
 
-  std::cout << __PRETTY_FUNCTION__ << std::endl;
-  std::cout << "Content size: " << encoded.size() << std::endl;
-  std::cout << "Write time: " << elapsed(t0, t1) << std::endl;
-  std::cout << "Read time : " << elapsed(t1, t2) << std::endl;
+// Shuffled, deflated then encoded data, on the random data ("rfc_deflate")
+// and on a smooth signal ("rfc_deflate_smooth"), to be compared with the
+// plain encoding of the same signal ("rfc_smooth").
+template<typename T>
+void benchmark_base64_rfc_deflate(const options& opts, report& results, const std::vector<T> &in,
+                                  const std::vector<T> &smooth) {
+  auto decode = [](const std::string& encoded) { return decode_base64_deflate<T>(encoded); };
+
+  benchmark_codec(opts, results, "rfc_deflate", 1, in, [&]() { return encode_base64_deflate(in); }, decode);
+  benchmark_codec(opts, results, "rfc_smooth", 1, smooth,
+    [&]() { return encode_base64_rfc(smooth); },
+    [](const std::unique_ptr<char, free_deleter<char>>& encoded) {
+      return decode_base64_rfc<T>(encoded.get(), strlen(encoded.get()));
+    });
+  benchmark_codec(opts, results, "rfc_deflate_smooth", 1, smooth, [&]() { return encode_base64_deflate(smooth); }, decode);
 }
 
+// The RFC codec forced on the portable backends ("rfc_scalar", the original
+// byte-at-a-time loop, and "rfc_swar"), whatever the processor supports.
 template<typename T>
-void benchmark_base64_boost_typed(const std::vector<T> &in) {
-  auto t0 = steady_clock::now();
+void benchmark_base64_rfc_portable(const options& opts, report& results, const std::vector<T> &in) {
+  const base64_backend active = base64_get_backend();
+
+  for(base64_backend backend : {BASE64_BACKEND_SCALAR, BASE64_BACKEND_SWAR}) {
+    base64_set_backend(backend);
+    benchmark_codec(opts, results, std::string("rfc_") + base64_backend_name(backend), 1, in,
+      [&]() { return encode_base64_rfc(in); },
+      [](const std::unique_ptr<char, free_deleter<char>>& encoded) {
+        return decode_base64_rfc<T>(encoded.get(), strlen(encoded.get()));
+      });
+  }
+
+  base64_set_backend(active);
+}
 
-  auto encoded = encode_base64_2(in);
+// Z85 encoding ("base85"), 25% larger than the data instead of 33%, and the
+// same on the portable code alone ("base85_scalar").
+template<typename T>
+void benchmark_base85(const options& opts, report& results, const std::vector<T> &in) {
+  auto decode = [](const std::unique_ptr<char, free_deleter<char>>& encoded) {
+    return decode_base85<T>(encoded.get(), strlen(encoded.get()));
+  };
+
+  benchmark_concurrent_codec(opts, results, "base85", in,
+    [](const std::vector<T>& in) { return encode_base85(in); }, decode);
+
+  const base64_backend active = base64_get_backend();
+  base64_set_backend(BASE64_BACKEND_SCALAR);
+  benchmark_codec(opts, results, "base85_scalar", 1, in, [&]() { return encode_base85(in); }, decode);
+  base64_set_backend(active);
+}
 
-  auto t1 = steady_clock::now();
+// In-place decoding, which only exists for bytes. The copy of the encoded
+// data stands for the buffer it would have been received in, and is part of
+// the measure as the output allocation is part of the one of "rfc".
+template<typename T, typename std::enable_if<std::is_same<T, char>::value, T>::type* = nullptr>
+void benchmark_base64_rfc_inplace(const options& opts, report& results, const std::vector<T> &in) {
+  benchmark_codec(opts, results, "rfc_inplace", 1, in,
+    [&]() {
+      std::vector<char> encoded(encoded_size_base64<char>(in.size()));
+      encode_base64_rfc_into(in.data(), in.size(), encoded.data(), encoded.size());
+      return encoded;
+    },
+    [](const std::vector<char>& encoded) { return decode_base64_rfc_inplace(std::vector<char>(encoded)); });
+}
 
-  auto decoded = decode_base64_2<T>(encoded);
+template<typename T, typename std::enable_if<!std::is_same<T, char>::value, T>::type* = nullptr>
+void benchmark_base64_rfc_inplace(const options&, report&, const std::vector<T>&) {}
 
-  auto t2 = steady_clock::now();
+template<typename T>
+void benchmark_base64_rfc_be(const options& opts, report& results, const std::vector<T> &in) {
+  benchmark_codec(opts, results, "rfc_be", 1, in,
+    [&]() { return encode_base64_rfc_be(in); },
+    [](const std::unique_ptr<char, free_deleter<char>>& encoded) {
+      return decode_base64_rfc_be<T>(encoded.get(), strlen(encoded.get()));
+    });
+}
 
-  if (in != decoded) throw std::runtime_error("Mismatch");
+// MIME encoding: lines of 76 characters ended by CRLF.
+template<typename T>
+void benchmark_base64_rfc_mime(const options& opts, report& results, const std::vector<T> &in) {
+  benchmark_codec(opts, results, "rfc_mime", 1, in,
+    [&]() { return encode_base64_rfc_wrapped(in); },
+    [](const std::unique_ptr<char, free_deleter<char>>& encoded) {
+      return decode_base64_rfc_wrapped<T>(encoded.get(), strlen(encoded.get()));
+    });
+}
 
-  std::cout << __PRETTY_FUNCTION__ << std::endl;
-  std::cout << "Content size: " << encoded.size() << std::endl;
-  std::cout << "Write time: " << elapsed(t0, t1) << std::endl;
-  std::cout << "Read time : " << elapsed(t1, t2) << std::endl;
+template<typename T>
+void benchmark_base64_rfc_url(const options& opts, report& results, const std::vector<T> &in) {
+  benchmark_codec(opts, results, "rfc_url", 1, in,
+    [&]() { return encode_base64_with<base64_url_alphabet, base64_unpadded>(in); },
+    [](const std::string& encoded) { return decode_base64_with<T, base64_url_alphabet, base64_unpadded>(encoded); });
 }
 
 template<typename T>
-void benchmark_base64_rfc(const std::vector<T> &in) {
-  auto t0 = steady_clock::now();
+void benchmark_base64_rfc_stream(const options& opts, report& results, const std::vector<T> &in, size_t chunk = 65536) {
+  const char* data = reinterpret_cast<const char*>(in.data());
+  const size_t size = in.size() * sizeof(T);
+
+  benchmark_codec(opts, results, "rfc_stream", 1, in,
+    [&]() {
+      base64_encoder encoder;
+      std::string encoded(encoded_size_base64<T>(in.size()), '\0');
+      size_t written = 0;
+      for(size_t i = 0; i < size; i += chunk)
+        written += encoder.update(data + i, std::min(chunk, size - i), &encoded[written]);
+      encoder.finish(&encoded[written]);
+      return encoded;
+    },
+    [&](const std::string& encoded) {
+      base64_decoder decoder;
+      // update() needs room for the bytes the padding stands for.
+      std::vector<T> decoded((decoder.update_size(encoded.size()) + sizeof(T) - 1) / sizeof(T));
+      char* out = reinterpret_cast<char*>(decoded.data());
+      for(size_t i = 0; i < encoded.size(); i += chunk)
+        out += decoder.update(encoded.data() + i, std::min(chunk, encoded.size() - i), out);
+      decoder.finish();
+      decoded.resize(in.size());
+      return decoded;
+    });
+}
 
-  auto encoded = encode_base64_rfc(in);
+// Many short messages: the input is cut in fields of 16 to 200 bytes, as in
+// a request.
+struct fields
+{
+  explicit fields(const std::vector<char>& in) {
+    std::uniform_int_distribution<size_t> distribution(16, 200);
+    std::default_random_engine generator;
+    for(size_t at = 0; at < in.size(); at += sizes.back()) {
+      data.push_back(in.data() + at);
+      sizes.push_back(std::min(distribution(generator), in.size() - at));
+    }
+  }
+
+  size_t count() const { return data.size(); }
+
+  std::vector<const char*> data;
+  std::vector<size_t> sizes;
+};
+
+// Fields encoded in a request-scoped arena, which frees them all at once.
+struct arena_fields
+{
+  explicit arena_fields(size_t size) : arena(new std::pmr::monotonic_buffer_resource(size)) {}
 
-  auto t1 = steady_clock::now();
+  std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+  std::vector<std::pmr::string> encoded;
+};
 
-  auto decoded = decode_base64_rfc<T>(encoded.get(), strlen(encoded.get()));
+size_t encoded_length(const arena_fields& encoded) {
+  size_t length = 0;
+  for(const auto& e : encoded.encoded)
+    length += e.size();
+  return length;
+}
 
-  auto t2 = steady_clock::now();
+// The fields encoded and decoded one by one with the default heap
+// ("rfc_fields") or with a monotonic arena ("rfc_fields_arena"), or all
+// at once ("rfc_batch"). The decoders gather the fields back into one
+// vector.
+void benchmark_base64_rfc_batch(const options& opts, report& results, const std::vector<char>& in) {
+  const fields f(in);
+
+  benchmark_codec(opts, results, "rfc_fields", 1, in,
+    [&]() {
+      std::vector<std::unique_ptr<char, free_deleter<char>>> encoded;
+      encoded.reserve(f.count());
+      for(size_t i = 0; i < f.count(); ++i)
+        encoded.push_back(encode_base64_rfc(f.data[i], f.sizes[i]));
+      return encoded;
+    },
+    [&](const std::vector<std::unique_ptr<char, free_deleter<char>>>& encoded) {
+      std::vector<char> out;
+      out.reserve(in.size());
+      for(const auto& e : encoded) {
+        const std::vector<char> field = decode_base64_rfc<char>(e.get(), strlen(e.get()));
+        out.insert(out.end(), field.begin(), field.end());
+      }
+      return out;
+    });
+
+  // The arenas start with room for the whole request.
+  benchmark_codec(opts, results, "rfc_fields_arena", 1, in,
+    [&]() {
+      arena_fields encoded(encoded_size_base64<char>(in.size()) + f.count() * 16);
+      encoded.encoded.reserve(f.count());
+      for(size_t i = 0; i < f.count(); ++i)
+        encoded.encoded.push_back(encode_base64_rfc(f.data[i], f.sizes[i], encoded.arena.get()));
+      return encoded;
+    },
+    [&](const arena_fields& encoded) {
+      std::pmr::monotonic_buffer_resource arena(in.size() + f.count() * 16);
+      std::vector<char> out;
+      out.reserve(in.size());
+      for(const auto& e : encoded.encoded) {
+        const std::pmr::vector<char> field = decode_base64_rfc<char>(e, &arena);
+        out.insert(out.end(), field.begin(), field.end());
+      }
+      return out;
+    });
+
+  benchmark_codec(opts, results, "rfc_batch", 1, in,
+    [&]() { return encode_base64_rfc_batch(f.data.data(), f.sizes.data(), f.count()); },
+    [&](const base64_batch& encoded) {
+      const base64_batch decoded = decode_base64_rfc_batch(encoded);
+      return std::vector<char>(decoded.buffer.get(), decoded.buffer.get() + decoded.offsets.back());
+    });
+}
 
-  if (in != decoded) throw std::runtime_error("Mismatch");
+// The fields are bytes.
+template<typename T>
+void benchmark_base64_rfc_batch(const options&, report&, const std::vector<T>&) {}
 
-  std::cout << __PRETTY_FUNCTION__ << std::endl;
-  std::cout << "Content size: " << strlen(encoded.get()) << std::endl;
-  std::cout << "Write time: " << elapsed(t0, t1) << std::endl;
-  std::cout << "Read time : " << elapsed(t1, t2) << std::endl;
+// Fields of a request, of which a fraction is made invalid by a character
+// out of the alphabet at a random position.
+struct mixed_fields
+{
+  mixed_fields(const fields& f, double invalid) {
+    std::default_random_engine generator;
+    std::bernoulli_distribution corrupt(invalid);
+    for(size_t i = 0; i < f.count(); ++i) {
+      encoded.emplace_back(encode_base64_rfc(f.data[i], f.sizes[i]).get());
+      if (corrupt(generator)) {
+        std::uniform_int_distribution<size_t> at(0, encoded.back().size() - 1);
+        encoded.back()[at(generator)] = '!';
+        ++rejected;
+      }
+      encoded_bytes += encoded.back().size();
+    }
+  }
+
+  std::vector<std::string> encoded;
+  size_t rejected = 0;
+  size_t encoded_bytes = 0;
+};
+
+// Decodes every field with decode(field, decoded), which adds the size of
+// the field to decoded and returns true if it is valid. The fraction of
+// invalid fields is part of the name of the codec in the report.
+template<typename Decode>
+void benchmark_mixed_fields(const options& opts, report& results, const std::string& codec,
+                            const std::vector<char>& in, const mixed_fields& mixed, double invalid,
+                            Decode decode) {
+  if (!opts.selected(codec, type_name<char>(), 1))
+    return;
+
+  auto run = [&]() {
+    size_t decoded = 0, rejected = 0;
+    for(const std::string& field : mixed.encoded)
+      if (!decode(field, decoded))
+        ++rejected;
+    return std::make_pair(decoded, rejected);
+  };
+  if (run().second != mixed.rejected)
+    throw std::runtime_error("Mismatch in " + codec);
+
+  std::ostringstream name;
+  name << codec << '@' << std::lround(invalid * 100) << '%';
+  measurement m{name.str(), type_name<char>(), "decode", 1, in.size(), mixed.encoded_bytes, {}};
+  m.samples = measure(opts, run);
+  results.add(m);
 }
 
-template<typename T, typename std::enable_if<std::is_integral<T>::value, T>::type* = nullptr>
-void benchmark_base64() {
-  const std::vector<T> in = random_vector<T>(1000000);
-  benchmark_base64_boost_raw(in);
-  benchmark_base64_boost_typed(in);
-  benchmark_base64_rfc(in);
+// The three decoder families on the fields, throwing on the invalid ones
+// ("throw_raw", "throw_typed", "throw_rfc") or returning the error
+// ("try_raw", "try_typed", "try_rfc"), for each fraction of invalid fields.
+void benchmark_base64_rejects(const options& opts, report& results, const std::vector<char>& in) {
+  const fields f(in);
+
+  for(double invalid : opts.invalid) {
+    const mixed_fields mixed(f, invalid);
+
+    benchmark_mixed_fields(opts, results, "throw_raw", in, mixed, invalid,
+      [](const std::string& field, size_t& decoded) {
+        try {
+          decoded += decode_base64<char>(field).size();
+          return true;
+        } catch (const std::exception&) {
+          return false;
+        }
+      });
+    benchmark_mixed_fields(opts, results, "try_raw", in, mixed, invalid,
+      [](const std::string& field, size_t& decoded) {
+        const base64_result<std::vector<char>> r = try_decode_base64<char>(field);
+        decoded += r.value.size();
+        return r.has_value();
+      });
+
+    benchmark_mixed_fields(opts, results, "throw_typed", in, mixed, invalid,
+      [](const std::string& field, size_t& decoded) {
+        try {
+          decoded += decode_base64_2<char>(field).size();
+          return true;
+        } catch (const std::exception&) {
+          return false;
+        }
+      });
+    benchmark_mixed_fields(opts, results, "try_typed", in, mixed, invalid,
+      [](const std::string& field, size_t& decoded) {
+        const base64_result<std::vector<char>> r = try_decode_base64_2<char>(field);
+        decoded += r.value.size();
+        return r.has_value();
+      });
+
+    benchmark_mixed_fields(opts, results, "throw_rfc", in, mixed, invalid,
+      [](const std::string& field, size_t& decoded) {
+        try {
+          decoded += decode_base64_rfc<char>(field).size();
+          return true;
+        } catch (const std::exception&) {
+          return false;
+        }
+      });
+    benchmark_mixed_fields(opts, results, "try_rfc", in, mixed, invalid,
+      [](const std::string& field, size_t& decoded) {
+        const base64_result<std::vector<char>> r = try_decode_base64_rfc<char>(field);
+        decoded += r.value.size();
+        return r.has_value();
+      });
+  }
 }
 
-template<typename T, typename std::enable_if<std::is_floating_point<T>::value, T>::type* = nullptr>
-void benchmark_base64() {
-  const std::vector<T> in = random_vector<T>(1000000);
-  benchmark_base64_boost_raw(in);
-  benchmark_base64_rfc(in);
+// The fields are bytes.
+template<typename T>
+void benchmark_base64_rejects(const options&, report&, const std::vector<T>&) {}
+
+// Thread counts of the sweep: powers of two up to the hardware concurrency,
+// which is always included.
+std::vector<size_t> thread_counts() {
+  const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<size_t> counts;
+  for(size_t threads = 1; threads < max_threads; threads *= 2)
+    counts.push_back(threads);
+  counts.push_back(max_threads);
+  return counts;
+}
+
+template<typename T>
+void benchmark_base64_rfc_parallel(const options& opts, report& results, const std::vector<T> &in) {
+  for(size_t threads : opts.threads.empty() ? thread_counts() : opts.threads) {
+    thread_pool pool(threads);
+
+    benchmark_codec(opts, results, "rfc_parallel", threads, in,
+      [&]() { return encode_base64_rfc_parallel(in, pool, 0); },
+      [&](const std::unique_ptr<char, free_deleter<char>>& encoded) {
+        return decode_base64_rfc_parallel<T>(encoded.get(), strlen(encoded.get()), pool, 0);
+      });
+  }
 }
 
-void benchmark_base64() {
-  benchmark_base64<char>();
-  benchmark_base64<unsigned short>();
-  benchmark_base64<int>();
-  benchmark_base64<long>();
-  benchmark_base64<float>();
-  benchmark_base64<double>();
+// Asset embedded in the program, of the size of a certificate, and its
+// base64 literal, encoded then decoded back while compiling.
+constexpr std::array<uint8_t, 2048> make_asset() {
+  std::array<uint8_t, 2048> asset{};
+  uint32_t state = 1;
+  for(uint8_t& byte : asset) {
+    state = state * 1103515245 + 12345;
+    byte = static_cast<uint8_t>(state >> 16);
+  }
+  return asset;
+}
+
+constexpr std::array<uint8_t, 2048> asset = make_asset();
+constexpr auto asset_base64 = base64_encode_array(asset);
+constexpr auto asset_decoded = base64_decode_array<asset.size()>(asset_base64.data(), asset_base64.size() - 1);
+
+// Startup cost of the asset: decoded from its literal at run time by
+// decode_base64_rfc ("embedded_rfc"), or at compile time, which only leaves
+// copying the result ("embedded_constexpr"). The sizes are not swept.
+void benchmark_embedded(const options& opts, report& results) {
+  const std::vector<char> in(asset.begin(), asset.end());
+
+  benchmark_codec(opts, results, "embedded_rfc", 1, in,
+    []() { return encode_base64_rfc(reinterpret_cast<const char*>(asset.data()), asset.size()); },
+    [](const std::unique_ptr<char, free_deleter<char>>&) {
+      return decode_base64_rfc<char>(asset_base64.data(), asset_base64.size() - 1);
+    });
+  benchmark_codec(opts, results, "embedded_constexpr", 1, in,
+    []() { return std::string(asset_base64.data(), asset_base64.size() - 1); },
+    [](const std::string&) { return std::vector<char>(asset_decoded.begin(), asset_decoded.end()); });
+}
+
+template<typename T>
+void benchmark(const options& opts, report& results) {
+  if (!opts.types.empty() && std::find(opts.types.begin(), opts.types.end(), type_name<T>()) == opts.types.end())
+    return;
+
+  // Smaller inputs are prefixes of the largest one.
+  const std::vector<size_t> sizes = opts.plain_sizes();
+  const size_t largest = std::max<size_t>(1, *std::max_element(sizes.begin(), sizes.end()) / sizeof(T));
+  const std::vector<T> data = random_vector<T>(largest);
+  const std::vector<T> signal = smooth_vector<T>(largest);
+
+  for(size_t size : sizes) {
+    const std::vector<T> in(data.begin(), data.begin() + std::max<size_t>(1, size / sizeof(T)));
+    const std::vector<T> smooth(signal.begin(), signal.begin() + in.size());
+
+    benchmark_boost_archive(opts, results, in);
+    benchmark_base64_boost_raw(opts, results, in);
+    benchmark_base64_boost_typed(opts, results, in);
+    benchmark_base64_rfc(opts, results, in);
+    benchmark_base64_rfc_portable(opts, results, in);
+    benchmark_base85(opts, results, in);
+    benchmark_base64_rfc_inplace(opts, results, in);
+    benchmark_base64_rfc_be(opts, results, in);
+    benchmark_base64_rfc_mime(opts, results, in);
+    benchmark_base64_rfc_url(opts, results, in);
+    benchmark_base64_rfc_stream(opts, results, in);
+    benchmark_base64_rfc_batch(opts, results, in);
+    benchmark_base64_rejects(opts, results, in);
+    benchmark_base64_rfc_parallel(opts, results, in);
+    benchmark_base64_rfc_deflate(opts, results, in, smooth);
+  }
 }
 
 int main(int argc, char** argv)
 {
-  benchmark_boost_archive();
-
-  benchmark_base64();
+  const options opts = parse_options(argc, argv);
+  report results(opts);
+
+  benchmark_embedded(opts, results);
+
+  benchmark<char>(opts, results);
+  benchmark<unsigned short>(opts, results);
+  benchmark<int>(opts, results);
+  benchmark<long>(opts, results);
+  benchmark<float>(opts, results);
+  benchmark<double>(opts, results);
+
+  if (!opts.json.empty())
+    results.write_json(opts.json);
+  if (!opts.csv.empty())
+    results.write_csv(opts.csv);
 
   return 0;
 }
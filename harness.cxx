@@ -0,0 +1,567 @@
+#include "harness.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define RESTRICT
+#include "base64.h"
+
+static void usage(const char* program)
+{
+  std::cout << "Usage: " << program << " [options]\n"
+            << "\n"
+            << "  --codec=NAME[,NAME...]   only run these codecs\n"
+            << "  --type=NAME[,NAME...]    only use these element types\n"
+            << "  --threads=N[,N...]       only use these thread counts\n"
+            << "  --concurrent=N[,N...]    also run the codecs on N threads at once, each on\n"
+            << "                           its own buffers\n"
+            << "  --sizes=N[,N...]         plain data sizes, in bytes\n"
+            << "  --invalid=R[,R...]       fractions of invalid fields decoded by the throw_*\n"
+            << "                           and try_* codecs (default 0,0.33)\n"
+            << "  --min-size=N             smallest size of the sweep (default 16)\n"
+            << "  --max-size=N             largest size of the sweep (default 1073741824)\n"
+            << "  --size-factor=N          ratio between two sizes of the sweep (default 4)\n"
+            << "  --warmup=N               untimed runs before measuring (default 2)\n"
+            << "  --repetitions=N          timed samples (default 10)\n"
+            << "  --sample-time=US         shortest sample, in microseconds (default 200)\n"
+            << "  --time-budget=MS         time after which no more samples are taken,\n"
+            << "                           in milliseconds (default 2000)\n"
+            << "  --counters               count cycles, instructions, branch and cache misses\n"
+            << "                           with perf_event_open, and report them per byte\n"
+            << "  --json=FILE              write the results as JSON\n"
+            << "  --csv=FILE               write the results as CSV\n"
+            << "\n"
+            << "Sizes accept the K, M and G suffixes (powers of 1024).\n";
+}
+
+static std::vector<std::string> split(const std::string& list)
+{
+  std::vector<std::string> items;
+  std::istringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    if (!item.empty())
+      items.push_back(item);
+  return items;
+}
+
+static size_t to_size(const std::string& name, const std::string& value)
+{
+  size_t pos = 0;
+  unsigned long long n = 0;
+  try {
+    n = std::stoull(value, &pos);
+  } catch (const std::exception&) {
+    pos = 0;
+  }
+
+  if (pos > 0 && pos + 1 == value.size()) {
+    switch (value[pos]) {
+      case 'G': n <<= 10; // fall through
+      case 'M': n <<= 10; // fall through
+      case 'K': n <<= 10; ++pos; break;
+    }
+  }
+
+  if (value.empty() || pos != value.size())
+    throw std::invalid_argument("Invalid value for --" + name + ": " + value);
+  return n;
+}
+
+// Fraction between 0 and 1.
+static double to_ratio(const std::string& name, const std::string& value)
+{
+  size_t pos = 0;
+  double r = -1;
+  try {
+    r = std::stod(value, &pos);
+  } catch (const std::exception&) {
+    pos = 0;
+  }
+
+  if (pos == 0 || pos != value.size() || !(r >= 0 && r <= 1))
+    throw std::invalid_argument("Invalid value for --" + name + ": " + value);
+  return r;
+}
+
+template<typename T>
+static bool contains(const std::vector<T>& filter, const T& value)
+{
+  return filter.empty() || std::find(filter.begin(), filter.end(), value) != filter.end();
+}
+
+bool options::selected(const std::string& codec, const std::string& type, size_t threads) const
+{
+  return contains(codecs, codec) && contains(types, type) && contains(this->threads, threads);
+}
+
+std::vector<size_t> options::plain_sizes() const
+{
+  if (!sizes.empty())
+    return sizes;
+
+  std::vector<size_t> sweep;
+  for(size_t size = std::max<size_t>(1, min_size); size <= max_size; size *= std::max<size_t>(2, size_factor)) {
+    sweep.push_back(size);
+    if (size > max_size / std::max<size_t>(2, size_factor))
+      break;
+  }
+  return sweep;
+}
+
+options parse_options(int argc, char** argv)
+{
+  options opts;
+
+  try {
+    for(int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+
+      if (arg == "-h" || arg == "--help") {
+        usage(argv[0]);
+        std::exit(EXIT_SUCCESS);
+      }
+
+      if (arg.compare(0, 2, "--") != 0)
+        throw std::invalid_argument("Unexpected argument: " + arg);
+
+      if (arg == "--counters") {
+        opts.counters = true;
+        continue;
+      }
+
+      std::string name = arg.substr(2), value;
+      size_t eq = name.find('=');
+      if (eq != std::string::npos) {
+        value = name.substr(eq + 1);
+        name.resize(eq);
+      } else if (i + 1 < argc) {
+        value = argv[++i];
+      } else {
+        throw std::invalid_argument("Missing value for --" + name);
+      }
+
+      if (name == "codec") {
+        opts.codecs = split(value);
+      } else if (name == "type") {
+        opts.types = split(value);
+      } else if (name == "threads") {
+        opts.threads.clear();
+        for(const std::string& n : split(value))
+          opts.threads.push_back(to_size(name, n));
+      } else if (name == "concurrent") {
+        opts.concurrent.clear();
+        for(const std::string& n : split(value))
+          opts.concurrent.push_back(std::max<size_t>(1, to_size(name, n)));
+      } else if (name == "invalid") {
+        opts.invalid.clear();
+        for(const std::string& r : split(value))
+          opts.invalid.push_back(to_ratio(name, r));
+      } else if (name == "sizes") {
+        opts.sizes.clear();
+        for(const std::string& n : split(value))
+          opts.sizes.push_back(std::max<size_t>(1, to_size(name, n)));
+      } else if (name == "min-size") {
+        opts.min_size = to_size(name, value);
+      } else if (name == "max-size") {
+        opts.max_size = to_size(name, value);
+      } else if (name == "size-factor") {
+        opts.size_factor = to_size(name, value);
+      } else if (name == "sample-time") {
+        opts.sample_time = std::chrono::microseconds(to_size(name, value));
+      } else if (name == "time-budget") {
+        opts.time_budget = std::chrono::milliseconds(to_size(name, value));
+      } else if (name == "warmup") {
+        opts.warmup = to_size(name, value);
+      } else if (name == "repetitions") {
+        opts.repetitions = std::max<size_t>(1, to_size(name, value));
+      } else if (name == "json") {
+        opts.json = value;
+      } else if (name == "csv") {
+        opts.csv = value;
+      } else {
+        throw std::invalid_argument("Unknown option: --" + name);
+      }
+    }
+  } catch (const std::invalid_argument& e) {
+    std::cerr << e.what() << std::endl;
+    usage(argv[0]);
+    std::exit(EXIT_FAILURE);
+  }
+
+  return opts;
+}
+
+unsigned long long read_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+const char* perf_event_name(size_t event)
+{
+  static const char* const names[event_count] = {
+    "core_cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"
+  };
+  return names[event];
+}
+
+#ifdef __linux__
+// Opens a counter of the calling thread in user space, in the group of
+// leader, or as the disabled leader of a new group if leader is -1.
+static int open_event(uint32_t type, uint64_t config, int leader)
+{
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof attr);
+  attr.size = sizeof attr;
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = leader < 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+// Read misses of a level of cache.
+static uint64_t cache_misses(uint64_t cache)
+{
+  return cache | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+}
+#endif
+
+perf_counters::perf_counters(bool enabled) : leader(-1)
+{
+  fds.fill(-1);
+  if (!enabled)
+    return;
+
+  const char* reason = "not supported on this system";
+  bool denied = false;
+#ifdef __linux__
+  // In the order of the perf_event enumeration. The counters of a group
+  // are scheduled together on the processor, so that the ratios between
+  // them are meaningful.
+  static const struct { uint32_t type; uint64_t config; } events[event_count] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, cache_misses(PERF_COUNT_HW_CACHE_L1D)},
+    {PERF_TYPE_HW_CACHE, cache_misses(PERF_COUNT_HW_CACHE_LL)},
+  };
+
+  int error = 0;
+  for(size_t i = 0; i < event_count; ++i) {
+    fds[i] = open_event(events[i].type, events[i].config, leader);
+    if (fds[i] < 0)
+      error = errno;
+    else if (leader < 0)
+      leader = fds[i];
+  }
+
+  if (leader >= 0)
+    return;
+  reason = strerror(error);
+  denied = error == EACCES || error == EPERM;
+#endif
+
+  static bool warned = false;
+  if (!warned) {
+    warned = true;
+    std::cerr << "Hardware counters unavailable (" << reason << "), only times are reported." << std::endl;
+    if (denied)
+      std::cerr << "Counting may need a lower /proc/sys/kernel/perf_event_paranoid." << std::endl;
+  }
+}
+
+perf_counters::~perf_counters()
+{
+#ifdef __linux__
+  for(int fd : fds)
+    if (fd >= 0)
+      close(fd);
+#endif
+}
+
+void perf_counters::start()
+{
+#ifdef __linux__
+  if (leader < 0)
+    return;
+
+  ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+event_counts perf_counters::stop()
+{
+  event_counts counts;
+  counts.fill(std::numeric_limits<double>::quiet_NaN());
+
+#ifdef __linux__
+  if (leader < 0)
+    return counts;
+
+  ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  for(size_t i = 0; i < event_count; ++i) {
+    // Value, time enabled and time running: counts are scaled up when the
+    // kernel had to multiplex the counters.
+    uint64_t values[3];
+    if (fds[i] >= 0 && read(fds[i], values, sizeof values) == sizeof values && values[2] > 0)
+      counts[i] = static_cast<double>(values[0]) * values[1] / values[2];
+  }
+#endif
+
+  return counts;
+}
+
+// Nearest-rank percentile of the sorted values.
+static double percentile(std::vector<double> values, double p)
+{
+  if (values.empty())
+    return 0;
+
+  std::sort(values.begin(), values.end());
+  size_t rank = static_cast<size_t>(std::ceil(p / 100 * values.size()));
+  return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+static std::vector<double> times(const std::vector<sample>& samples)
+{
+  std::vector<double> values;
+  for(const sample& s : samples)
+    values.push_back(s.ns);
+  return values;
+}
+
+double measurement::min_ns() const
+{
+  return percentile(times(samples), 0);
+}
+
+double measurement::median_ns() const
+{
+  return percentile(times(samples), 50);
+}
+
+double measurement::p99_ns() const
+{
+  return percentile(times(samples), 99);
+}
+
+double measurement::mb_per_s() const
+{
+  double ns = median_ns();
+  return ns > 0 ? plain_bytes * (concurrent ? threads : 1) / ns * 1e3 : 0;
+}
+
+double measurement::mb_per_s_per_thread() const
+{
+  if (!concurrent)
+    return mb_per_s() / threads;
+
+  std::vector<double> values;
+  for(const sample& s : samples)
+    values.push_back(s.thread_ns);
+  double ns = percentile(values, 50);
+  return ns > 0 ? plain_bytes / ns * 1e3 : 0;
+}
+
+double measurement::cycles_per_byte() const
+{
+  std::vector<double> cycles;
+  for(const sample& s : samples)
+    cycles.push_back(s.cycles);
+  return plain_bytes > 0 ? percentile(cycles, 50) / plain_bytes : 0;
+}
+
+double measurement::events_per_byte(size_t event) const
+{
+  std::vector<double> counts;
+  for(const sample& s : samples)
+    if (!std::isnan(s.events[event]))
+      counts.push_back(s.events[event]);
+
+  if (counts.empty() || plain_bytes == 0)
+    return std::numeric_limits<double>::quiet_NaN();
+  return percentile(counts, 50) / plain_bytes;
+}
+
+bool measurement::counted() const
+{
+  for(size_t event = 0; event < event_count; ++event)
+    if (!std::isnan(events_per_byte(event)))
+      return true;
+  return false;
+}
+
+void latch::arrive_and_wait()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  if (--count == 0)
+    done.notify_all();
+  else
+    done.wait(lock, [this]() { return count == 0; });
+}
+
+report::report(const options& opts) : per_thread(!opts.concurrent.empty())
+{
+}
+
+void report::add(measurement m)
+{
+  // Header labels of the perf_event columns.
+  static const char* const labels[event_count] = { "cyc/B", "ins/B", "brmis/B", "L1Dmis/B", "LLCmis/B" };
+
+  if (measurements.empty()) {
+    counters = m.counted();
+
+    std::cout << std::left
+              << std::setw(22) << "codec" << std::setw(8) << "type" << std::setw(8) << "threads"
+              << std::setw(8) << "phase" << std::right
+              << std::setw(12) << "bytes" << std::setw(12) << "encoded"
+              << std::setw(12) << "min(us)" << std::setw(12) << "median(us)" << std::setw(12) << "p99(us)"
+              << std::setw(12) << "MB/s";
+    if (per_thread)
+      std::cout << std::setw(12) << "MB/s/thread";
+    std::cout << std::setw(10) << "cycles/B";
+    if (counters) {
+      std::cout << std::setw(8) << "IPC";
+      for(const char* label : labels)
+        std::cout << std::setw(10) << label;
+    }
+    std::cout << std::endl;
+  }
+
+  std::cout << std::left
+            << std::setw(22) << m.codec << std::setw(8) << m.type << std::setw(8) << m.threads
+            << std::setw(8) << m.phase << std::right << std::fixed
+            << std::setw(12) << m.plain_bytes << std::setw(12) << m.encoded_bytes
+            << std::setprecision(3)
+            << std::setw(12) << m.min_ns() / 1e3 << std::setw(12) << m.median_ns() / 1e3
+            << std::setw(12) << m.p99_ns() / 1e3
+            << std::setprecision(1) << std::setw(12) << m.mb_per_s();
+  if (per_thread)
+    std::cout << std::setw(12) << m.mb_per_s_per_thread();
+  std::cout << std::setprecision(2) << std::setw(10) << m.cycles_per_byte();
+
+  if (counters) {
+    // Instructions per core cycle, then events per byte, with enough
+    // digits for the misses, which are much rarer than bytes.
+    double ipc = m.events_per_byte(event_instructions) / m.events_per_byte(event_cycles);
+    std::cout << std::setw(8);
+    if (std::isnan(ipc))
+      std::cout << "-";
+    else
+      std::cout << ipc;
+
+    for(size_t event = 0; event < event_count; ++event) {
+      double count = m.events_per_byte(event);
+      std::cout << std::setprecision(event < event_branch_misses ? 2 : 4) << std::setw(10);
+      if (std::isnan(count))
+        std::cout << "-";
+      else
+        std::cout << count;
+    }
+  }
+
+  std::cout << std::defaultfloat << std::endl;
+
+  measurements.push_back(std::move(m));
+}
+
+void report::write_json(const std::string& path) const
+{
+  std::ofstream out(path);
+  if (!out)
+    throw std::runtime_error("Cannot write " + path);
+
+  out << "{\n"
+      << "  \"backend\": \"" << base64_backend_name(base64_get_backend()) << "\",\n"
+      << "  \"results\": [";
+
+  for(size_t i = 0; i < measurements.size(); ++i) {
+    const measurement& m = measurements[i];
+    out << (i ? ",\n" : "\n")
+        << "    {\"codec\": \"" << m.codec << "\", \"type\": \"" << m.type << "\""
+        << ", \"phase\": \"" << m.phase << "\", \"threads\": " << m.threads
+        << ", \"plain_bytes\": " << m.plain_bytes << ", \"encoded_bytes\": " << m.encoded_bytes
+        << ", \"repetitions\": " << m.samples.size()
+        << ", \"min_ns\": " << m.min_ns() << ", \"median_ns\": " << m.median_ns()
+        << ", \"p99_ns\": " << m.p99_ns() << ", \"mb_per_s\": " << m.mb_per_s()
+        << ", \"mb_per_s_per_thread\": " << m.mb_per_s_per_thread()
+        << ", \"cycles_per_byte\": " << m.cycles_per_byte();
+
+    // Events that were not counted are null, NaN not being valid JSON.
+    if (m.counted()) {
+      out << ", \"counters\": {";
+      for(size_t event = 0; event < event_count; ++event) {
+        double count = m.events_per_byte(event);
+        out << (event ? ", " : "") << "\"" << perf_event_name(event) << "_per_byte\": ";
+        if (std::isnan(count))
+          out << "null";
+        else
+          out << count;
+      }
+      out << "}";
+    }
+    out << "}";
+  }
+
+  out << "\n  ]\n}\n";
+}
+
+void report::write_csv(const std::string& path) const
+{
+  std::ofstream out(path);
+  if (!out)
+    throw std::runtime_error("Cannot write " + path);
+
+  out << "codec,type,phase,threads,plain_bytes,encoded_bytes,repetitions,"
+         "min_ns,median_ns,p99_ns,mb_per_s,cycles_per_byte,mb_per_s_per_thread";
+  for(size_t event = 0; event < event_count; ++event)
+    out << ',' << perf_event_name(event) << "_per_byte";
+  out << '\n';
+
+  // Events that were not counted are left empty.
+  for(const measurement& m : measurements) {
+    out << m.codec << ',' << m.type << ',' << m.phase << ',' << m.threads << ','
+        << m.plain_bytes << ',' << m.encoded_bytes << ',' << m.samples.size() << ','
+        << m.min_ns() << ',' << m.median_ns() << ',' << m.p99_ns() << ','
+        << m.mb_per_s() << ',' << m.cycles_per_byte() << ',' << m.mb_per_s_per_thread();
+    for(size_t event = 0; event < event_count; ++event) {
+      double count = m.events_per_byte(event);
+      out << ',';
+      if (!std::isnan(count))
+        out << count;
+    }
+    out << '\n';
+  }
+}
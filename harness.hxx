@@ -0,0 +1,286 @@
+#ifndef BENCHMARK_HARNESS
+#define BENCHMARK_HARNESS
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hxx"
+
+// Command-line settings of the benchmark. Empty filters select everything.
+struct options
+{
+  size_t warmup = 2;
+  size_t repetitions = 10;
+
+  // Sizes of the plain data, in bytes: explicit list, or geometric sweep
+  // from min_size to max_size.
+  std::vector<size_t> sizes;
+  size_t min_size = 16;
+  size_t max_size = size_t(1) << 30;
+  size_t size_factor = 4;
+
+  // Runs shorter than sample_time are repeated within a sample; no more
+  // repetitions are started once a phase has run for time_budget.
+  std::chrono::nanoseconds sample_time = std::chrono::microseconds(200);
+  std::chrono::nanoseconds time_budget = std::chrono::seconds(2);
+
+  std::vector<std::string> codecs;
+  std::vector<std::string> types;
+  std::vector<size_t> threads;
+
+  // Numbers of threads running each codec at once on their own buffers.
+  std::vector<size_t> concurrent;
+
+  // Fractions of the fields made invalid for the throw_* and try_*
+  // codecs, which decode a mix of valid and invalid ones.
+  std::vector<double> invalid = {0, 0.33};
+
+  // Counts hardware events around the timed runs (see perf_counters).
+  bool counters = false;
+
+  std::string json;
+  std::string csv;
+
+  bool selected(const std::string& codec, const std::string& type, size_t threads) const;
+
+  std::vector<size_t> plain_sizes() const;
+};
+
+// Parses argv, printing the usage and exiting on --help or invalid arguments.
+options parse_options(int argc, char** argv);
+
+// Hardware events counted by perf_counters.
+enum perf_event
+{
+  event_cycles,
+  event_instructions,
+  event_branch_misses,
+  event_l1d_misses,
+  event_llc_misses,
+  event_count
+};
+
+// Short name of event, as printed in the report.
+const char* perf_event_name(size_t event);
+
+typedef std::array<double, event_count> event_counts;
+
+// Hardware event counters of the calling thread, opened with
+// perf_event_open when enabled. The events that cannot be counted, because
+// the system does not support them or does not allow it, are reported as
+// NaN; a warning is printed the first time none can be opened.
+class perf_counters
+{
+public:
+  explicit perf_counters(bool enabled);
+  ~perf_counters();
+
+  perf_counters(const perf_counters&) = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+
+  // Resets the counters and starts counting.
+  void start();
+
+  // Stops counting, and returns the events counted since start().
+  event_counts stop();
+
+private:
+  std::array<int, event_count> fds;
+  int leader;
+};
+
+// Time of one run, in nanoseconds and in timestamp counter cycles (0 when
+// the processor does not provide one), and the hardware events counted
+// during the run (NaN when not counted), averaged over the iterations of
+// the sample. When several threads run at once, the times span the runs
+// of all of them, and thread_ns is the mean time of a run on one thread.
+struct sample
+{
+  double ns;
+  double cycles;
+  event_counts events;
+  double thread_ns;
+};
+
+// Samples of one phase (encode or decode) of a codec, and the statistics
+// derived from them. Throughput and cycles/byte are relative to the size
+// of the plain data: the data of all threads when they run concurrently,
+// each on its own buffers, instead of sharing one.
+struct measurement
+{
+  std::string codec;
+  std::string type;
+  std::string phase;
+  size_t threads;
+  size_t plain_bytes;
+  size_t encoded_bytes;
+  std::vector<sample> samples;
+  bool concurrent = false;
+
+  double min_ns() const;
+  double median_ns() const;
+  double p99_ns() const;
+  double mb_per_s() const;
+  double mb_per_s_per_thread() const;
+  double cycles_per_byte() const;
+
+  // Median count of event per byte, NaN when it was not counted.
+  double events_per_byte(size_t event) const;
+  bool counted() const;
+};
+
+class report
+{
+public:
+  explicit report(const options& opts);
+
+  // Records m and prints it on the standard output.
+  void add(measurement m);
+
+  void write_json(const std::string& path) const;
+  void write_csv(const std::string& path) const;
+
+private:
+  std::vector<measurement> measurements;
+  // Whether the perf_event columns are printed, as decided by the first
+  // measurement.
+  bool counters = false;
+  // Whether the throughput per thread is printed.
+  bool per_thread;
+};
+
+unsigned long long read_cycles();
+
+// Runs f opts.warmup times untimed (at least once, to calibrate), then
+// opts.repetitions timed samples, within the time budget. Fast runs are
+// batched so that a sample lasts at least opts.sample_time, which keeps
+// timer overhead out of small inputs.
+template<typename F>
+std::vector<sample> measure(const options& opts, F&& f)
+{
+  using std::chrono::steady_clock;
+
+  const auto start = steady_clock::now();
+  auto over_budget = [&]() { return steady_clock::now() - start > opts.time_budget; };
+
+  auto t0 = steady_clock::now();
+  f();
+  auto once = steady_clock::now() - t0;
+
+  for(size_t i = 1; i < opts.warmup && !over_budget(); ++i)
+    f();
+
+  size_t iterations = 1;
+  if (once.count() > 0 && once < opts.sample_time)
+    iterations = opts.sample_time / once;
+
+  std::vector<sample> samples;
+  samples.reserve(opts.repetitions);
+
+  perf_counters counters(opts.counters);
+
+  for(size_t i = 0; i < opts.repetitions && (i == 0 || !over_budget()); ++i) {
+    counters.start();
+    auto t0 = steady_clock::now();
+    unsigned long long c0 = read_cycles();
+
+    for(size_t j = 0; j < iterations; ++j)
+      f();
+
+    unsigned long long c1 = read_cycles();
+    auto t1 = steady_clock::now();
+    event_counts events = counters.stop();
+
+    for(double& count : events)
+      count /= iterations;
+
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations;
+    samples.push_back({ns, static_cast<double>(c1 - c0) / iterations, events, ns});
+  }
+
+  return samples;
+}
+
+// Blocks the threads calling arrive_and_wait until count of them have.
+class latch
+{
+public:
+  explicit latch(size_t count) : count(count) {}
+
+  void arrive_and_wait();
+
+private:
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t count;
+};
+
+// Same as measure, with f(i) run by every thread i of pool at once: the
+// threads start each sample together, and the sample lasts from the first
+// start to the last end. Hardware events are not counted.
+template<typename F>
+std::vector<sample> measure_concurrent(const options& opts, thread_pool& pool, F&& f)
+{
+  using std::chrono::steady_clock;
+
+  const size_t threads = pool.size();
+  const auto start = steady_clock::now();
+  auto over_budget = [&]() { return steady_clock::now() - start > opts.time_budget; };
+
+  auto t0 = steady_clock::now();
+  f(0);
+  auto once = steady_clock::now() - t0;
+
+  for(size_t i = 1; i < opts.warmup && !over_budget(); ++i)
+    pool.run(threads, [&](size_t thread) { f(thread); });
+
+  size_t iterations = 1;
+  if (once.count() > 0 && once < opts.sample_time)
+    iterations = opts.sample_time / once;
+
+  std::vector<sample> samples;
+  samples.reserve(opts.repetitions);
+
+  std::vector<steady_clock::time_point> starts(threads), ends(threads);
+  std::vector<unsigned long long> c0(threads), c1(threads);
+  event_counts events;
+  events.fill(std::numeric_limits<double>::quiet_NaN());
+
+  for(size_t i = 0; i < opts.repetitions && (i == 0 || !over_budget()); ++i) {
+    // A thread waiting for the others cannot take a second task, so that
+    // each thread of the pool runs exactly one.
+    latch ready(threads);
+    pool.run(threads, [&](size_t thread) {
+      ready.arrive_and_wait();
+      starts[thread] = steady_clock::now();
+      c0[thread] = read_cycles();
+
+      for(size_t j = 0; j < iterations; ++j)
+        f(thread);
+
+      c1[thread] = read_cycles();
+      ends[thread] = steady_clock::now();
+    });
+
+    double thread_ns = 0;
+    for(size_t thread = 0; thread < threads; ++thread)
+      thread_ns += std::chrono::duration<double, std::nano>(ends[thread] - starts[thread]).count();
+
+    auto first = *std::min_element(starts.begin(), starts.end());
+    auto last = *std::max_element(ends.begin(), ends.end());
+    samples.push_back({std::chrono::duration<double, std::nano>(last - first).count() / iterations,
+                       static_cast<double>(*std::max_element(c1.begin(), c1.end())
+                                           - *std::min_element(c0.begin(), c0.end())) / iterations,
+                       events, thread_ns / threads / iterations});
+  }
+
+  return samples;
+}
+
+#endif
@@ -1,31 +1,140 @@
 #include "impl.hxx"
+#include "thread_pool.hxx"
 
 #include <string.h>
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+#include <zlib.h>
+
 #include <boost/archive/iterators/base64_from_binary.hpp>
 #include <boost/archive/iterators/binary_from_base64.hpp>
 #include <boost/archive/iterators/transform_width.hpp>
 
 #define RESTRICT
 #include "base64.h"
+#define RESTRICT
+#include "base85.h"
 
   template<typename T>
-std::string encode_base64(const T* in, size_t sz)
+size_t encoded_size_base64(size_t sz)
+{
+  return ((sz * sizeof(T) + 2) / 3) * 4;
+}
+
+// Size of in once the trailing padding characters are removed.
+static size_t unpadded_size(const char* in, size_t sz)
+{
+  if (sz > 0 && in[sz - 1] == '=')
+    --sz;
+  if (sz > 0 && in[sz - 1] == '=')
+    --sz;
+
+  return sz;
+}
+
+  template<typename T>
+size_t decoded_size_base64(const char* in, size_t sz)
+{
+  size_t bytes = unpadded_size(in, sz) * 6 / 8;
+
+  if (bytes % sizeof(T) != 0)
+    throw std::runtime_error("Invalid amount of data to build an array of T");
+
+  return bytes / sizeof(T);
+}
+
+static void check_capacity(size_t needed, size_t capacity)
+{
+  if (capacity < needed)
+    throw std::runtime_error("Output buffer too small");
+}
+
+const char* base64_error_message(base64_errc code)
+{
+  switch (code) {
+  case base64_errc::none:
+    return "No error";
+  case base64_errc::invalid_character:
+  case base64_errc::truncated:
+    return "Input was not base64 encoded";
+  case base64_errc::invalid_size:
+    return "Invalid amount of data to build an array of T";
+  case base64_errc::output_too_small:
+    return "Output buffer too small";
+  }
+  return "Unknown error";
+}
+
+// Characters accepted by the Boost decoders, which read '=' as 0 wherever
+// it is.
+static const std::array<bool, 256> boost_alphabet = []() {
+  std::array<bool, 256> accepted{};
+  for(int c = 0; c < 256; ++c)
+    accepted[c] = isbase64(static_cast<char>(c)) || c == '=';
+  return accepted;
+}();
+
+// Error the Boost decoders would throw on the sz characters of in, decoded
+// to capacity elements of T. They stop before the trailing padding.
+  template<typename T>
+static base64_error boost_input_error(const char* in, size_t sz, size_t capacity)
+{
+  size_t unpadded = unpadded_size(in, sz);
+  for(size_t i = 0; i < unpadded; ++i)
+    if (!boost_alphabet[static_cast<unsigned char>(in[i])])
+      return {base64_errc::invalid_character, i};
+
+  size_t bytes = unpadded * 6 / 8;
+  if (bytes % sizeof(T) != 0)
+    return {base64_errc::invalid_size, sz};
+  if (capacity < bytes / sizeof(T))
+    return {base64_errc::output_too_small, 0};
+
+  return {base64_errc::none, 0};
+}
+
+// Error of the sz characters of in, rejected by base64_decode or not
+// holding a whole number of elements.
+static base64_error rfc_input_error(const char* in, size_t sz)
+{
+  size_t offset = 0;
+  if (base64_validate(in, sz, nullptr, &offset))
+    return {base64_errc::invalid_size, sz};
+
+  return {offset == sz ? base64_errc::truncated : base64_errc::invalid_character, offset};
+}
+
+
+  template<typename T>
+size_t encode_base64_into(const T* in, size_t sz, char* out, size_t capacity)
 {
-  return encode_base64(reinterpret_cast<const char*>(in), sz * sizeof(T));
+  return encode_base64_into(reinterpret_cast<const char*>(in), sz * sizeof(T), out, capacity);
 }
 
   template<>
-std::string encode_base64<char>(const char* in, size_t sz)
+size_t encode_base64_into<char>(const char* in, size_t sz, char* out, size_t capacity)
 {
   namespace bai = boost::archive::iterators;
   using b64_encoder = bai::base64_from_binary<bai::transform_width<const char*, 6, 8> >;
-  std::string out;
-  out.reserve(1 + (((sz) + 2) / 3) * 4);
-  out.assign(b64_encoder(in), b64_encoder(in + sz));
 
-  unsigned int writePaddChars = (3 - sz % 3) % 3;
-  out.append(writePaddChars, '=');
+  size_t needed = encoded_size_base64<char>(sz);
+  check_capacity(needed, capacity);
+
+  char* end = std::copy(b64_encoder(in), b64_encoder(in + sz), out);
+  std::fill(end, out + needed, '=');
+
+  return needed;
+}
+
+  template<typename T>
+std::string encode_base64(const T* in, size_t sz)
+{
+  std::string out(encoded_size_base64<T>(sz), '\0');
+  encode_base64_into(in, sz, &out[0], out.size());
 
   return out;
 }
@@ -37,33 +146,27 @@ std::string encode_base64(const std::vector<T>& in)
 }
 
   template<typename T>
-std::vector<T> decode_base64(const char* in, size_t sz)
+size_t decode_base64_into(const char* in, size_t sz, T* out, size_t capacity)
 {
   namespace bai = boost::archive::iterators;
   using b64_decoder = bai::transform_width< bai::binary_from_base64<const char*>, 8, 6 >;
 
-  size_t padding = 0;
-
-  if (sz > 0 && in[sz - 1] == '=') {
-    --sz;
-    ++padding;
-  }
-  if (sz > 0 && in[sz - 1] == '=') {
-    --sz;
-    ++padding;
-  }
+  size_t decoded = decoded_size_base64<T>(in, sz);
+  check_capacity(decoded, capacity);
 
-  std::vector<char> out;
-  out.reserve(3 * (sz / 4) + 2);
-  out.assign(b64_decoder(in), b64_decoder(in + sz));
+  sz = unpadded_size(in, sz);
+  std::copy(b64_decoder(in), b64_decoder(in + sz), reinterpret_cast<char*>(out));
 
-  if (out.size() % sizeof(T) != 0)
-    throw std::runtime_error("Invalid amount of bytes to build an array of T");
+  return decoded;
+}
 
-  std::vector<T> out2(out.size() / sizeof(T));
-  memcpy(out2.data(), out.data(), out.size());
+  template<typename T>
+std::vector<T> decode_base64(const char* in, size_t sz)
+{
+  std::vector<T> out(decoded_size_base64<T>(in, sz));
+  decode_base64_into(in, sz, out.data(), out.size());
 
-  return out2;
+  return out;
 }
 
   template<typename T>
@@ -72,18 +175,84 @@ std::vector<T> decode_base64(const std::string& in)
   return decode_base64<T>(in.data(), in.size());
 }
 
+  template<typename T>
+std::pmr::string encode_base64(const T* in, size_t sz, std::pmr::memory_resource* resource)
+{
+  std::pmr::string out(encoded_size_base64<T>(sz), '\0', resource);
+  encode_base64_into(in, sz, &out[0], out.size());
+
+  return out;
+}
 
   template<typename T>
-std::string encode_base64_2(const T* in, size_t sz)
+std::pmr::string encode_base64(const std::vector<T>& in, std::pmr::memory_resource* resource)
+{
+  return encode_base64(in.data(), in.size(), resource);
+}
+
+  template<typename T>
+std::pmr::vector<T> decode_base64(const char* in, size_t sz, std::pmr::memory_resource* resource)
+{
+  std::pmr::vector<T> out(decoded_size_base64<T>(in, sz), resource);
+  decode_base64_into(in, sz, out.data(), out.size());
+
+  return out;
+}
+
+  template<typename T>
+std::pmr::vector<T> decode_base64(const std::pmr::string& in, std::pmr::memory_resource* resource)
+{
+  return decode_base64<T>(in.data(), in.size(), resource);
+}
+
+  template<typename T>
+base64_result<size_t> try_decode_base64_into(const char* in, size_t sz, T* out, size_t capacity)
+{
+  base64_error error = boost_input_error<T>(in, sz, capacity);
+  if (error.code != base64_errc::none)
+    return {0, error};
+
+  return {decode_base64_into(in, sz, out, capacity), error};
+}
+
+  template<typename T>
+base64_result<std::vector<T>> try_decode_base64(const char* in, size_t sz)
+{
+  base64_result<std::vector<T>> out{};
+  out.error = boost_input_error<T>(in, sz, SIZE_MAX);
+  if (out)
+    out.value = decode_base64<T>(in, sz);
+
+  return out;
+}
+
+  template<typename T>
+base64_result<std::vector<T>> try_decode_base64(const std::string& in)
+{
+  return try_decode_base64<T>(in.data(), in.size());
+}
+
+
+  template<typename T>
+size_t encode_base64_2_into(const T* in, size_t sz, char* out, size_t capacity)
 {
   namespace bai = boost::archive::iterators;
   using b64_encoder = bai::base64_from_binary<bai::transform_width<const T*, 6, sizeof(T) * 8>, char>;
-  std::string out;
-  out.reserve(1 + (((sz * sizeof(T)) + 2) / 3) * 4);
-  out.assign(b64_encoder(in), b64_encoder(in + sz));
 
-  unsigned int writePaddChars = (3 - (sz * sizeof(T)) % 3) % 3;
-  out.append(writePaddChars, '=');
+  size_t needed = encoded_size_base64<T>(sz);
+  check_capacity(needed, capacity);
+
+  char* end = std::copy(b64_encoder(in), b64_encoder(in + sz), out);
+  std::fill(end, out + needed, '=');
+
+  return needed;
+}
+
+  template<typename T>
+std::string encode_base64_2(const T* in, size_t sz)
+{
+  std::string out(encoded_size_base64<T>(sz), '\0');
+  encode_base64_2_into(in, sz, &out[0], out.size());
 
   return out;
 }
@@ -95,25 +264,25 @@ std::string encode_base64_2(const std::vector<T>& in)
 }
 
   template<typename T>
-std::vector<T> decode_base64_2(const char* in, size_t sz)
+size_t decode_base64_2_into(const char* in, size_t sz, T* out, size_t capacity)
 {
   namespace bai = boost::archive::iterators;
   using b64_decoder = bai::transform_width< bai::binary_from_base64<const char*>, 8 * sizeof(T), 6 , T>;
 
-  size_t padding = 0;
+  size_t decoded = decoded_size_base64<T>(in, sz);
+  check_capacity(decoded, capacity);
 
-  if (sz > 0 && in[sz - 1] == '=') {
-    --sz;
-    ++padding;
-  }
-  if (sz > 0 && in[sz - 1] == '=') {
-    --sz;
-    ++padding;
-  }
+  sz = unpadded_size(in, sz);
+  std::copy(b64_decoder(in), b64_decoder(in + sz), out);
 
-  std::vector<T> out;
-  out.reserve(3 * (sz / sizeof(T) / 4) + 2);
-  out.assign(b64_decoder(in), b64_decoder(in + sz));
+  return decoded;
+}
+
+  template<typename T>
+std::vector<T> decode_base64_2(const char* in, size_t sz)
+{
+  std::vector<T> out(decoded_size_base64<T>(in, sz));
+  decode_base64_2_into(in, sz, out.data(), out.size());
 
   return out;
 }
@@ -124,6 +293,63 @@ std::vector<T> decode_base64_2(const std::string& in)
   return decode_base64_2<T>(in.data(), in.size());
 }
 
+  template<typename T>
+std::pmr::string encode_base64_2(const T* in, size_t sz, std::pmr::memory_resource* resource)
+{
+  std::pmr::string out(encoded_size_base64<T>(sz), '\0', resource);
+  encode_base64_2_into(in, sz, &out[0], out.size());
+
+  return out;
+}
+
+  template<typename T>
+std::pmr::string encode_base64_2(const std::vector<T>& in, std::pmr::memory_resource* resource)
+{
+  return encode_base64_2(in.data(), in.size(), resource);
+}
+
+  template<typename T>
+std::pmr::vector<T> decode_base64_2(const char* in, size_t sz, std::pmr::memory_resource* resource)
+{
+  std::pmr::vector<T> out(decoded_size_base64<T>(in, sz), resource);
+  decode_base64_2_into(in, sz, out.data(), out.size());
+
+  return out;
+}
+
+  template<typename T>
+std::pmr::vector<T> decode_base64_2(const std::pmr::string& in, std::pmr::memory_resource* resource)
+{
+  return decode_base64_2<T>(in.data(), in.size(), resource);
+}
+
+  template<typename T>
+base64_result<size_t> try_decode_base64_2_into(const char* in, size_t sz, T* out, size_t capacity)
+{
+  base64_error error = boost_input_error<T>(in, sz, capacity);
+  if (error.code != base64_errc::none)
+    return {0, error};
+
+  return {decode_base64_2_into(in, sz, out, capacity), error};
+}
+
+  template<typename T>
+base64_result<std::vector<T>> try_decode_base64_2(const char* in, size_t sz)
+{
+  base64_result<std::vector<T>> out{};
+  out.error = boost_input_error<T>(in, sz, SIZE_MAX);
+  if (out)
+    out.value = decode_base64_2<T>(in, sz);
+
+  return out;
+}
+
+  template<typename T>
+base64_result<std::vector<T>> try_decode_base64_2(const std::string& in)
+{
+  return try_decode_base64_2<T>(in.data(), in.size());
+}
+
 template<typename T>
 void free_deleter<T>::operator()(T* p) { free(p); }
 
@@ -155,40 +381,702 @@ std::unique_ptr<char, free_deleter<char>> encode_base64_rfc(const std::vector<T>
   return encode_base64_rfc(in.data(), in.size());
 }
 
+  template<typename T>
+size_t encode_base64_rfc_into(const T* in, size_t sz, char* out, size_t capacity)
+{
+  return encode_base64_rfc_into(reinterpret_cast<const char*>(in), sz * sizeof(T), out, capacity);
+}
+
+  template<>
+size_t encode_base64_rfc_into<char>(const char* in, size_t sz, char* out, size_t capacity)
+{
+  size_t needed = encoded_size_base64<char>(sz);
+  check_capacity(needed, capacity);
+
+  base64_encode(in, sz, out, needed);
+
+  return needed;
+}
+
+  template<typename T>
+size_t decode_base64_rfc_into(const char* in, size_t sz, T* out, size_t capacity)
+{
+  size_t decoded = decoded_size_base64<T>(in, sz);
+  check_capacity(decoded, capacity);
+
+  size_t decoded_bytes = decoded * sizeof(T);
+  if (!base64_decode(in, sz, reinterpret_cast<char*>(out), &decoded_bytes))
+    throw std::runtime_error("Input was not base64 encoded");
+
+  return decoded;
+}
+
   template<typename T>
 std::vector<T> decode_base64_rfc(const char* in, size_t sz)
 {
-  size_t decoded_size = 0;
-  char* decoded = nullptr;
-  bool ok = base64_decode_alloc(in, sz, &decoded, &decoded_size);
+  std::vector<T> out(decoded_size_base64<T>(in, sz));
+  decode_base64_rfc_into(in, sz, out.data(), out.size());
 
-  if (!ok)
+  return out;
+}
+
+  template<typename T>
+std::vector<T> decode_base64_rfc(const std::string& in)
+{
+  return decode_base64_rfc<T>(in.data(), in.size());
+}
+
+  template<typename T>
+std::pmr::string encode_base64_rfc(const T* in, size_t sz, std::pmr::memory_resource* resource)
+{
+  size_t bytes = sz * sizeof(T);
+  size_t encoded_size = encoded_size_base64<char>(bytes);
+  if (encoded_size < bytes)
+    throw std::runtime_error("Input too long");
+
+  std::pmr::string out(encoded_size, '\0', resource);
+  base64_encode(reinterpret_cast<const char*>(in), bytes, &out[0], encoded_size);
+
+  return out;
+}
+
+  template<typename T>
+std::pmr::string encode_base64_rfc(const std::vector<T>& in, std::pmr::memory_resource* resource)
+{
+  return encode_base64_rfc(in.data(), in.size(), resource);
+}
+
+  template<typename T>
+std::pmr::vector<T> decode_base64_rfc(const char* in, size_t sz, std::pmr::memory_resource* resource)
+{
+  std::pmr::vector<T> out(decoded_size_base64<T>(in, sz), resource);
+  decode_base64_rfc_into(in, sz, out.data(), out.size());
+
+  return out;
+}
+
+  template<typename T>
+std::pmr::vector<T> decode_base64_rfc(const std::pmr::string& in, std::pmr::memory_resource* resource)
+{
+  return decode_base64_rfc<T>(in.data(), in.size(), resource);
+}
+
+  template<typename T>
+base64_result<size_t> try_decode_base64_rfc_into(const char* in, size_t sz, T* out, size_t capacity)
+{
+  size_t bytes = unpadded_size(in, sz) * 6 / 8;
+  if (bytes % sizeof(T) != 0)
+    return {0, rfc_input_error(in, sz)};
+  if (capacity < bytes / sizeof(T))
+    return {0, {base64_errc::output_too_small, 0}};
+
+  if (!base64_decode(in, sz, reinterpret_cast<char*>(out), &bytes))
+    return {0, rfc_input_error(in, sz)};
+
+  return {bytes / sizeof(T), {base64_errc::none, 0}};
+}
+
+  template<typename T>
+base64_result<std::vector<T>> try_decode_base64_rfc(const char* in, size_t sz)
+{
+  base64_result<std::vector<T>> out{};
+  out.value.resize(unpadded_size(in, sz) * 6 / 8 / sizeof(T));
+
+  base64_result<size_t> decoded = try_decode_base64_rfc_into(in, sz, out.value.data(), out.value.size());
+  out.error = decoded.error;
+  if (!decoded)
+    out.value = std::vector<T>();
+
+  return out;
+}
+
+  template<typename T>
+base64_result<std::vector<T>> try_decode_base64_rfc(const std::string& in)
+{
+  return try_decode_base64_rfc<T>(in.data(), in.size());
+}
+
+  template<typename Buffer>
+static Buffer decode_in_place(Buffer&& in)
+{
+  Buffer out(std::move(in));
+  size_t decoded = 0;
+  if (!base64_decode_inplace(out.data(), out.size(), &decoded))
     throw std::runtime_error("Input was not base64 encoded");
+  out.resize(decoded);
+
+  return out;
+}
 
-  if (decoded == nullptr)
+std::string decode_base64_rfc_inplace(std::string&& in)
+{
+  return decode_in_place(std::move(in));
+}
+
+std::vector<char> decode_base64_rfc_inplace(std::vector<char>&& in)
+{
+  return decode_in_place(std::move(in));
+}
+
+  template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_be(const T* in, size_t sz)
+{
+  size_t bytes = sz * sizeof(T);
+  size_t encoded_size = encoded_size_base64<char>(bytes);
+  if (encoded_size < bytes)
+    throw std::runtime_error("Input too long");
+
+  std::unique_ptr<char, free_deleter<char>> out(static_cast<char*>(malloc(encoded_size + 1)));
+  if (!out)
     throw std::runtime_error("Memory allocation failed");
 
-  if (decoded_size % sizeof(T) != 0)
+  base64_encode_be(reinterpret_cast<const char*>(in), bytes, out.get(), encoded_size + 1, sizeof(T));
+  return out;
+}
+
+  template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_be(const std::vector<T>& in)
+{
+  return encode_base64_rfc_be(in.data(), in.size());
+}
+
+  template<typename T>
+size_t encode_base64_rfc_be_into(const T* in, size_t sz, char* out, size_t capacity)
+{
+  size_t needed = encoded_size_base64<T>(sz);
+  check_capacity(needed, capacity);
+
+  base64_encode_be(reinterpret_cast<const char*>(in), sz * sizeof(T), out, needed, sizeof(T));
+
+  return needed;
+}
+
+  template<typename T>
+size_t decode_base64_rfc_be_into(const char* in, size_t sz, T* out, size_t capacity)
+{
+  size_t decoded = decoded_size_base64<T>(in, sz);
+  check_capacity(decoded, capacity);
+
+  size_t decoded_bytes = decoded * sizeof(T);
+  if (!base64_decode_be(in, sz, reinterpret_cast<char*>(out), &decoded_bytes, sizeof(T)))
+    throw std::runtime_error("Input was not base64 encoded");
+
+  return decoded;
+}
+
+  template<typename T>
+std::vector<T> decode_base64_rfc_be(const char* in, size_t sz)
+{
+  std::vector<T> out(decoded_size_base64<T>(in, sz));
+  decode_base64_rfc_be_into(in, sz, out.data(), out.size());
+
+  return out;
+}
+
+  template<typename T>
+std::vector<T> decode_base64_rfc_be(const std::string& in)
+{
+  return decode_base64_rfc_be<T>(in.data(), in.size());
+}
+
+  template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_wrapped(const T* in, size_t sz, size_t line, const char* eol)
+{
+  size_t bytes = sz * sizeof(T);
+  size_t encoded_size = BASE64_WRAPPED_LENGTH(bytes, line, strlen(eol));
+  if (encoded_size < bytes)
+    throw std::runtime_error("Input too long");
+
+  std::unique_ptr<char, free_deleter<char>> out(static_cast<char*>(malloc(encoded_size + 1)));
+  if (!out)
+    throw std::runtime_error("Memory allocation failed");
+
+  base64_encode_wrapped(reinterpret_cast<const char*>(in), bytes, out.get(), encoded_size + 1, line, eol);
+  return out;
+}
+
+  template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_wrapped(const std::vector<T>& in, size_t line, const char* eol)
+{
+  return encode_base64_rfc_wrapped(in.data(), in.size(), line, eol);
+}
+
+  template<typename T>
+std::vector<T> decode_base64_rfc_wrapped(const char* in, size_t sz)
+{
+  // The whitespace is only known once skipped: the output is sized for
+  // the whole input, then shrunk.
+  size_t decoded_bytes = sz / 4 * 3;
+  std::vector<T> out((decoded_bytes + sizeof(T) - 1) / sizeof(T));
+
+  if (!base64_decode_wrapped(in, sz, reinterpret_cast<char*>(out.data()), &decoded_bytes))
+    throw std::runtime_error("Input was not base64 encoded");
+  if (decoded_bytes % sizeof(T) != 0)
     throw std::runtime_error("Invalid amount of data to build an array of T");
 
-  std::vector<T> _decoded(decoded_size / sizeof(T), 0);
-  memcpy(_decoded.data(), decoded, decoded_size);
-  free(decoded);
+  out.resize(decoded_bytes / sizeof(T));
+  return out;
+}
+
+  template<typename T>
+std::vector<T> decode_base64_rfc_wrapped(const std::string& in)
+{
+  return decode_base64_rfc_wrapped<T>(in.data(), in.size());
+}
 
-  return _decoded;
+  template<typename T>
+size_t encoded_size_base85(size_t sz)
+{
+  return BASE85_LENGTH(sz * sizeof(T));
 }
 
   template<typename T>
-std::vector<T> decode_base64_rfc(const std::string& in)
+size_t decoded_size_base85(size_t sz)
+{
+  if (sz % 5 == 1)
+    throw std::runtime_error("Input was not base85 encoded");
+
+  size_t bytes = BASE85_DECODED_LENGTH(sz);
+  if (bytes % sizeof(T) != 0)
+    throw std::runtime_error("Invalid amount of data to build an array of T");
+
+  return bytes / sizeof(T);
+}
+
+  template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base85(const T* in, size_t sz)
+{
+  char* encoded = nullptr;
+  size_t encoded_size = base85_encode_alloc(reinterpret_cast<const char*>(in), sz * sizeof(T), &encoded);
+
+  if (encoded == nullptr && encoded_size == 0 && sz != 0)
+    throw std::runtime_error("Input too long");
+
+  if (encoded == nullptr)
+    throw std::runtime_error("Memory allocation failed");
+
+  return std::unique_ptr<char, free_deleter<char>>(encoded);
+}
+
+  template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base85(const std::vector<T>& in)
+{
+  return encode_base85(in.data(), in.size());
+}
+
+  template<typename T>
+size_t encode_base85_into(const T* in, size_t sz, char* out, size_t capacity)
+{
+  size_t needed = encoded_size_base85<T>(sz);
+  check_capacity(needed, capacity);
+
+  base85_encode(reinterpret_cast<const char*>(in), sz * sizeof(T), out, needed);
+
+  return needed;
+}
+
+  template<typename T>
+size_t decode_base85_into(const char* in, size_t sz, T* out, size_t capacity)
+{
+  size_t decoded = decoded_size_base85<T>(sz);
+  check_capacity(decoded, capacity);
+
+  size_t decoded_bytes = decoded * sizeof(T);
+  if (!base85_decode(in, sz, reinterpret_cast<char*>(out), &decoded_bytes))
+    throw std::runtime_error("Input was not base85 encoded");
+
+  return decoded;
+}
+
+  template<typename T>
+std::vector<T> decode_base85(const char* in, size_t sz)
+{
+  std::vector<T> out(decoded_size_base85<T>(sz));
+  decode_base85_into(in, sz, out.data(), out.size());
+
+  return out;
+}
+
+  template<typename T>
+std::vector<T> decode_base85(const std::string& in)
+{
+  return decode_base85<T>(in.data(), in.size());
+}
+
+// Bytes of the chunks of elements shuffled and compressed at once by the
+// deflate pipeline, and of the compressed data encoded at once.
+static const size_t deflate_chunk = 1 << 16;
+
+// Blosc-style shuffle of the n elements of size bytes at in: byte j of
+// element i goes to out[j * n + i].
+template<size_t size>
+static void shuffle_bytes(const char* in, size_t n, char* out)
+{
+  for(size_t i = 0; i < n; ++i)
+    for(size_t j = 0; j < size; ++j)
+      out[j * n + i] = in[i * size + j];
+}
+
+template<size_t size>
+static void unshuffle_bytes(const char* in, size_t n, char* out)
+{
+  for(size_t i = 0; i < n; ++i)
+    for(size_t j = 0; j < size; ++j)
+      out[i * size + j] = in[j * n + i];
+}
+
+  template<typename T>
+std::string encode_base64_deflate(const T* in, size_t sz, int level)
+{
+  z_stream z;
+  memset(&z, 0, sizeof z);
+  switch (deflateInit(&z, level)) {
+    case Z_OK: break;
+    case Z_STREAM_ERROR: throw std::invalid_argument("Invalid compression level");
+    default: throw std::runtime_error("Memory allocation failed");
+  }
+  std::unique_ptr<z_stream, int (*)(z_stream*)> end(&z, deflateEnd);
+
+  const size_t chunk = std::max<size_t>(1, deflate_chunk / sizeof(T));
+  std::vector<char> shuffled(chunk * sizeof(T));
+  std::vector<char> compressed(deflate_chunk);
+  base64_encoder encoder;
+  std::string out;
+
+  for(size_t first = 0;; first += chunk) {
+    size_t n = std::min(chunk, sz - first);
+    bool last = first + n == sz;
+
+    shuffle_bytes<sizeof(T)>(reinterpret_cast<const char*>(in + first), n, shuffled.data());
+    z.next_in = reinterpret_cast<Bytef*>(shuffled.data());
+    z.avail_in = n * sizeof(T);
+
+    // The compressed data is encoded as soon as it is produced: the encoder
+    // keeps the bytes that do not fill a group for the next call.
+    do {
+      z.next_out = reinterpret_cast<Bytef*>(compressed.data());
+      z.avail_out = compressed.size();
+      deflate(&z, last ? Z_FINISH : Z_NO_FLUSH);
+      encoder.update(compressed.data(), compressed.size() - z.avail_out, out);
+    } while (z.avail_out == 0);
+
+    if (last)
+      break;
+  }
+  encoder.finish(out);
+
+  return out;
+}
+
+  template<typename T>
+std::string encode_base64_deflate(const std::vector<T>& in, int level)
+{
+  return encode_base64_deflate(in.data(), in.size(), level);
+}
+
+  template<typename T>
+std::vector<T> decode_base64_deflate(const char* in, size_t sz)
+{
+  z_stream z;
+  memset(&z, 0, sizeof z);
+  if (inflateInit(&z) != Z_OK)
+    throw std::runtime_error("Memory allocation failed");
+  std::unique_ptr<z_stream, int (*)(z_stream*)> end(&z, inflateEnd);
+
+  // The decompressed data is unshuffled one chunk of the encoder at a time.
+  const size_t chunk = std::max<size_t>(1, deflate_chunk / sizeof(T)) * sizeof(T);
+  const size_t encoded_chunk = deflate_chunk / 3 * 4;
+  std::vector<char> compressed(encoded_chunk / 4 * 3 + 3);
+  std::vector<char> shuffled(chunk);
+  size_t filled = 0;
+  base64_decoder decoder;
+  std::vector<T> out;
+  int status = Z_OK;
+
+  auto unshuffle = [&]() {
+    if (filled % sizeof(T) != 0)
+      throw std::runtime_error("Invalid amount of data to build an array of T");
+
+    size_t offset = out.size(), n = filled / sizeof(T);
+    out.resize(offset + n);
+    unshuffle_bytes<sizeof(T)>(shuffled.data(), n, reinterpret_cast<char*>(out.data() + offset));
+    filled = 0;
+  };
+
+  for(size_t offset = 0; offset < sz; offset += encoded_chunk) {
+    z.next_in = reinterpret_cast<Bytef*>(compressed.data());
+    z.avail_in = decoder.update(in + offset, std::min(encoded_chunk, sz - offset), compressed.data());
+
+    // Inflates until the input is used up and inflate has no more output
+    // pending, which it may have whenever it filled the chunk.
+    for(;;) {
+      z.next_out = reinterpret_cast<Bytef*>(shuffled.data() + filled);
+      z.avail_out = chunk - filled;
+      status = inflate(&z, Z_NO_FLUSH);
+      if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR)
+        throw std::runtime_error(status == Z_MEM_ERROR ? "Memory allocation failed" : "Invalid compressed data");
+
+      filled = chunk - z.avail_out;
+      if (filled == chunk)
+        unshuffle();
+      else if (status == Z_STREAM_END && z.avail_in > 0)
+        throw std::runtime_error("Invalid compressed data");
+      else if (status == Z_STREAM_END || z.avail_in == 0)
+        break;
+    }
+  }
+  decoder.finish();
+
+  if (status != Z_STREAM_END)
+    throw std::runtime_error("Invalid compressed data");
+  if (filled > 0)
+    unshuffle();
+
+  return out;
+}
+
+  template<typename T>
+std::vector<T> decode_base64_deflate(const std::string& in)
+{
+  return decode_base64_deflate<T>(in.data(), in.size());
+}
+
+  template<typename T>
+base64_view<T>::base64_view(const char* in, size_t sz)
+  : in(in), sz(sz), count(decoded_size_base64<T>(in, sz))
+{
+}
+
+  template<typename T>
+base64_view<T>::base64_view(const std::string& in) : base64_view(in.data(), in.size())
 {
-  return decode_base64_rfc<T>(in.data(), in.size());
+}
+
+  template<typename T>
+T base64_view<T>::operator[](size_t i) const
+{
+  T value;
+  decode_range(i, 1, &value);
+
+  return value;
+}
+
+  template<typename T>
+void base64_view<T>::decode_partial(size_t begin, size_t end, char* out) const
+{
+  size_t quantum = begin / 3;
+  size_t chars = std::min<size_t>(4, sz - quantum * 4);
+  char bytes[3];
+  size_t decoded = sizeof bytes;
+
+  // Only the last quantum may be padded.
+  size_t expected = std::min<size_t>(3, count * sizeof(T) - quantum * 3);
+  if (!base64_decode(in + quantum * 4, chars, bytes, &decoded) || decoded != expected)
+    throw std::runtime_error("Input was not base64 encoded");
+
+  memcpy(out, bytes + begin % 3, end - begin);
+}
+
+  template<typename T>
+void base64_view<T>::decode_range(size_t first, size_t count, T* out) const
+{
+  if (first > this->count || count > this->count - first)
+    throw std::out_of_range("Range out of the view");
+
+  size_t begin = first * sizeof(T);
+  size_t end = (first + count) * sizeof(T);
+  char* bytes = reinterpret_cast<char*>(out);
+
+  // Bytes sharing their quantum with bytes out of the range.
+  size_t head = std::min((3 - begin % 3) % 3, end - begin);
+  if (head > 0)
+    decode_partial(begin, begin + head, bytes);
+  begin += head;
+  bytes += head;
+
+  size_t tail = (end - begin) % 3;
+  end -= tail;
+
+  // Whole quanta in between, decoded in place. None of them is the padded
+  // last quantum, which holds fewer than 3 bytes.
+  if (end > begin) {
+    size_t decoded = end - begin;
+    if (!base64_decode(in + begin / 3 * 4, (end - begin) / 3 * 4, bytes, &decoded) || decoded != end - begin)
+      throw std::runtime_error("Input was not base64 encoded");
+  }
+
+  if (tail > 0)
+    decode_partial(end, end + tail, bytes + (end - begin));
+}
+
+  template<typename T>
+std::vector<T> base64_view<T>::decode_range(size_t first, size_t count) const
+{
+  std::vector<T> out(count);
+  decode_range(first, count, out.data());
+
+  return out;
+}
+
+static std::unique_ptr<char, free_deleter<char>> allocate(size_t size)
+{
+  // malloc(0) may return a null pointer.
+  std::unique_ptr<char, free_deleter<char>> out(static_cast<char*>(malloc(std::max<size_t>(1, size))));
+  if (!out)
+    throw std::runtime_error("Memory allocation failed");
+  return out;
+}
+
+
+base64_batch encode_base64_rfc_batch(const char* const* in, const size_t* sz, size_t n)
+{
+  base64_batch out;
+  out.offsets.resize(n + 1);
+
+  size_t total = base64_encode_batch(in, sz, n, nullptr, 0, out.offsets.data());
+  out.buffer = allocate(total);
+  base64_encode_batch(in, sz, n, out.buffer.get(), total, out.offsets.data());
+  return out;
+}
+
+base64_batch encode_base64_rfc_batch(const std::vector<std::string>& in)
+{
+  std::vector<const char*> data(in.size());
+  std::vector<size_t> sz(in.size());
+  for(size_t i = 0; i < in.size(); ++i) {
+    data[i] = in[i].data();
+    sz[i] = in[i].size();
+  }
+
+  return encode_base64_rfc_batch(data.data(), sz.data(), in.size());
+}
+
+base64_batch decode_base64_rfc_batch(const char* const* in, const size_t* sz, size_t n)
+{
+  size_t capacity = 0;
+  for(size_t i = 0; i < n; ++i)
+    capacity += sz[i] / 4 * 3;
+
+  base64_batch out;
+  out.offsets.resize(n + 1);
+  out.buffer = allocate(capacity);
+
+  if (base64_decode_batch(in, sz, n, out.buffer.get(), capacity, out.offsets.data()) != n)
+    throw std::runtime_error("Input was not base64 encoded");
+  return out;
+}
+
+base64_batch decode_base64_rfc_batch(const base64_batch& in)
+{
+  std::vector<const char*> data(in.count());
+  std::vector<size_t> sz(in.count());
+  for(size_t i = 0; i < in.count(); ++i) {
+    data[i] = in.data(i);
+    sz[i] = in.size(i);
+  }
+
+  return decode_base64_rfc_batch(data.data(), sz.data(), in.count());
+}
+
+// Size of the slices, a multiple of quantum, used to split size items
+// across the threads of pool.
+static size_t slice_size(size_t size, size_t quantum, const thread_pool& pool)
+{
+  size_t slice = (size + pool.size() - 1) / pool.size();
+  return std::max(quantum, (slice + quantum - 1) / quantum * quantum);
+}
+
+  template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_parallel(const T* in, size_t sz, thread_pool& pool, size_t threshold)
+{
+  return encode_base64_rfc_parallel(reinterpret_cast<const char*>(in), sz * sizeof(T), pool, threshold);
+}
+
+  template<>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_parallel(const char* in, size_t sz, thread_pool& pool, size_t threshold)
+{
+  if (sz < threshold || pool.size() < 2)
+    return encode_base64_rfc(in, sz);
+
+  size_t encoded_size = encoded_size_base64<char>(sz);
+  if (encoded_size < sz)
+    throw std::runtime_error("Input too long");
+
+  std::unique_ptr<char, free_deleter<char>> out(static_cast<char*>(malloc(encoded_size + 1)));
+  if (!out)
+    throw std::runtime_error("Memory allocation failed");
+
+  char* encoded = out.get();
+  size_t slice = slice_size(sz, 3, pool);
+
+  pool.run((sz + slice - 1) / slice, [=](size_t i) {
+    size_t begin = i * slice;
+    size_t len = std::min(slice, sz - begin);
+    base64_encode(in + begin, len, encoded + begin / 3 * 4, encoded_size_base64<char>(len));
+  });
+
+  encoded[encoded_size] = '\0';
+  return out;
+}
+
+  template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_parallel(const std::vector<T>& in, thread_pool& pool, size_t threshold)
+{
+  return encode_base64_rfc_parallel(in.data(), in.size(), pool, threshold);
+}
+
+  template<typename T>
+std::vector<T> decode_base64_rfc_parallel(const char* in, size_t sz, thread_pool& pool, size_t threshold)
+{
+  if (sz < threshold || pool.size() < 2)
+    return decode_base64_rfc<T>(in, sz);
+
+  std::vector<T> out(decoded_size_base64<T>(in, sz));
+  char* decoded = reinterpret_cast<char*>(out.data());
+  size_t decoded_bytes = out.size() * sizeof(T);
+  size_t slice = slice_size(sz, 4, pool);
+
+  pool.run((sz + slice - 1) / slice, [=](size_t i) {
+    size_t begin = i * slice;
+    size_t len = std::min(slice, sz - begin);
+    size_t offset = begin / 4 * 3;
+    bool last = begin + len == sz;
+
+    // base64_decode accepts padding at the end of its input, which is
+    // only the end of the whole input for the last slice.
+    if (offset > decoded_bytes || (!last && in[begin + len - 1] == '='))
+      throw std::runtime_error("Input was not base64 encoded");
+
+    size_t written = last ? decoded_bytes - offset : len / 4 * 3;
+    if (!base64_decode(in + begin, len, decoded + offset, &written))
+      throw std::runtime_error("Input was not base64 encoded");
+  });
+
+  return out;
+}
+
+  template<typename T>
+std::vector<T> decode_base64_rfc_parallel(const std::string& in, thread_pool& pool, size_t threshold)
+{
+  return decode_base64_rfc_parallel<T>(in.data(), in.size(), pool, threshold);
 }
 
 #define IMPL(type) \
+template size_t encoded_size_base64<type>(size_t sz); \
+template size_t decoded_size_base64<type>(const char* in, size_t sz); \
+template size_t encode_base64_into<type>(const type* in, size_t sz, char* out, size_t capacity); \
+template size_t decode_base64_into<type>(const char* in, size_t sz, type* out, size_t capacity); \
 template std::string encode_base64<type>(const type* in, size_t sz); \
 template std::string encode_base64<type>(const std::vector<type>& in); \
 template std::vector<type> decode_base64<type>(const char* in, size_t sz); \
-template std::vector<type> decode_base64<type>(const std::string& in);
+template std::vector<type> decode_base64<type>(const std::string& in); \
+template std::pmr::string encode_base64<type>(const type* in, size_t sz, std::pmr::memory_resource* resource); \
+template std::pmr::string encode_base64<type>(const std::vector<type>& in, std::pmr::memory_resource* resource); \
+template std::pmr::vector<type> decode_base64<type>(const char* in, size_t sz, std::pmr::memory_resource* resource); \
+template std::pmr::vector<type> decode_base64<type>(const std::pmr::string& in, std::pmr::memory_resource* resource); \
+template base64_result<size_t> try_decode_base64_into<type>(const char* in, size_t sz, type* out, size_t capacity); \
+template base64_result<std::vector<type>> try_decode_base64<type>(const char* in, size_t sz); \
+template base64_result<std::vector<type>> try_decode_base64<type>(const std::string& in);
 
 IMPL(char)
 IMPL(unsigned short)
@@ -198,10 +1086,19 @@ IMPL(float)
 IMPL(double)
 
 #define IMPL2(type) \
+template size_t encode_base64_2_into<type>(const type* in, size_t sz, char* out, size_t capacity); \
+template size_t decode_base64_2_into<type>(const char* in, size_t sz, type* out, size_t capacity); \
 template std::string encode_base64_2<type>(const type* in, size_t sz); \
 template std::string encode_base64_2<type>(const std::vector<type>& in); \
 template std::vector<type> decode_base64_2<type>(const char* in, size_t sz); \
-template std::vector<type> decode_base64_2<type>(const std::string& in);
+template std::vector<type> decode_base64_2<type>(const std::string& in); \
+template std::pmr::string encode_base64_2<type>(const type* in, size_t sz, std::pmr::memory_resource* resource); \
+template std::pmr::string encode_base64_2<type>(const std::vector<type>& in, std::pmr::memory_resource* resource); \
+template std::pmr::vector<type> decode_base64_2<type>(const char* in, size_t sz, std::pmr::memory_resource* resource); \
+template std::pmr::vector<type> decode_base64_2<type>(const std::pmr::string& in, std::pmr::memory_resource* resource); \
+template base64_result<size_t> try_decode_base64_2_into<type>(const char* in, size_t sz, type* out, size_t capacity); \
+template base64_result<std::vector<type>> try_decode_base64_2<type>(const char* in, size_t sz); \
+template base64_result<std::vector<type>> try_decode_base64_2<type>(const std::string& in);
 
 IMPL2(char)
 IMPL2(unsigned short)
@@ -212,10 +1109,46 @@ IMPL2(long)
 template struct free_deleter<char>;
 
 #define IMPL_RFC(type) \
+template size_t encode_base64_rfc_into<type>(const type* in, size_t sz, char* out, size_t capacity); \
+template size_t decode_base64_rfc_into<type>(const char* in, size_t sz, type* out, size_t capacity); \
 template std::unique_ptr<char, free_deleter<char>> encode_base64_rfc<type>(const type* in, size_t sz); \
 template std::unique_ptr<char, free_deleter<char>> encode_base64_rfc<type>(const std::vector<type>& in); \
 template std::vector<type> decode_base64_rfc<type>(const char* in, size_t sz); \
-template std::vector<type> decode_base64_rfc<type>(const std::string& in);
+template std::vector<type> decode_base64_rfc<type>(const std::string& in); \
+template std::pmr::string encode_base64_rfc<type>(const type* in, size_t sz, std::pmr::memory_resource* resource); \
+template std::pmr::string encode_base64_rfc<type>(const std::vector<type>& in, std::pmr::memory_resource* resource); \
+template std::pmr::vector<type> decode_base64_rfc<type>(const char* in, size_t sz, std::pmr::memory_resource* resource); \
+template std::pmr::vector<type> decode_base64_rfc<type>(const std::pmr::string& in, std::pmr::memory_resource* resource); \
+template base64_result<size_t> try_decode_base64_rfc_into<type>(const char* in, size_t sz, type* out, size_t capacity); \
+template base64_result<std::vector<type>> try_decode_base64_rfc<type>(const char* in, size_t sz); \
+template base64_result<std::vector<type>> try_decode_base64_rfc<type>(const std::string& in); \
+template std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_parallel<type>(const type* in, size_t sz, thread_pool& pool, size_t threshold); \
+template std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_parallel<type>(const std::vector<type>& in, thread_pool& pool, size_t threshold); \
+template std::vector<type> decode_base64_rfc_parallel<type>(const char* in, size_t sz, thread_pool& pool, size_t threshold); \
+template std::vector<type> decode_base64_rfc_parallel<type>(const std::string& in, thread_pool& pool, size_t threshold); \
+template size_t encode_base64_rfc_be_into<type>(const type* in, size_t sz, char* out, size_t capacity); \
+template size_t decode_base64_rfc_be_into<type>(const char* in, size_t sz, type* out, size_t capacity); \
+template std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_be<type>(const type* in, size_t sz); \
+template std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_be<type>(const std::vector<type>& in); \
+template std::vector<type> decode_base64_rfc_be<type>(const char* in, size_t sz); \
+template std::vector<type> decode_base64_rfc_be<type>(const std::string& in); \
+template std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_wrapped<type>(const type* in, size_t sz, size_t line, const char* eol); \
+template std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_wrapped<type>(const std::vector<type>& in, size_t line, const char* eol); \
+template std::vector<type> decode_base64_rfc_wrapped<type>(const char* in, size_t sz); \
+template std::vector<type> decode_base64_rfc_wrapped<type>(const std::string& in); \
+template size_t encoded_size_base85<type>(size_t sz); \
+template size_t decoded_size_base85<type>(size_t sz); \
+template size_t encode_base85_into<type>(const type* in, size_t sz, char* out, size_t capacity); \
+template size_t decode_base85_into<type>(const char* in, size_t sz, type* out, size_t capacity); \
+template std::unique_ptr<char, free_deleter<char>> encode_base85<type>(const type* in, size_t sz); \
+template std::unique_ptr<char, free_deleter<char>> encode_base85<type>(const std::vector<type>& in); \
+template std::vector<type> decode_base85<type>(const char* in, size_t sz); \
+template std::vector<type> decode_base85<type>(const std::string& in); \
+template std::string encode_base64_deflate<type>(const type* in, size_t sz, int level); \
+template std::string encode_base64_deflate<type>(const std::vector<type>& in, int level); \
+template std::vector<type> decode_base64_deflate<type>(const char* in, size_t sz); \
+template std::vector<type> decode_base64_deflate<type>(const std::string& in); \
+template class base64_view<type>;
 
 IMPL_RFC(char)
 IMPL_RFC(unsigned short)
@@ -224,3 +1157,64 @@ IMPL_RFC(long)
 IMPL_RFC(float)
 IMPL_RFC(double)
 
+base64_encoder::base64_encoder() { base64_encode_ctx_init(&ctx); }
+
+size_t base64_encoder::update_size(size_t sz) const
+{
+  return BASE64_ENCODE_UPDATE_LENGTH(&ctx, sz);
+}
+
+size_t base64_encoder::update(const char* in, size_t sz, char* out)
+{
+  return base64_encode_update(&ctx, in, sz, out);
+}
+
+size_t base64_encoder::finish(char* out)
+{
+  return base64_encode_finish(&ctx, out);
+}
+
+void base64_encoder::update(const char* in, size_t sz, std::string& out)
+{
+  size_t offset = out.size();
+  out.resize(offset + update_size(sz));
+  out.resize(offset + update(in, sz, &out[offset]));
+}
+
+void base64_encoder::finish(std::string& out)
+{
+  char tail[4];
+  out.append(tail, finish(tail));
+}
+
+base64_decoder::base64_decoder() { base64_decode_ctx_init(&ctx); }
+
+size_t base64_decoder::update_size(size_t sz) const
+{
+  return BASE64_DECODE_UPDATE_LENGTH(&ctx, sz);
+}
+
+size_t base64_decoder::update(const char* in, size_t sz, char* out)
+{
+  size_t written = 0;
+  if (!base64_decode_update(&ctx, in, sz, out, &written))
+    throw std::runtime_error("Input was not base64 encoded");
+
+  return written;
+}
+
+void base64_decoder::finish()
+{
+  bool ok = base64_decode_finish(&ctx);
+  base64_decode_ctx_init(&ctx);
+
+  if (!ok)
+    throw std::runtime_error("Input was not base64 encoded");
+}
+
+void base64_decoder::update(const char* in, size_t sz, std::vector<char>& out)
+{
+  size_t offset = out.size();
+  out.resize(offset + update_size(sz));
+  out.resize(offset + update(in, sz, out.data() + offset));
+}
@@ -4,6 +4,61 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <memory_resource>
+
+#ifndef RESTRICT
+#define RESTRICT
+#endif
+#include "base64.h"
+
+// Number of characters needed to encode sz elements of T, padding included.
+template<typename T>
+size_t encoded_size_base64(size_t sz);
+
+// Number of elements of T encoded in the sz characters of in.
+// Throws if they do not hold a whole number of elements.
+template<typename T>
+size_t decoded_size_base64(const char* in, size_t sz);
+
+// Reason why the try_decode_* functions rejected their input.
+enum class base64_errc
+{
+  none,
+  // A character out of the alphabet, or padding where the RFC decoder
+  // does not allow it.
+  invalid_character,
+  // The input stops within a quantum (RFC decoder only).
+  truncated,
+  // The decoded bytes do not make a whole number of elements.
+  invalid_size,
+  // The capacity given to a try_decode_*_into function is too small.
+  output_too_small,
+};
+
+struct base64_error
+{
+  base64_errc code;
+  // Offset of the invalid character, or size of the input for the other
+  // errors but output_too_small, for which it is 0.
+  size_t offset;
+};
+
+// Message of the exception thrown by the decoders for the same error.
+const char* base64_error_message(base64_errc code);
+
+// Result of the try_decode_* functions, which return errors instead of
+// throwing them: the decoded value if the error code is none, a default
+// one otherwise.
+template<typename V>
+struct base64_result
+{
+  V value;
+  base64_error error;
+
+  bool has_value() const { return error.code == base64_errc::none; }
+  explicit operator bool() const { return has_value(); }
+};
+
 
 template<typename T>
 std::string encode_base64(const T* in, size_t sz);
@@ -17,6 +72,41 @@ std::vector<T> decode_base64(const char* in, size_t sz);
 template<typename T>
 std::vector<T> decode_base64(const std::string& in);
 
+// The *_into functions write to a caller-provided buffer of capacity
+// elements instead of allocating, and return the number of elements
+// written. Encoded data is not zero-terminated. They throw if the buffer
+// is too small.
+template<typename T>
+size_t encode_base64_into(const T* in, size_t sz, char* out, size_t capacity);
+
+template<typename T>
+size_t decode_base64_into(const char* in, size_t sz, T* out, size_t capacity);
+
+// The overloads taking a memory resource allocate their output from it,
+// e.g. from a std::pmr::monotonic_buffer_resource scoped to a request.
+template<typename T>
+std::pmr::string encode_base64(const T* in, size_t sz, std::pmr::memory_resource* resource);
+
+template<typename T>
+std::pmr::string encode_base64(const std::vector<T>& in, std::pmr::memory_resource* resource);
+
+template<typename T>
+std::pmr::vector<T> decode_base64(const char* in, size_t sz, std::pmr::memory_resource* resource);
+
+template<typename T>
+std::pmr::vector<T> decode_base64(const std::pmr::string& in, std::pmr::memory_resource* resource);
+
+// Non-throwing decoders: see base64_result. The input is checked before
+// being given to the Boost iterators, which throw on invalid characters.
+template<typename T>
+base64_result<std::vector<T>> try_decode_base64(const char* in, size_t sz);
+
+template<typename T>
+base64_result<std::vector<T>> try_decode_base64(const std::string& in);
+
+template<typename T>
+base64_result<size_t> try_decode_base64_into(const char* in, size_t sz, T* out, size_t capacity);
+
 
 template<typename T>
 std::string encode_base64_2(const T* in, size_t sz);
@@ -30,6 +120,33 @@ std::vector<T> decode_base64_2(const char* in, size_t sz);
 template<typename T>
 std::vector<T> decode_base64_2(const std::string& in);
 
+template<typename T>
+size_t encode_base64_2_into(const T* in, size_t sz, char* out, size_t capacity);
+
+template<typename T>
+size_t decode_base64_2_into(const char* in, size_t sz, T* out, size_t capacity);
+
+template<typename T>
+std::pmr::string encode_base64_2(const T* in, size_t sz, std::pmr::memory_resource* resource);
+
+template<typename T>
+std::pmr::string encode_base64_2(const std::vector<T>& in, std::pmr::memory_resource* resource);
+
+template<typename T>
+std::pmr::vector<T> decode_base64_2(const char* in, size_t sz, std::pmr::memory_resource* resource);
+
+template<typename T>
+std::pmr::vector<T> decode_base64_2(const std::pmr::string& in, std::pmr::memory_resource* resource);
+
+template<typename T>
+base64_result<std::vector<T>> try_decode_base64_2(const char* in, size_t sz);
+
+template<typename T>
+base64_result<std::vector<T>> try_decode_base64_2(const std::string& in);
+
+template<typename T>
+base64_result<size_t> try_decode_base64_2_into(const char* in, size_t sz, T* out, size_t capacity);
+
 
 template<typename T>
 struct free_deleter
@@ -49,4 +166,275 @@ std::vector<T> decode_base64_rfc(const char* in, size_t sz);
 template<typename T>
 std::vector<T> decode_base64_rfc(const std::string& in);
 
+template<typename T>
+size_t encode_base64_rfc_into(const T* in, size_t sz, char* out, size_t capacity);
+
+template<typename T>
+size_t decode_base64_rfc_into(const char* in, size_t sz, T* out, size_t capacity);
+
+// Unlike encode_base64_rfc, the encoded data is returned as a string, not
+// zero-terminated memory from malloc.
+template<typename T>
+std::pmr::string encode_base64_rfc(const T* in, size_t sz, std::pmr::memory_resource* resource);
+
+template<typename T>
+std::pmr::string encode_base64_rfc(const std::vector<T>& in, std::pmr::memory_resource* resource);
+
+template<typename T>
+std::pmr::vector<T> decode_base64_rfc(const char* in, size_t sz, std::pmr::memory_resource* resource);
+
+template<typename T>
+std::pmr::vector<T> decode_base64_rfc(const std::pmr::string& in, std::pmr::memory_resource* resource);
+
+// Non-throwing decoders: see base64_result. Valid input is decoded in a
+// single pass; base64_validate locates the error of invalid input.
+template<typename T>
+base64_result<std::vector<T>> try_decode_base64_rfc(const char* in, size_t sz);
+
+template<typename T>
+base64_result<std::vector<T>> try_decode_base64_rfc(const std::string& in);
+
+template<typename T>
+base64_result<size_t> try_decode_base64_rfc_into(const char* in, size_t sz, T* out, size_t capacity);
+
+// Same as decode_base64_rfc<char>, decoding the characters over the front of
+// the buffer that holds them, which is then shrunk to the decoded bytes and
+// returned: the peak memory is the one of the input alone. The capacity of
+// the buffer is kept.
+std::string decode_base64_rfc_inplace(std::string&& in);
+std::vector<char> decode_base64_rfc_inplace(std::vector<char>&& in);
+
+
+// Same as the RFC functions, with each element encoded most significant
+// byte first (network byte order) whatever the byte order of the machine,
+// like encode_base64_2 but for every arithmetic type, floating ones
+// included. The bytes are swapped by the encoding and decoding loops
+// themselves: see base64_encode_be.
+template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_be(const T* in, size_t sz);
+
+template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_be(const std::vector<T>& in);
+
+template<typename T>
+std::vector<T> decode_base64_rfc_be(const char* in, size_t sz);
+
+template<typename T>
+std::vector<T> decode_base64_rfc_be(const std::string& in);
+
+template<typename T>
+size_t encode_base64_rfc_be_into(const T* in, size_t sz, char* out, size_t capacity);
+
+template<typename T>
+size_t decode_base64_rfc_be_into(const char* in, size_t sz, T* out, size_t capacity);
+
+
+// Same as encode_base64_rfc, ending every line of line characters, the last
+// one included, with eol, as in MIME (RFC 2045) messages or PEM files. A
+// line of 0 disables the wrapping.
+template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_wrapped(const T* in, size_t sz,
+                                                                    size_t line = BASE64_MIME_LINE_LENGTH,
+                                                                    const char* eol = "\r\n");
+
+template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_wrapped(const std::vector<T>& in,
+                                                                    size_t line = BASE64_MIME_LINE_LENGTH,
+                                                                    const char* eol = "\r\n");
+
+// Same as decode_base64_rfc, skipping the whitespace found anywhere in the
+// input, line terminators included.
+template<typename T>
+std::vector<T> decode_base64_rfc_wrapped(const char* in, size_t sz);
+
+template<typename T>
+std::vector<T> decode_base64_rfc_wrapped(const std::string& in);
+
+
+// Same as the RFC functions, with the Z85 alphabet of base85.h: every 4
+// bytes take 5 characters instead of the 5.33 of base64, and a last group
+// of n bytes n + 1 characters, without padding.
+
+// Number of characters needed to encode sz elements of T.
+template<typename T>
+size_t encoded_size_base85(size_t sz);
+
+// Number of elements of T encoded in sz characters. Throws if sz cannot be
+// the size of encoded data, or if they do not hold a whole number of
+// elements.
+template<typename T>
+size_t decoded_size_base85(size_t sz);
+
+template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base85(const T* in, size_t sz);
+
+template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base85(const std::vector<T>& in);
+
+template<typename T>
+std::vector<T> decode_base85(const char* in, size_t sz);
+
+template<typename T>
+std::vector<T> decode_base85(const std::string& in);
+
+template<typename T>
+size_t encode_base85_into(const T* in, size_t sz, char* out, size_t capacity);
+
+template<typename T>
+size_t decode_base85_into(const char* in, size_t sz, T* out, size_t capacity);
+
+
+// Compact encoding of arrays of T, for data that would be compressed
+// anyway: the bytes of the elements are shuffled as in Blosc (the first
+// byte of every element, then the second...), which gathers the slowly
+// varying bytes of smooth signals, deflated by zlib at the given level (-1
+// for its default), and the compressed stream is encoded as by
+// encode_base64_rfc, without terminating zero. The stages work chunk by
+// chunk, so no whole intermediate buffer is built. Decoding throws if the
+// input is not base64 encoded or its compressed stream is invalid.
+template<typename T>
+std::string encode_base64_deflate(const T* in, size_t sz, int level = -1);
+
+template<typename T>
+std::string encode_base64_deflate(const std::vector<T>& in, int level = -1);
+
+template<typename T>
+std::vector<T> decode_base64_deflate(const char* in, size_t sz);
+
+template<typename T>
+std::vector<T> decode_base64_deflate(const std::string& in);
+
+
+// Read-only view of the elements of T encoded by encode_base64_rfc in the
+// sz characters at in, which must outlive it. Every 4 characters hold 3
+// bytes, so the elements are decoded on access, from the quanta covering
+// them only, without decoding the ones before. Invalid characters are only
+// found in the quanta that are decoded.
+template<typename T>
+class base64_view
+{
+public:
+  // Throws if the characters do not hold a whole number of elements.
+  base64_view(const char* in, size_t sz);
+  explicit base64_view(const std::string& in);
+  base64_view(std::string&&) = delete;
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  // Element i, which must be lower than size().
+  T operator[](size_t i) const;
+
+  // Decodes the count elements from first to out. Throws if they are not
+  // all in the view, or if their quanta are invalid.
+  void decode_range(size_t first, size_t count, T* out) const;
+  std::vector<T> decode_range(size_t first, size_t count) const;
+
+private:
+  // Decodes the bytes from begin to end, found in the same quantum.
+  void decode_partial(size_t begin, size_t end, char* out) const;
+
+  const char* in;
+  size_t sz;
+  size_t count;
+};
+
+
+// Many short messages encoded or decoded back to back in a single buffer
+// by the *_batch functions: message i is the size(i) bytes at data(i).
+struct base64_batch
+{
+  size_t count() const { return offsets.size() - 1; }
+  const char* data(size_t i) const { return buffer.get() + offsets[i]; }
+  size_t size(size_t i) const { return offsets[i + 1] - offsets[i]; }
+
+  std::unique_ptr<char, free_deleter<char>> buffer;
+  std::vector<size_t> offsets;
+};
+
+// Same as calling encode_base64_rfc/decode_base64_rfc<char> on each of the
+// n messages of sz[i] bytes at in[i], with a single allocation and without
+// terminating zeros. The vectorized kernels fill their lanes from several
+// messages at once, which pays off on messages shorter than a few hundred
+// bytes. Decoding throws if one of the messages is invalid.
+base64_batch encode_base64_rfc_batch(const char* const* in, const size_t* sz, size_t n);
+base64_batch encode_base64_rfc_batch(const std::vector<std::string>& in);
+
+base64_batch decode_base64_rfc_batch(const char* const* in, const size_t* sz, size_t n);
+base64_batch decode_base64_rfc_batch(const base64_batch& in);
+
+
+class thread_pool;
+
+// Inputs of fewer bytes than this are processed by the calling thread only
+// by the *_parallel functions.
+constexpr size_t default_parallel_threshold = 4 << 20;
+
+// Same as encode_base64_rfc/decode_base64_rfc, with the input split on
+// quantum boundaries across the threads of pool, each slice being written
+// directly at its final offset of the output.
+template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_parallel(const T* in, size_t sz, thread_pool& pool,
+                                                                     size_t threshold = default_parallel_threshold);
+
+template<typename T>
+std::unique_ptr<char, free_deleter<char>> encode_base64_rfc_parallel(const std::vector<T>& in, thread_pool& pool,
+                                                                     size_t threshold = default_parallel_threshold);
+
+template<typename T>
+std::vector<T> decode_base64_rfc_parallel(const char* in, size_t sz, thread_pool& pool,
+                                          size_t threshold = default_parallel_threshold);
+
+template<typename T>
+std::vector<T> decode_base64_rfc_parallel(const std::string& in, thread_pool& pool,
+                                          size_t threshold = default_parallel_threshold);
+
+// Incremental RFC encoder: the input may be split anywhere, the output is
+// the same as the one of encode_base64_rfc on the whole input.
+class base64_encoder
+{
+public:
+  base64_encoder();
+
+  // Largest number of characters written by update(in, sz, out).
+  size_t update_size(size_t sz) const;
+
+  // Encodes the whole 3-byte groups available so far, and returns the
+  // number of characters written to out.
+  size_t update(const char* in, size_t sz, char* out);
+
+  // Encodes the remaining bytes with padding, and returns the number of
+  // characters (at most 4) written to out. The encoder can then be reused.
+  size_t finish(char* out);
+
+  void update(const char* in, size_t sz, std::string& out);
+  void finish(std::string& out);
+
+private:
+  base64_encode_context ctx;
+};
+
+// Incremental RFC decoder, throwing as soon as the input is found invalid.
+class base64_decoder
+{
+public:
+  base64_decoder();
+
+  // Largest number of bytes written by update(in, sz, out).
+  size_t update_size(size_t sz) const;
+
+  // Decodes the whole quanta available so far, and returns the number of
+  // bytes written to out.
+  size_t update(const char* in, size_t sz, char* out);
+
+  // Throws if the input did not end on a whole quantum. The decoder can
+  // then be reused.
+  void finish();
+
+  void update(const char* in, size_t sz, std::vector<char>& out);
+
+private:
+  base64_decode_context ctx;
+};
+
 #endif
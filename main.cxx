@@ -10,6 +10,10 @@
 #include "base64.h"
 
 #include "impl.hxx"
+#include "base64_alphabet.hxx"
+#include "base64_archive.hxx"
+#include "base64_pipeline.hxx"
+#include "thread_pool.hxx"
 
 #include <sstream>
 #include <iostream>
@@ -21,6 +25,7 @@
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <memory_resource>
 #include <random>
 #include <type_traits>
 
@@ -83,6 +88,43 @@ TEST_P(s8VectorBase64Serialization, RFC) {
   ASSERT_EQ(decode_base64_rfc<char>(encoded), plain);
 }
 
+TEST_P(s8VectorBase64Serialization, Into) {
+  std::string out(encoded_size_base64<char>(plain.size()) + 1, '#');
+  std::vector<char> decoded(plain.size() + 1, '#');
+
+  ASSERT_EQ(encoded.size(), encode_base64_into(plain.data(), plain.size(), &out[0], out.size()));
+  EXPECT_EQ(encoded + '#', out);
+  ASSERT_EQ(plain.size(), decode_base64_into(encoded.data(), encoded.size(), decoded.data(), decoded.size()));
+  EXPECT_EQ(plain, std::vector<char>(decoded.begin(), decoded.end() - 1));
+
+  out.assign(out.size(), '#');
+  ASSERT_EQ(encoded.size(), encode_base64_2_into(plain.data(), plain.size(), &out[0], out.size()));
+  EXPECT_EQ(encoded + '#', out);
+  ASSERT_EQ(plain.size(), decode_base64_2_into(encoded.data(), encoded.size(), decoded.data(), decoded.size()));
+  EXPECT_EQ(plain, std::vector<char>(decoded.begin(), decoded.end() - 1));
+
+  out.assign(out.size(), '#');
+  ASSERT_EQ(encoded.size(), encode_base64_rfc_into(plain.data(), plain.size(), &out[0], out.size()));
+  EXPECT_EQ(encoded + '#', out);
+  ASSERT_EQ(plain.size(), decode_base64_rfc_into(encoded.data(), encoded.size(), decoded.data(), decoded.size()));
+  EXPECT_EQ(plain, std::vector<char>(decoded.begin(), decoded.end() - 1));
+}
+
+TEST_P(s8VectorBase64Serialization, IntoTooSmall) {
+  if (plain.empty())
+    return;
+
+  std::string out(encoded.size() - 1, '#');
+  std::vector<char> decoded(plain.size() - 1);
+
+  EXPECT_THROW(encode_base64_into(plain.data(), plain.size(), &out[0], out.size()), std::runtime_error);
+  EXPECT_THROW(decode_base64_into(encoded.data(), encoded.size(), decoded.data(), decoded.size()), std::runtime_error);
+  EXPECT_THROW(encode_base64_2_into(plain.data(), plain.size(), &out[0], out.size()), std::runtime_error);
+  EXPECT_THROW(decode_base64_2_into(encoded.data(), encoded.size(), decoded.data(), decoded.size()), std::runtime_error);
+  EXPECT_THROW(encode_base64_rfc_into(plain.data(), plain.size(), &out[0], out.size()), std::runtime_error);
+  EXPECT_THROW(decode_base64_rfc_into(encoded.data(), encoded.size(), decoded.data(), decoded.size()), std::runtime_error);
+}
+
 std::vector<std::pair<std::vector<char>, std::string>> base64_s8_cases = {
   {{}, ""}, 
   {{'f'}, "Zg=="},
@@ -96,6 +138,826 @@ INSTANTIATE_TEST_CASE_P(_, s8VectorBase64Serialization, ::testing::ValuesIn(base
 
 
 
+class RFCBackend : public ::testing::TestWithParam<base64_backend> {
+public:
+  void SetUp() override {
+    if (!base64_set_backend(GetParam()))
+      GTEST_SKIP() << base64_backend_name(GetParam()) << " is not supported";
+  }
+  void TearDown() override { base64_set_backend(BASE64_BACKEND_AUTO); }
+};
+
+TEST_P(RFCBackend, MatchesBoost) {
+  for(size_t sz = 0; sz < 256; ++sz) {
+    const std::vector<char> in = random_vector<char>(sz);
+    const std::string encoded = encode_base64(in);
+    ASSERT_EQ(encode_base64_rfc(in).get(), encoded) << "size " << sz;
+    ASSERT_EQ(decode_base64_rfc<char>(encoded), in) << "size " << sz;
+  }
+}
+
+TEST_P(RFCBackend, TruncatedOutput) {
+  const std::vector<char> in = random_vector<char>(100);
+  const std::string encoded = encode_base64(in);
+
+  for(size_t outlen = 0; outlen <= encoded.size() + 1; ++outlen) {
+    std::vector<char> out(outlen + 1, '#');
+    base64_encode(in.data(), in.size(), out.data(), outlen);
+    const std::string expected = outlen > encoded.size()
+      ? encoded + '\0' + '#'
+      : encoded.substr(0, outlen) + '#';
+    ASSERT_EQ(std::string(out.data(), out.size()), expected) << "outlen " << outlen;
+  }
+}
+
+// Padded input streamed into buffers of exactly update_size() bytes, which
+// the kernels must not store past.
+TEST_P(RFCBackend, StreamingExactBuffer) {
+  for(size_t sz : {31, 32, 100, 1000, 1001}) {
+    const std::vector<char> in = random_vector<char>(sz);
+    const std::string encoded = encode_base64_rfc(in).get();
+
+    for(size_t chunk : {size_t(64), encoded.size()}) {
+      base64_decoder decoder;
+      std::vector<char> decoded;
+      for(size_t i = 0; i < encoded.size(); i += chunk) {
+        const size_t n = std::min(chunk, encoded.size() - i);
+        std::unique_ptr<char[]> out(new char[decoder.update_size(n)]);
+        decoded.insert(decoded.end(), out.get(), out.get() + decoder.update(encoded.data() + i, n, out.get()));
+      }
+      decoder.finish();
+      ASSERT_EQ(decoded, in) << "size " << sz << ", chunk " << chunk;
+    }
+  }
+}
+
+// Decodes IN with the scalar backend, then with the one under test, and
+// checks both report the same status and the same partial output.
+static void expect_same_decoding(const std::string& in, const std::string& what) {
+  const base64_backend backend = base64_get_backend();
+  std::vector<char> expected(in.size()), actual(in.size());
+  size_t expected_size = expected.size(), actual_size = actual.size();
+
+  base64_set_backend(BASE64_BACKEND_SCALAR);
+  const bool expected_ok = base64_decode(in.data(), in.size(), expected.data(), &expected_size);
+  base64_set_backend(backend);
+  const bool actual_ok = base64_decode(in.data(), in.size(), actual.data(), &actual_size);
+
+  ASSERT_EQ(actual_ok, expected_ok) << what;
+  ASSERT_EQ(actual_size, expected_size) << what;
+  expected.resize(expected_size);
+  actual.resize(actual_size);
+  ASSERT_EQ(actual, expected) << what;
+}
+
+TEST_P(RFCBackend, InvalidCharacter) {
+  const std::string encoded = encode_base64(random_vector<char>(150));
+
+  for(int c = 0; c < 256; ++c) {
+    std::string in = encoded;
+    in[37] = static_cast<char>(c);
+    expect_same_decoding(in, "character " + std::to_string(c));
+    if (!isbase64(static_cast<char>(c))) {
+      ASSERT_THROW(decode_base64_rfc<char>(in), std::runtime_error) << "character " << c;
+    }
+  }
+
+  for(size_t pos = 0; pos < encoded.size(); ++pos) {
+    std::string in = encoded;
+    in[pos] = '!';
+    expect_same_decoding(in, "position " + std::to_string(pos));
+  }
+}
+
+// Checks the big-endian encoding of every size of vector up to 100
+// elements against the RFC encoding of the elements swapped beforehand.
+template<typename T>
+static void expect_big_endian_encoding() {
+  for(size_t sz = 0; sz < 100; ++sz) {
+    const std::vector<T> in = random_vector<T>(sz);
+    std::vector<char> swapped(reinterpret_cast<const char*>(in.data()), reinterpret_cast<const char*>(in.data() + sz));
+    for(size_t i = 0; i < swapped.size(); i += sizeof(T))
+      std::reverse(swapped.begin() + i, swapped.begin() + i + sizeof(T));
+    const std::string encoded = encode_base64_rfc(swapped).get();
+
+    ASSERT_EQ(encode_base64_rfc_be(in).get(), encoded) << "size " << sz;
+    ASSERT_EQ(decode_base64_rfc_be<T>(encoded), in) << "size " << sz;
+
+    if (sz > 0) {
+      std::string corrupted = encoded;
+      corrupted[encoded.size() / 2] = '!';
+      ASSERT_THROW(decode_base64_rfc_be<T>(corrupted), std::runtime_error) << "size " << sz;
+    }
+  }
+}
+
+TEST_P(RFCBackend, BigEndian) {
+  expect_big_endian_encoding<char>();
+  expect_big_endian_encoding<unsigned short>();
+  expect_big_endian_encoding<int>();
+  expect_big_endian_encoding<long>();
+  expect_big_endian_encoding<float>();
+  expect_big_endian_encoding<double>();
+
+  // Padding is only allowed at the end, even past the kernels' blocks.
+  const std::string encoded = encode_base64_rfc_be(random_vector<double>(200)).get();
+  EXPECT_THROW(decode_base64_rfc_be<double>("AAAAAAAAAA==" + encoded.substr(0, 1060)), std::runtime_error);
+  EXPECT_THROW(decode_base64_rfc_be<double>(encoded.substr(0, 1020) + "AA==" + encoded.substr(0, 48)), std::runtime_error);
+}
+
+// Inserts eol after every line characters of encoded and at its end.
+static std::string wrap(const std::string& encoded, size_t line, const std::string& eol) {
+  std::string wrapped;
+  for(size_t i = 0; i < encoded.size(); i += line)
+    wrapped += encoded.substr(i, line) + eol;
+  return wrapped;
+}
+
+TEST_P(RFCBackend, Wrapped) {
+  std::vector<size_t> sizes;
+  for(size_t sz = 0; sz < 200; ++sz)
+    sizes.push_back(sz);
+  // Long enough for whole lines to be encoded in place.
+  sizes.push_back(10000);
+  sizes.push_back(10001);
+
+  for(size_t sz : sizes) {
+    const std::vector<char> in = random_vector<char>(sz);
+    const std::string encoded = encode_base64(in);
+
+    for(auto line : {std::make_pair(size_t(76), "\r\n"), std::make_pair(size_t(64), "\n"), std::make_pair(size_t(70), "\r\n"), std::make_pair(size_t(5), "\n")}) {
+      const std::string wrapped = wrap(encoded, line.first, line.second);
+      ASSERT_EQ(encode_base64_rfc_wrapped(in, line.first, line.second).get(), wrapped) << "size " << sz;
+      ASSERT_EQ(decode_base64_rfc_wrapped<char>(wrapped), in) << "size " << sz;
+    }
+    ASSERT_EQ(encode_base64_rfc_wrapped(in, 0).get(), encoded) << "size " << sz;
+    ASSERT_EQ(decode_base64_rfc_wrapped<char>(encoded), in) << "size " << sz;
+  }
+
+  // Truncated outputs hold the start of the wrapped data, whose lines
+  // the kernels must not write past.
+  const std::vector<char> data = random_vector<char>(1000);
+  const std::string wrapped = wrap(encode_base64(data), 76, "\r\n");
+  for(size_t outlen = wrapped.size() - 200; outlen <= wrapped.size() + 1; ++outlen) {
+    std::vector<char> out(outlen + 1, '#');
+    base64_encode_wrapped(data.data(), data.size(), out.data(), outlen, 76, "\r\n");
+    const std::string expected = outlen > wrapped.size()
+      ? wrapped + '\0' + '#'
+      : wrapped.substr(0, outlen) + '#';
+    ASSERT_EQ(std::string(out.data(), out.size()), expected) << "outlen " << outlen;
+  }
+
+  const std::vector<int> in = random_vector<int>(1000);
+  std::string spaced = encode_base64_rfc(in).get();
+  for(size_t i = spaced.size(); i > 0; i -= std::min<size_t>(i, 7))
+    spaced.insert(i, i % 2 ? " \t" : "\r\n\f\v");
+  EXPECT_EQ(decode_base64_rfc_wrapped<int>(spaced), in);
+
+  EXPECT_EQ(decode_base64_rfc_wrapped<char>(std::string(" Zm9v\nYg =\n=\n\n")), std::vector<char>({'f', 'o', 'o', 'b'}));
+  EXPECT_THROW(decode_base64_rfc_wrapped<char>(std::string("Zm9v\nYg==\nZm9v\n")), std::runtime_error);
+  EXPECT_THROW(decode_base64_rfc_wrapped<char>(wrap(std::string(5000, 'A') + "!AAA", 76, "\r\n")), std::runtime_error);
+  // Lines whose terminator changes, after the kernels have learnt it.
+  std::string mixed = wrap(encode_base64(data), 76, "\r\n");
+  for(size_t i = 20 * 78 + 76; i < mixed.size(); i += 5 * 78)
+    mixed.replace(i, 2, "\n\n");
+  EXPECT_EQ(decode_base64_rfc_wrapped<char>(mixed), data);
+  EXPECT_THROW(decode_base64_rfc_wrapped<char>(std::string("Zm9vY\n")), std::runtime_error);
+}
+
+TEST_P(RFCBackend, Batch) {
+  // Sizes around the lane and vector widths, an empty message, and
+  // consecutive short messages that share a vector.
+  std::vector<std::string> messages;
+  const std::vector<char> data = random_vector<char>(1000);
+  for(size_t sz : {0, 1, 2, 3, 11, 12, 13, 15, 16, 17, 24, 28, 0, 100, 200, 5, 999, 4, 1})
+    messages.emplace_back(data.begin(), data.begin() + sz);
+  for(size_t sz = 0; sz < 80; ++sz)
+    messages.emplace_back(data.begin() + sz, data.begin() + 2 * sz);
+
+  const base64_batch encoded = encode_base64_rfc_batch(messages);
+  ASSERT_EQ(encoded.count(), messages.size());
+  for(size_t i = 0; i < messages.size(); ++i) {
+    ASSERT_EQ(std::string(encoded.data(i), encoded.size(i)), encode_base64(messages[i].data(), messages[i].size())) << "message " << i;
+    if (i > 0) {
+      ASSERT_EQ(encoded.data(i), encoded.data(i - 1) + encoded.size(i - 1));
+    }
+  }
+
+  const base64_batch decoded = decode_base64_rfc_batch(encoded);
+  ASSERT_EQ(decoded.count(), messages.size());
+  for(size_t i = 0; i < messages.size(); ++i)
+    ASSERT_EQ(std::string(decoded.data(i), decoded.size(i)), messages[i]) << "message " << i;
+
+  EXPECT_EQ(encode_base64_rfc_batch(std::vector<std::string>()).count(), 0u);
+
+  // An invalid message anywhere in the batch, or padding within a message.
+  for(const char* invalid : {"Zm9v!mFy", "Zm9", "Zg==Zg==", "Z===", "===="}) {
+    for(size_t at : {0, 3, 6}) {
+      std::vector<const char*> in(7, "Zm9vYmFyZm9vYmFyZm9vYmFy");
+      std::vector<size_t> sz(7, strlen(in[0]));
+      in[at] = invalid;
+      sz[at] = strlen(invalid);
+      EXPECT_THROW(decode_base64_rfc_batch(in.data(), sz.data(), in.size()), std::runtime_error) << invalid << " at " << at;
+
+      std::vector<size_t> offsets(in.size() + 1);
+      std::vector<char> out(1000);
+      EXPECT_EQ(base64_decode_batch(in.data(), sz.data(), in.size(), out.data(), out.size(), offsets.data()), at);
+    }
+  }
+}
+
+TEST_P(RFCBackend, InPlace) {
+  std::vector<size_t> sizes;
+  for(size_t sz = 0; sz < 300; ++sz)
+    sizes.push_back(sz);
+  sizes.push_back(100000);
+
+  for(size_t sz : sizes) {
+    const std::vector<char> in = random_vector<char>(sz);
+    const std::string encoded = encode_base64(in);
+
+    std::string buffer = encoded;
+    const char* data = buffer.data();
+    const std::string decoded = decode_base64_rfc_inplace(std::move(buffer));
+    ASSERT_EQ(decoded, std::string(in.begin(), in.end())) << "size " << sz;
+    if (sz > 16) {
+      ASSERT_EQ(decoded.data(), data) << "size " << sz;
+    }
+
+    ASSERT_EQ(decode_base64_rfc_inplace(std::vector<char>(encoded.begin(), encoded.end())), in) << "size " << sz;
+  }
+
+  const std::string encoded = encode_base64(random_vector<char>(300));
+  for(size_t pos = 0; pos < encoded.size(); pos += 7) {
+    std::string in = encoded;
+    in[pos] = '!';
+    ASSERT_THROW(decode_base64_rfc_inplace(std::move(in)), std::runtime_error) << "position " << pos;
+  }
+  EXPECT_THROW(decode_base64_rfc_inplace(std::string("Zg==Zg==")), std::runtime_error);
+}
+
+TEST_P(RFCBackend, Validate) {
+  for(size_t sz = 0; sz < 300; ++sz) {
+    const std::string encoded = encode_base64(random_vector<char>(sz));
+    size_t outlen = 0, offset = 0;
+    ASSERT_TRUE(base64_validate(encoded.data(), encoded.size(), &outlen, &offset)) << "size " << sz;
+    ASSERT_EQ(outlen, sz);
+  }
+
+  // The first invalid character is reported, followed by another one,
+  // wherever the kernels' blocks end, and the verdict is always the one of
+  // base64_decode.
+  const std::string encoded = encode_base64(random_vector<char>(200));
+  for(size_t pos = 0; pos + 4 < encoded.size(); ++pos) {
+    for(char c : {'!', '=', '\n', '\x80'}) {
+      std::string in = encoded;
+      in[pos] = c;
+      in[pos + 2 + (encoded.size() - pos) / 2] = '!';
+      std::vector<char> out(in.size());
+      size_t outlen = out.size(), offset = 0;
+      const bool ok = base64_decode(in.data(), in.size(), out.data(), &outlen);
+      ASSERT_EQ(base64_validate(in.data(), in.size(), nullptr, &offset), ok) << "position " << pos;
+      ASSERT_EQ(offset, c == '=' && pos % 4 >= 2 ? pos + 1 : pos) << "position " << pos;
+    }
+  }
+
+  const std::vector<std::pair<std::string, size_t>> invalid = {
+    {"Z", 1}, {"Zm9", 3}, {"Zg=", 3}, {"Zm9vY", 5}, {"=", 0}, {"Z===", 1},
+    {"Zg=A", 3}, {"Zg==Zm9v", 4}, {"Zm9=Zg==", 4}, {"Zm9v!", 4}};
+  for(const auto& c : invalid) {
+    size_t outlen = 42, offset = 0;
+    EXPECT_FALSE(base64_validate(c.first.data(), c.first.size(), &outlen, &offset)) << c.first;
+    EXPECT_EQ(offset, c.second) << c.first;
+    EXPECT_EQ(outlen, 42u) << c.first;
+  }
+
+  for(const auto& c : std::vector<std::pair<std::string, size_t>>{{"", 0}, {"Zg==", 1}, {"Zm8=", 2}, {"Zm9v", 3}}) {
+    size_t outlen = 0;
+    EXPECT_TRUE(base64_validate(c.first.data(), c.first.size(), &outlen, nullptr)) << c.first;
+    EXPECT_EQ(outlen, c.second) << c.first;
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(_, RFCBackend, ::testing::Values(BASE64_BACKEND_SCALAR,
+                                                         BASE64_BACKEND_SWAR,
+                                                         BASE64_BACKEND_SSSE3,
+                                                         BASE64_BACKEND_AVX2));
+
+
+
+// The digits first, then the letters, then '.' and '~': not handled by the
+// vectorized kernels.
+struct reversed_alphabet
+{
+  static constexpr char symbol(unsigned value)
+  {
+    return "0123456789zyxwvutsrqponmlkjihgfedcbaZYXWVUTSRQPONMLKJIHGFEDCBA.~"[value];
+  }
+};
+
+class RFCAlphabet : public RFCBackend {};
+
+TEST_P(RFCAlphabet, StandardMatchesRFC) {
+  for(size_t sz = 0; sz < 256; ++sz) {
+    const std::vector<char> in = random_vector<char>(sz);
+    const std::string encoded = encode_base64_with<base64_standard_alphabet>(in);
+    ASSERT_EQ(encoded, encode_base64_rfc(in).get()) << "size " << sz;
+    ASSERT_EQ((decode_base64_with<char, base64_standard_alphabet>(encoded)), in) << "size " << sz;
+  }
+}
+
+TEST_P(RFCAlphabet, URLSafe) {
+  for(size_t sz = 0; sz < 256; ++sz) {
+    const std::vector<char> in = random_vector<char>(sz);
+    std::string expected = encode_base64_rfc(in).get();
+    std::replace(expected.begin(), expected.end(), '+', '-');
+    std::replace(expected.begin(), expected.end(), '/', '_');
+    ASSERT_EQ(encode_base64_with<base64_url_alphabet>(in), expected) << "size " << sz;
+
+    expected.erase(expected.find_last_not_of('=') + 1);
+    const std::string encoded = encode_base64_with<base64_url_alphabet, base64_unpadded>(in);
+    ASSERT_EQ(encoded, expected) << "size " << sz;
+    ASSERT_EQ((decode_base64_with<char, base64_url_alphabet, base64_unpadded>(encoded)), in) << "size " << sz;
+  }
+}
+
+TEST_P(RFCAlphabet, Custom) {
+  EXPECT_EQ(encode_base64_with<reversed_alphabet>(std::string("\x00\x10\x83\xff", 4).c_str(), 4), "0123~N==");
+
+  for(size_t sz = 0; sz < 256; ++sz) {
+    const std::vector<char> in = random_vector<char>(sz);
+    const std::string encoded = encode_base64_with<reversed_alphabet, base64_unpadded>(in);
+    ASSERT_EQ((decode_base64_with<char, reversed_alphabet, base64_unpadded>(encoded)), in) << "size " << sz;
+  }
+}
+
+TEST_P(RFCAlphabet, InvalidInput) {
+  using url = base64_codec<base64_url_alphabet, base64_unpadded>;
+  using padded_url = base64_codec<base64_url_alphabet, base64_padded>;
+  const std::string encoded = encode_base64_with<base64_url_alphabet, base64_unpadded>(random_vector<char>(150));
+  std::vector<char> out(encoded.size());
+
+  auto decodes = [&out](auto codec, const std::string& in) {
+    size_t outlen = out.size();
+    return decltype(codec)::decode(in.data(), in.size(), out.data(), &outlen);
+  };
+
+  ASSERT_TRUE(decodes(url(), encoded));
+  for(size_t pos = 0; pos < encoded.size(); ++pos) {
+    for(char c : {'+', '/', '=', '!', '\x80'}) {
+      std::string in = encoded;
+      in[pos] = c;
+      ASSERT_FALSE(decodes(url(), in)) << "character " << int(c) << " at " << pos;
+    }
+  }
+
+  EXPECT_FALSE(decodes(url(), "Zm9vY"));
+  EXPECT_TRUE(decodes(url(), "Zm9vYg"));
+  EXPECT_FALSE(decodes(padded_url(), "Zm9vYg"));
+  EXPECT_TRUE(decodes(padded_url(), "Zm9vYg=="));
+  EXPECT_FALSE(decodes(padded_url(), "Zm9vY==="));
+  EXPECT_FALSE(decodes(padded_url(), "Zg==Zm9v"));
+}
+
+INSTANTIATE_TEST_CASE_P(_, RFCAlphabet, ::testing::Values(BASE64_BACKEND_SCALAR,
+                                                          BASE64_BACKEND_SWAR,
+                                                          BASE64_BACKEND_SSSE3,
+                                                          BASE64_BACKEND_AVX2));
+
+class Base85Backend : public RFCBackend {};
+
+TEST_P(Base85Backend, MatchesScalar) {
+  // The example of the Z85 specification.
+  const std::vector<char> hello = {'\x86', '\x4f', '\xd2', '\x6f', '\xb5', '\x59', '\xf7', '\x5b'};
+  ASSERT_STREQ(encode_base85(hello).get(), "HelloWorld");
+  ASSERT_EQ(decode_base85<char>("HelloWorld"), hello);
+
+  const base64_backend backend = base64_get_backend();
+  for(size_t sz = 0; sz < 256; ++sz) {
+    std::vector<char> in = random_vector<char>(sz);
+    // The largest values, whose digits are all the last ones.
+    if (sz % 3 == 0)
+      std::fill(in.begin(), in.end(), '\xff');
+
+    base64_set_backend(BASE64_BACKEND_SCALAR);
+    const std::string expected = encode_base85(in).get();
+    base64_set_backend(backend);
+
+    const std::string encoded = encode_base85(in).get();
+    ASSERT_EQ(encoded, expected) << "size " << sz;
+    ASSERT_EQ(encoded.size(), encoded_size_base85<char>(sz)) << "size " << sz;
+    ASSERT_EQ(decode_base85<char>(encoded), in) << "size " << sz;
+  }
+
+  const std::vector<double> values = random_vector<double>(100);
+  ASSERT_EQ(decode_base85<double>(encode_base85(values).get()), values);
+}
+
+TEST_P(Base85Backend, InvalidInput) {
+  const std::string encoded = encode_base85(random_vector<char>(200)).get();
+
+  for(size_t pos = 0; pos < encoded.size(); ++pos) {
+    std::string in = encoded;
+    in[pos] = '"';
+    ASSERT_THROW(decode_base85<char>(in), std::runtime_error) << "position " << pos;
+  }
+
+  // Groups just above and at the largest 32-bit value.
+  for(size_t pos = 0; pos + 5 <= encoded.size(); pos += 5) {
+    std::string in = encoded;
+    in.replace(pos, 5, "%nSc1");
+    ASSERT_THROW(decode_base85<char>(in), std::runtime_error) << "position " << pos;
+    in.replace(pos, 5, "%nSc0");
+    ASSERT_EQ(decode_base85<char>(in).size(), 200u) << "position " << pos;
+  }
+
+  ASSERT_THROW(decode_base85<char>(encoded + "0"), std::runtime_error);
+  ASSERT_THROW(decode_base85<int>(encoded.substr(0, 13)), std::runtime_error);
+}
+
+INSTANTIATE_TEST_CASE_P(_, Base85Backend, ::testing::Values(BASE64_BACKEND_SCALAR,
+                                                            BASE64_BACKEND_SWAR,
+                                                            BASE64_BACKEND_SSSE3,
+                                                            BASE64_BACKEND_AVX2));
+
+
+
+// The outputs are allocated from the resource only: the arena has no
+// upstream to fall back on.
+// Decoded and encoded while compiling.
+constexpr char embedded_base64[] = "aGVsbG8sIHdvcmxkIQ==";
+constexpr auto embedded = base64_decode_array<base64_decoded_size(embedded_base64)>(embedded_base64);
+static_assert(embedded.size() == 13 && embedded[0] == 'h' && embedded[12] == '!', "constexpr decoding");
+
+constexpr auto reencoded = base64_encode_array(embedded);
+static_assert(reencoded.size() == sizeof embedded_base64 && reencoded[17] == 'Q' && reencoded[19] == '=' && reencoded[20] == 0,
+              "constexpr encoding");
+
+TEST(ConstexprBase64, MatchesRuntime) {
+  EXPECT_STREQ(embedded_base64, reencoded.data());
+
+  // Every length of tail, with the characters 62 and 63.
+  constexpr std::array<uint8_t, 5> bytes = {0xfb, 0xff, 0xbf, 0x01, 0x02};
+  constexpr auto url = base64_encode_array<base64_url_alphabet, base64_unpadded>(bytes);
+  static_assert(url.size() == 8, "unpadded size");
+  EXPECT_STREQ((encode_base64_with<base64_url_alphabet, base64_unpadded>(bytes.data(), bytes.size()).c_str()), url.data());
+  EXPECT_EQ(bytes, (base64_decode_array<5, base64_url_alphabet, base64_unpadded>(url.data(), url.size() - 1)));
+
+  const std::vector<char> in = random_vector<char>(100);
+  const std::string encoded = encode_base64_rfc(in).get();
+  for(size_t sz = 0; sz < in.size(); ++sz) {
+    std::array<uint8_t, 100> plain{};
+    std::copy(in.begin(), in.begin() + sz, plain.begin());
+    std::string out(base64_codec<>::encoded_size(sz), '\0');
+    base64_codec<>::encode_constexpr(plain.data(), sz, &out[0]);
+    ASSERT_EQ(encode_base64_rfc(in.data(), sz).get(), out) << "size " << sz;
+  }
+  EXPECT_EQ(0, memcmp(in.data(), base64_decode_array<100>(encoded.data(), encoded.size()).data(), in.size()));
+
+  // Evaluated at run time, the errors throw.
+  EXPECT_THROW(base64_decode_array<5>(encoded.data(), 8), std::runtime_error);
+  EXPECT_THROW(base64_decode_array<3>("Zm9!", 4), std::runtime_error);
+}
+
+TEST(MemoryResource, AllCodecs) {
+  alignas(std::max_align_t) static char buffer[1 << 16];
+  std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+  for(size_t sz : {0, 1, 2, 3, 100}) {
+    const std::vector<int> in = random_vector<int>(sz);
+
+    const std::pmr::string raw = encode_base64(in, &arena);
+    EXPECT_EQ(raw.c_str(), encode_base64(in));
+    EXPECT_EQ(raw.get_allocator().resource(), &arena);
+    const std::pmr::vector<int> raw_decoded = decode_base64<int>(raw, &arena);
+    EXPECT_EQ(std::vector<int>(raw_decoded.begin(), raw_decoded.end()), in);
+    EXPECT_EQ(raw_decoded.get_allocator().resource(), &arena);
+
+    const std::pmr::string typed = encode_base64_2(in, &arena);
+    EXPECT_EQ(typed.c_str(), encode_base64_2(in));
+    const std::pmr::vector<int> typed_decoded = decode_base64_2<int>(typed, &arena);
+    EXPECT_EQ(std::vector<int>(typed_decoded.begin(), typed_decoded.end()), in);
+
+    const std::pmr::string rfc = encode_base64_rfc(in, &arena);
+    EXPECT_STREQ(rfc.c_str(), encode_base64_rfc(in).get());
+    const std::pmr::vector<int> rfc_decoded = decode_base64_rfc<int>(rfc, &arena);
+    EXPECT_EQ(std::vector<int>(rfc_decoded.begin(), rfc_decoded.end()), in);
+  }
+
+  EXPECT_THROW(decode_base64_rfc<int>(std::pmr::string("Zm9v!A==", &arena), &arena), std::runtime_error);
+  EXPECT_THROW(encode_base64_rfc(std::vector<char>(sizeof(buffer)), &arena), std::bad_alloc);
+}
+
+TEST(TryDecode, AllCodecs) {
+  for(size_t sz : {0, 1, 2, 3, 100}) {
+    const std::vector<int> in = random_vector<int>(sz);
+
+    const base64_result<std::vector<int>> raw = try_decode_base64<int>(encode_base64(in));
+    ASSERT_TRUE(raw.has_value()) << "size " << sz;
+    EXPECT_EQ(raw.value, in);
+
+    const base64_result<std::vector<int>> typed = try_decode_base64_2<int>(encode_base64_2(in));
+    ASSERT_TRUE(typed.has_value()) << "size " << sz;
+    EXPECT_EQ(typed.value, in);
+
+    const base64_result<std::vector<int>> rfc = try_decode_base64_rfc<int>(std::string(encode_base64_rfc(in).get()));
+    ASSERT_TRUE(rfc.has_value()) << "size " << sz;
+    EXPECT_EQ(rfc.value, in);
+
+    std::vector<int> out(sz);
+    const base64_result<size_t> into = try_decode_base64_rfc_into(encode_base64_rfc(in).get(), strlen(encode_base64_rfc(in).get()), out.data(), out.size());
+    EXPECT_TRUE(into);
+    EXPECT_EQ(into.value, sz);
+    EXPECT_EQ(out, in);
+  }
+
+  // Every error of the throwing decoders is reported, with the offset of the
+  // first invalid character.
+  std::string encoded = encode_base64(random_vector<int>(50));
+  encoded[77] = '!';
+  encoded[120] = '!';
+  for(const base64_error& error : {try_decode_base64<int>(encoded).error,
+                                   try_decode_base64_2<int>(encoded).error,
+                                   try_decode_base64_rfc<int>(encoded).error}) {
+    EXPECT_EQ(error.code, base64_errc::invalid_character);
+    EXPECT_EQ(error.offset, 77u);
+  }
+  EXPECT_THROW(decode_base64<int>(encoded), std::exception);
+  EXPECT_TRUE(try_decode_base64_rfc<int>(encoded).value.empty());
+
+  const std::vector<std::pair<std::string, base64_error>> rfc_errors = {
+    {"Zm9vYg==Zm9v", {base64_errc::invalid_character, 8}},
+    {"Zm=vYmFy", {base64_errc::invalid_character, 3}},
+    {"Zm9vYmF", {base64_errc::truncated, 7}},
+    {"Zm9vYmE=", {base64_errc::invalid_size, 8}},
+  };
+  for(const auto& e : rfc_errors) {
+    const base64_result<std::vector<int>> r = try_decode_base64_rfc<int>(e.first);
+    EXPECT_FALSE(r) << e.first;
+    EXPECT_EQ(r.error.code, e.second.code) << e.first;
+    EXPECT_EQ(r.error.offset, e.second.offset) << e.first;
+    EXPECT_THROW(decode_base64_rfc<int>(e.first), std::runtime_error) << e.first;
+  }
+
+  // The Boost decoders read '=' as 0 anywhere, and ignore the bits left over.
+  EXPECT_TRUE(try_decode_base64<char>(std::string("Zm=vYmF")));
+  EXPECT_EQ(try_decode_base64<int>(std::string("Zm9vYmE=")).error.code, base64_errc::invalid_size);
+  EXPECT_EQ(try_decode_base64_2<int>(std::string("Zm9vYmE=")).error.code, base64_errc::invalid_size);
+
+  int small[1];
+  for(const base64_result<size_t>& r : {try_decode_base64_into("AAAAAAAAAAA=", 12, small, 1),
+                                        try_decode_base64_2_into("AAAAAAAAAAA=", 12, small, 1),
+                                        try_decode_base64_rfc_into("AAAAAAAAAAA=", 12, small, 1)}) {
+    EXPECT_EQ(r.error.code, base64_errc::output_too_small);
+    EXPECT_EQ(r.value, 0u);
+  }
+  EXPECT_STREQ(base64_error_message(base64_errc::output_too_small), "Output buffer too small");
+}
+
+class RFCStreaming : public ::testing::TestWithParam<size_t> {};
+
+TEST_P(RFCStreaming, MatchesOneShot) {
+  const size_t chunk = GetParam();
+
+  for(size_t sz : {0, 1, 2, 3, 4, 100, 1000}) {
+    const std::vector<char> in = random_vector<char>(sz);
+    const std::string expected = encode_base64_rfc(in).get();
+
+    base64_encoder encoder;
+    std::string encoded;
+    for(size_t i = 0; i < in.size(); i += chunk)
+      encoder.update(in.data() + i, std::min(chunk, in.size() - i), encoded);
+    encoder.finish(encoded);
+    ASSERT_EQ(expected, encoded) << "size " << sz;
+
+    base64_decoder decoder;
+    std::vector<char> decoded;
+    for(size_t i = 0; i < encoded.size(); i += chunk)
+      decoder.update(encoded.data() + i, std::min(chunk, encoded.size() - i), decoded);
+    decoder.finish();
+    ASSERT_EQ(in, decoded) << "size " << sz;
+  }
+}
+
+TEST_P(RFCStreaming, InvalidInput) {
+  const size_t chunk = GetParam();
+
+  auto decode = [chunk](const std::string& in) {
+    base64_decoder decoder;
+    std::vector<char> decoded;
+    for(size_t i = 0; i < in.size(); i += chunk)
+      decoder.update(in.data() + i, std::min(chunk, in.size() - i), decoded);
+    decoder.finish();
+    return decoded;
+  };
+
+  EXPECT_THROW(decode("Zm9vYmFy!m9v"), std::runtime_error);
+  EXPECT_THROW(decode("Zg==Zm9v"), std::runtime_error);
+  EXPECT_THROW(decode("Zm9vYmE"), std::runtime_error);
+}
+
+INSTANTIATE_TEST_CASE_P(_, RFCStreaming, ::testing::Values(1, 2, 3, 4, 5, 7, 64, 4096));
+
+
+TEST(RFCParallel, MatchesSerial) {
+  thread_pool pool(4);
+
+  for(size_t sz : {0, 1, 2, 3, 5, 11, 12, 13, 100, 1000, 100001}) {
+    const std::vector<char> in = random_vector<char>(sz);
+    const std::string encoded = encode_base64_rfc(in).get();
+
+    ASSERT_EQ(encoded, encode_base64_rfc_parallel(in, pool, 0).get()) << "size " << sz;
+    ASSERT_EQ(in, decode_base64_rfc_parallel<char>(encoded, pool, 0)) << "size " << sz;
+  }
+
+  const std::vector<int> in = random_vector<int>(1000);
+  ASSERT_EQ(in, decode_base64_rfc_parallel<int>(encode_base64_rfc_parallel(in, pool, 0).get(), pool, 0));
+}
+
+TEST(RFCParallel, InvalidInput) {
+  thread_pool pool(4);
+
+  std::string encoded = encode_base64_rfc(random_vector<char>(1000)).get();
+  encoded[700] = '!';
+  EXPECT_THROW(decode_base64_rfc_parallel<char>(encoded, pool, 0), std::runtime_error);
+
+  // Padding in the middle of the input, at the end of a slice.
+  EXPECT_THROW(decode_base64_rfc_parallel<char>("Zg==Zg==Zg==Zg==", pool, 0), std::runtime_error);
+}
+
+// Runs base64_pipeline from in to a string, reading at most read_size bytes
+// at a time.
+static std::string run_pipeline(const std::string& in, const base64_pipeline_options& options, size_t read_size = 1000) {
+  size_t pos = 0;
+  std::string out;
+  base64_pipeline_result r = base64_pipeline(
+    [&](char* buffer, size_t size) {
+      size_t n = std::min({size, read_size, in.size() - pos});
+      std::copy(in.data() + pos, in.data() + pos + n, buffer);
+      pos += n;
+      return n;
+    },
+    [&](const char* data, size_t size) { out.append(data, size); },
+    options);
+
+  EXPECT_EQ(r.read, in.size());
+  EXPECT_EQ(r.written, out.size());
+  return out;
+}
+
+TEST(RFCPipeline, MatchesSerial) {
+  for(size_t workers : {0, 1, 3}) {
+    for(size_t chunk : {1, 7, 12, 1000}) {
+      for(size_t sz : {0, 1, 2, 3, 11, 12, 13, 100, 10001}) {
+        base64_pipeline_options options;
+        options.workers = workers;
+        options.chunk = chunk;
+        options.buffers = workers == 1 ? 2 : 0;
+
+        const std::vector<char> data = random_vector<char>(sz);
+        const std::string in(data.begin(), data.end());
+        const std::string encoded = encode_base64(data);
+        ASSERT_EQ(run_pipeline(in, options, 5), encoded) << "size " << sz << ", chunk " << chunk;
+
+        options.decode = true;
+        ASSERT_EQ(run_pipeline(encoded, options, 5), in) << "size " << sz << ", chunk " << chunk;
+        ASSERT_EQ(run_pipeline(encoded + "\r\n", options), in) << "size " << sz << ", chunk " << chunk;
+        ASSERT_EQ(run_pipeline(encoded + "\n", options), in) << "size " << sz << ", chunk " << chunk;
+      }
+    }
+  }
+}
+
+TEST(RFCPipeline, WrappedInput) {
+  for(size_t workers : {0, 1, 3}) {
+    for(size_t chunk : {1, 7, 100, 1000}) {
+      for(size_t sz : {0, 1, 57, 100, 10001}) {
+        base64_pipeline_options options;
+        options.decode = true;
+        options.workers = workers;
+        options.chunk = chunk;
+
+        const std::vector<char> data = random_vector<char>(sz);
+        const std::string in(data.begin(), data.end());
+        // The output of base64(1), then MIME and PEM lines.
+        ASSERT_EQ(run_pipeline(encode_base64_rfc_wrapped(data, 76, "\n").get(), options, 5), in) << "size " << sz << ", chunk " << chunk;
+        ASSERT_EQ(run_pipeline(encode_base64_rfc_wrapped(data).get(), options), in) << "size " << sz << ", chunk " << chunk;
+        ASSERT_EQ(run_pipeline(encode_base64_rfc_wrapped(data, 64, "\r\n").get(), options), in) << "size " << sz << ", chunk " << chunk;
+        ASSERT_EQ(run_pipeline(encode_base64_rfc_wrapped(data).get() + std::string("\r\n"), options), in) << "size " << sz << ", chunk " << chunk;
+      }
+    }
+  }
+
+  base64_pipeline_options options;
+  options.decode = true;
+  options.chunk = 6;
+  EXPECT_THROW(run_pipeline("Zm9vYg==\nZm9vYmFy\n", options), std::runtime_error);
+  EXPECT_THROW(run_pipeline("Zm9v\nYmE!\n", options), std::runtime_error);
+}
+
+TEST(RFCPipeline, InvalidInput) {
+  base64_pipeline_options options;
+  options.decode = true;
+  options.workers = 2;
+  options.chunk = 6;
+
+  std::string encoded = encode_base64(random_vector<char>(1000));
+  encoded[700] = '!';
+  for(size_t workers : {0, 2}) {
+    options.workers = workers;
+    EXPECT_THROW(run_pipeline(encoded, options), std::runtime_error);
+
+    // Padding at the end of a chunk that is not the last one, and
+    // truncated input.
+    EXPECT_THROW(run_pipeline("Zm9vYg==Zm9vYmFy", options), std::runtime_error);
+    EXPECT_THROW(run_pipeline("Zm9vYmFyZm9", options), std::runtime_error);
+  }
+
+  // Errors of the reader and the writer stop the other stages.
+  EXPECT_THROW(base64_pipeline([](char*, size_t) -> size_t { throw std::runtime_error("read"); },
+                               [](const char*, size_t) {}, options),
+               std::runtime_error);
+  options.decode = false;
+  EXPECT_THROW(base64_pipeline([](char*, size_t size) { return size; },
+                               [](const char*, size_t) { throw std::runtime_error("write"); }, options),
+               std::runtime_error);
+}
+
+TEST(RFCDeflate, RoundTrip) {
+  // Around the 64 KiB chunks of the pipeline.
+  for(size_t sz : {0, 1, 2, 1000, 8191, 8192, 8193, 100000}) {
+    const std::vector<double> in = random_vector<double>(sz);
+    ASSERT_EQ(in, decode_base64_deflate<double>(encode_base64_deflate(in))) << "size " << sz;
+  }
+
+  const std::vector<char> bytes = random_vector<char>(200000);
+  EXPECT_EQ(bytes, decode_base64_deflate<char>(encode_base64_deflate(bytes, 1)));
+
+  // A smooth signal compresses well once its bytes are shuffled.
+  std::vector<float> signal(100000);
+  for(size_t i = 0; i < signal.size(); ++i)
+    signal[i] = static_cast<float>(i % 1000);
+  const std::string encoded = encode_base64_deflate(signal);
+  EXPECT_LT(encoded.size(), encoded_size_base64<float>(signal.size()) / 10);
+  EXPECT_EQ(signal, decode_base64_deflate<float>(encoded));
+
+  EXPECT_THROW(encode_base64_deflate(signal, 12), std::invalid_argument);
+}
+
+TEST(RFCDeflate, InvalidInput) {
+  const std::string encoded = encode_base64_deflate(random_vector<int>(1000));
+
+  std::string corrupted = encoded;
+  corrupted[100] = '!';
+  EXPECT_THROW(decode_base64_deflate<int>(corrupted), std::runtime_error);
+
+  // Not a zlib stream, truncated, followed by more data.
+  EXPECT_THROW(decode_base64_deflate<int>(encode_base64_rfc(random_vector<int>(1000)).get()), std::runtime_error);
+  EXPECT_THROW(decode_base64_deflate<int>(encoded.substr(0, encoded.size() / 2 / 4 * 4)), std::runtime_error);
+  EXPECT_THROW(decode_base64_deflate<int>(encoded + "AAAA"), std::runtime_error);
+  EXPECT_THROW(decode_base64_deflate<int>(""), std::runtime_error);
+
+  // Not a whole number of elements.
+  EXPECT_THROW(decode_base64_deflate<int>(encode_base64_deflate(random_vector<char>(1001))), std::runtime_error);
+}
+
+TEST(RFCView, MatchesDecoded) {
+  const std::vector<double> in = random_vector<double>(101);
+  const std::string encoded = encode_base64_rfc(in).get();
+  const base64_view<double> view(encoded);
+
+  ASSERT_EQ(in.size(), view.size());
+  for(size_t i = 0; i < in.size(); ++i)
+    ASSERT_EQ(in[i], view[i]) << "element " << i;
+
+  // Every alignment of the range on the quanta, up to the padded end.
+  const std::vector<char> bytes = random_vector<char>(100);
+  const std::string bytes_encoded = encode_base64_rfc(bytes).get();
+  const base64_view<char> bytes_view(bytes_encoded);
+  for(size_t first = 0; first <= bytes.size(); ++first)
+    for(size_t count = 0; first + count <= bytes.size(); ++count)
+      ASSERT_EQ(std::vector<char>(bytes.begin() + first, bytes.begin() + first + count),
+                bytes_view.decode_range(first, count)) << "range " << first << "+" << count;
+
+  EXPECT_THROW(view.decode_range(100, 2), std::out_of_range);
+  EXPECT_THROW(base64_view<int>("Zg==", 4), std::runtime_error);
+}
+
+TEST(RFCView, InvalidInput) {
+  std::string encoded = encode_base64_rfc(random_vector<char>(30)).get();
+  encoded[20] = '!';
+  const base64_view<char> view(encoded);
+
+  // Only the quanta holding the decoded elements are checked.
+  EXPECT_NO_THROW(view.decode_range(0, 15));
+  EXPECT_THROW(view[15], std::runtime_error);
+  EXPECT_THROW(view.decode_range(10, 10), std::runtime_error);
+
+  // Padding before the last quantum.
+  const base64_view<char> padded("Zg==Zg==", 8);
+  EXPECT_THROW(padded[0], std::runtime_error);
+}
+
 class u16VectorBase64RawSerialization : public VectorSerializationTest<unsigned short> {};
 
 TEST_P(u16VectorBase64RawSerialization, Boost) {
@@ -108,6 +970,17 @@ TEST_P(u16VectorBase64RawSerialization, RFC) {
   ASSERT_EQ(plain, decode_base64_rfc<unsigned short>(encoded));
 }
 
+TEST_P(u16VectorBase64RawSerialization, Into) {
+  std::string out(encoded_size_base64<unsigned short>(plain.size()), '#');
+  std::vector<unsigned short> decoded(decoded_size_base64<unsigned short>(encoded.data(), encoded.size()));
+  ASSERT_EQ(plain.size(), decoded.size());
+
+  ASSERT_EQ(out.size(), encode_base64_rfc_into(plain.data(), plain.size(), &out[0], out.size()));
+  EXPECT_EQ(encoded, out);
+  ASSERT_EQ(plain.size(), decode_base64_rfc_into(encoded.data(), encoded.size(), decoded.data(), decoded.size()));
+  EXPECT_EQ(plain, decoded);
+}
+
 std::vector<std::pair<std::vector<unsigned short>, std::string>> base64_u16_cases = {
   {{},                  ""},
   {{0},                 "AAA="},
@@ -131,6 +1004,12 @@ TEST_P(u16VectorBase64TypedSerialization, TypedBoost) {
   EXPECT_THAT(decode_base64_2<unsigned short>(encoded), plain);
 }
 
+TEST_P(u16VectorBase64TypedSerialization, RFCBigEndian) {
+  EXPECT_EQ(encode_base64_rfc_be(plain).get(), encoded);
+
+  EXPECT_THAT(decode_base64_rfc_be<unsigned short>(encoded), plain);
+}
+
 std::vector<std::pair<std::vector<unsigned short>, std::string>> endian_safe_base64_u16_cases = {
   {{},                  ""},
   {{0},                 "AAA="},
@@ -146,13 +1025,52 @@ INSTANTIATE_TEST_CASE_P(_, u16VectorBase64TypedSerialization, ::testing::ValuesI
 
 
 
+size_t content_size(const std::string& encoded) { return encoded.size(); }
+size_t content_size(const std::unique_ptr<char, free_deleter<char>>& encoded) { return strlen(encoded.get()); }
+
+// Sizes of the plain data, in bytes, from L1-sized to LLC-sized inputs. The
+// benchmark executable extends the sweep up to DRAM-sized inputs.
+std::vector<size_t> benchmark_sizes() {
+  std::vector<size_t> sizes;
+  for(size_t size = 16; size <= (4 << 20); size *= 4)
+    sizes.push_back(size);
+  return sizes;
+}
+
+// Prints the throughput of a round trip for each size of the sweep.
+template<typename T, typename Encode, typename Decode>
+void benchmark_sweep(Encode encode, Decode decode) {
+  const std::vector<size_t> sizes = benchmark_sizes();
+  const std::vector<T> data = random_vector<T>(sizes.back() / sizeof(T));
+
+  for(size_t size : sizes) {
+    const std::vector<T> in(data.begin(), data.begin() + std::max<size_t>(1, size / sizeof(T)));
+
+    auto t0 = steady_clock::now();
+
+    auto encoded = encode(in);
+
+    auto t1 = steady_clock::now();
+
+    auto decoded = decode(encoded);
+
+    auto t2 = steady_clock::now();
+
+    EXPECT_EQ(in, decoded);
+
+    const double bytes = in.size() * sizeof(T);
+    std::cout << "Size: " << in.size() * sizeof(T)
+              << " Content size: " << content_size(encoded)
+              << " Write: " << elapsed<microseconds>(t0, t1) << "us (" << bytes / std::max<long>(1, elapsed<nanoseconds>(t0, t1)) * 1e3 << " MB/s)"
+              << " Read: " << elapsed<microseconds>(t1, t2) << "us (" << bytes / std::max<long>(1, elapsed<nanoseconds>(t1, t2)) * 1e3 << " MB/s)"
+              << std::endl;
+  }
+}
+
 template <typename T>
 class Benchmark : public ::testing::Test {
 public:
   using value_type = T;
-  Benchmark() : in(random_vector<value_type>(1000000)), out() {}
-  const std::vector<value_type> in;
-  std::vector<value_type> out;
 };
 
 using PrimitiveValueTypes = ::testing::Types<char, unsigned short, int, float, double>;
@@ -168,22 +1086,9 @@ TYPED_TEST(BoostRawMemoryBase64Benchmark, _)
 {
   using value_type = typename TestFixture::value_type;
 
-  auto t0 = steady_clock::now();
-
-  auto encoded = encode_base64(this->in);
-
-  auto t1 = steady_clock::now();
-
-  auto decoded = decode_base64<value_type>(encoded);
-
-  auto t2 = steady_clock::now();
-
-  EXPECT_EQ(this->in, decoded);
-
-  std::cout << "Content size: " << encoded.size() << std::endl;
-
-  std::cout << "Write time: " << elapsed(t0, t1) << std::endl;
-  std::cout << "Read time : " << elapsed(t1, t2) << std::endl;
+  benchmark_sweep<value_type>(
+    [](const std::vector<value_type>& in) { return encode_base64(in); },
+    [](const std::string& encoded) { return decode_base64<value_type>(encoded); });
 }
 
 
@@ -196,22 +1101,9 @@ TYPED_TEST(BoostSafeBase64Benchmark, _)
 {
   using value_type = typename TestFixture::value_type;
 
-  auto t0 = steady_clock::now();
-
-  auto encoded = encode_base64_2(this->in);
-
-  auto t1 = steady_clock::now();
-
-  auto decoded = decode_base64_2<value_type>(encoded);
-
-  auto t2 = steady_clock::now();
-
-  EXPECT_EQ(this->in, decoded);
-
-  std::cout << "Content size: " << encoded.size() << std::endl;
-
-  std::cout << "Write time: " << elapsed(t0, t1) << std::endl;
-  std::cout << "Read time : " << elapsed(t1, t2) << std::endl;
+  benchmark_sweep<value_type>(
+    [](const std::vector<value_type>& in) { return encode_base64_2(in); },
+    [](const std::string& encoded) { return decode_base64_2<value_type>(encoded); });
 }
 
 
@@ -224,22 +1116,43 @@ TYPED_TEST(RFCBenchmark, _)
 {
   using value_type = typename TestFixture::value_type;
 
-  auto t0 = steady_clock::now();
+  benchmark_sweep<value_type>(
+    [](const std::vector<value_type>& in) { return encode_base64_rfc(in); },
+    [](const std::unique_ptr<char, free_deleter<char>>& encoded) {
+      return decode_base64_rfc<value_type>(encoded.get(), strlen(encoded.get()));
+    });
+}
 
-  auto encoded = encode_base64_rfc(this->in);
 
-  auto t1 = steady_clock::now();
+template <typename T>
+class RFCBigEndianBenchmark : public Benchmark<T> {};
 
-  auto decoded = decode_base64_rfc<value_type>(encoded.get(), strlen(encoded.get()));
+TYPED_TEST_CASE(RFCBigEndianBenchmark, PrimitiveValueTypes);
 
-  auto t2 = steady_clock::now();
+TYPED_TEST(RFCBigEndianBenchmark, _)
+{
+  using value_type = typename TestFixture::value_type;
 
-  EXPECT_EQ(this->in, decoded);
+  benchmark_sweep<value_type>(
+    [](const std::vector<value_type>& in) { return encode_base64_rfc_be(in); },
+    [](const std::unique_ptr<char, free_deleter<char>>& encoded) {
+      return decode_base64_rfc_be<value_type>(encoded.get(), strlen(encoded.get()));
+    });
+}
 
-  std::cout << "Content size: " << strlen(encoded.get()) << std::endl;
 
-  std::cout << "Write time: " << elapsed(t0, t1) << std::endl;
-  std::cout << "Read time : " << elapsed(t1, t2) << std::endl;
+template <typename T>
+class URLSafeBenchmark : public Benchmark<T> {};
+
+TYPED_TEST_CASE(URLSafeBenchmark, PrimitiveValueTypes);
+
+TYPED_TEST(URLSafeBenchmark, _)
+{
+  using value_type = typename TestFixture::value_type;
+
+  benchmark_sweep<value_type>(
+    [](const std::vector<value_type>& in) { return encode_base64_with<base64_url_alphabet, base64_unpadded>(in); },
+    [](const std::string& encoded) { return decode_base64_with<value_type, base64_url_alphabet, base64_unpadded>(encoded); });
 }
 
 
@@ -249,8 +1162,10 @@ TEST(BoostTextArchive, short)
   std::vector<unsigned short> in = {65535, 65535};
 
   std::stringstream os;
-  boost::archive::text_oarchive oa(os);
-  oa << BOOST_SERIALIZATION_NVP(in);
+  {
+    boost::archive::text_oarchive oa(os);
+    oa << BOOST_SERIALIZATION_NVP(in);
+  }
 
   std::cout << os.str() << std::endl;
 
@@ -267,8 +1182,11 @@ TEST(BoostXmlArchive, short)
   std::vector<unsigned short> in = {65535, 65535};
 
   std::stringstream os;
-  boost::archive::xml_oarchive oa(os);
-  oa << BOOST_SERIALIZATION_NVP(in);
+  {
+    // The closing tag is only written when the archive is destroyed.
+    boost::archive::xml_oarchive oa(os);
+    oa << BOOST_SERIALIZATION_NVP(in);
+  }
 
   std::cout << os.str() << std::endl;
 
@@ -280,6 +1198,71 @@ TEST(BoostXmlArchive, short)
   std::cout << std::endl;
 }
 
+template<typename OArchive, typename IArchive>
+void expect_base64_archive_round_trip(const char* blob)
+{
+  const std::vector<double> samples = random_vector<double>(1000);
+  const std::vector<unsigned short> empty;
+  const std::string name = "sensor";
+  const int channels = 3;
+
+  std::stringstream ss;
+  {
+    OArchive oa(ss);
+    oa << BOOST_SERIALIZATION_NVP(name) << BOOST_SERIALIZATION_NVP(channels)
+       << BOOST_SERIALIZATION_NVP(samples) << BOOST_SERIALIZATION_NVP(empty);
+  }
+
+  // The samples are one token, the other members stay readable.
+  const std::string encoded = encode_base64_rfc(samples).get();
+  EXPECT_NE(ss.str().find(blob + encoded), std::string::npos);
+  EXPECT_NE(ss.str().find(name), std::string::npos);
+
+  std::string name_out;
+  int channels_out = 0;
+  std::vector<double> samples_out;
+  std::vector<unsigned short> empty_out = {1, 2};
+  {
+    IArchive ia(ss);
+    ia >> boost::serialization::make_nvp("name", name_out) >> boost::serialization::make_nvp("channels", channels_out)
+       >> boost::serialization::make_nvp("samples", samples_out) >> boost::serialization::make_nvp("empty", empty_out);
+  }
+
+  EXPECT_EQ(name_out, name);
+  EXPECT_EQ(channels_out, channels);
+  EXPECT_EQ(samples_out, samples);
+  EXPECT_TRUE(empty_out.empty());
+}
+
+TEST(Base64TextArchive, RoundTrip)
+{
+  expect_base64_archive_round_trip<base64_text_oarchive, base64_text_iarchive>(" ");
+}
+
+TEST(Base64XmlArchive, RoundTrip)
+{
+  expect_base64_archive_round_trip<base64_xml_oarchive, base64_xml_iarchive>("<base64>");
+}
+
+TEST(Base64XmlArchive, InvalidInput)
+{
+  std::vector<int> in = {1, 2, 3};
+
+  std::stringstream ss;
+  {
+    base64_xml_oarchive oa(ss);
+    oa << BOOST_SERIALIZATION_NVP(in);
+  }
+
+  std::string xml = ss.str();
+  xml[xml.find("<base64>") + 9] = '*';
+
+  std::stringstream corrupted(xml);
+  std::vector<int> out;
+  base64_xml_iarchive ia(corrupted);
+  EXPECT_THROW(ia >> BOOST_SERIALIZATION_NVP(out), boost::archive::archive_exception);
+}
+
 
 
 template <typename T>
@@ -287,40 +1270,40 @@ class BoostArchiveBenchmark : public ::testing::Test {
 public:
   using oarchive_t = typename T::first_type;
   using iarchive_t = typename T::second_type;
-
-  BoostArchiveBenchmark() : in(random_vector<unsigned short>(1000000)), ss(), oarchive(ss), out() {}
-  const std::vector<unsigned short> in;
-  std::vector<unsigned short> out;
-  std::stringstream ss;
-  oarchive_t oarchive;
 };
 
 using BoostBinaryArchive = std::pair<boost::archive::binary_oarchive, boost::archive::binary_iarchive>;
 using BoostTextArchive   = std::pair<boost::archive::text_oarchive, boost::archive::text_iarchive>;
 using BoostXMLArchive    = std::pair<boost::archive::xml_oarchive, boost::archive::xml_iarchive>;
+using Base64TextArchive  = std::pair<base64_text_oarchive, base64_text_iarchive>;
+using Base64XMLArchive   = std::pair<base64_xml_oarchive, base64_xml_iarchive>;
 
 using BoostArchiveTypes = ::testing::Types<BoostBinaryArchive,
       BoostTextArchive,
-      BoostXMLArchive>;
+      BoostXMLArchive,
+      Base64TextArchive,
+      Base64XMLArchive>;
 TYPED_TEST_CASE(BoostArchiveBenchmark, BoostArchiveTypes);
 
 TYPED_TEST(BoostArchiveBenchmark, benchmark)
 {
-  auto t0 = steady_clock::now();
-
-  this->oarchive << boost::serialization::make_nvp("data", this->in);
-
-  auto t1 = steady_clock::now();
-
-  typename TestFixture::iarchive_t iarchive(this->ss);
-  iarchive >> boost::serialization::make_nvp("data", this->out);
-
-  auto t2 = steady_clock::now();
-
-  std::cout << "Content size: " << this->ss.tellp() << std::endl;
-
-  std::cout << "Write time: " << elapsed(t0, t1) << std::endl;
-  std::cout << "Read time : " << elapsed(t1, t2) << std::endl;
-
-  EXPECT_EQ(this->in, this->out);
+  using oarchive_t = typename TestFixture::oarchive_t;
+  using iarchive_t = typename TestFixture::iarchive_t;
+
+  benchmark_sweep<unsigned short>(
+    [](const std::vector<unsigned short>& in) {
+      std::stringstream ss;
+      {
+        oarchive_t oarchive(ss);
+        oarchive << boost::serialization::make_nvp("data", in);
+      }
+      return ss.str();
+    },
+    [](const std::string& encoded) {
+      std::stringstream ss(encoded);
+      std::vector<unsigned short> out;
+      iarchive_t iarchive(ss);
+      iarchive >> boost::serialization::make_nvp("data", out);
+      return out;
+    });
 }
@@ -0,0 +1,84 @@
+#include "thread_pool.hxx"
+
+thread_pool::thread_pool(size_t threads)
+  : task(nullptr), count(0), next(0), pending(0), generation(0), stopping(false)
+{
+  for(size_t i = 1; i < threads; ++i)
+    workers.emplace_back(&thread_pool::work, this);
+}
+
+thread_pool::~thread_pool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+
+  for(std::thread& worker : workers)
+    worker.join();
+}
+
+size_t thread_pool::size() const
+{
+  return workers.size() + 1;
+}
+
+void thread_pool::run(size_t count, const std::function<void(size_t)>& task)
+{
+  std::lock_guard<std::mutex> run_lock(run_mutex);
+  std::unique_lock<std::mutex> lock(mutex);
+
+  this->task = &task;
+  this->count = count;
+  next = 0;
+  pending = count;
+  error = nullptr;
+  ++generation;
+  wake.notify_all();
+
+  run_tasks(lock);
+  idle.wait(lock, [this]() { return pending == 0; });
+
+  this->task = nullptr;
+  if (error)
+    std::rethrow_exception(error);
+}
+
+// Runs the tasks of the current batch until none is left to start.
+// Called with the mutex held.
+void thread_pool::run_tasks(std::unique_lock<std::mutex>& lock)
+{
+  while (next < count) {
+    size_t i = next++;
+    lock.unlock();
+
+    std::exception_ptr failure;
+    try {
+      (*task)(i);
+    } catch (...) {
+      failure = std::current_exception();
+    }
+
+    lock.lock();
+    if (failure && !error)
+      error = failure;
+    if (--pending == 0)
+      idle.notify_all();
+  }
+}
+
+void thread_pool::work()
+{
+  unsigned long seen = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+
+  for(;;) {
+    wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+    if (stopping)
+      return;
+
+    seen = generation;
+    run_tasks(lock);
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running batches of independent tasks. The pool is
+// meant to be created once and reused, so that splitting a buffer across
+// threads does not pay for thread creation on every call.
+class thread_pool
+{
+public:
+  // Creates a pool of threads threads, the calling one included.
+  explicit thread_pool(size_t threads = std::thread::hardware_concurrency());
+  ~thread_pool();
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  // Number of threads running the tasks, the calling one included.
+  size_t size() const;
+
+  // Calls task(i) for every i in [0, count) and returns once all of them
+  // are done. The calling thread takes part in the work. If tasks throw,
+  // the first exception is rethrown once the whole batch has completed.
+  void run(size_t count, const std::function<void(size_t)>& task);
+
+private:
+  void work();
+  void run_tasks(std::unique_lock<std::mutex>& lock);
+
+  std::vector<std::thread> workers;
+
+  std::mutex run_mutex;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+
+  const std::function<void(size_t)>* task;
+  size_t count;
+  size_t next;
+  size_t pending;
+  unsigned long generation;
+  bool stopping;
+  std::exception_ptr error;
+};
+
+#endif